@@ -0,0 +1,68 @@
+#!/bin/bash
+# 编译吞吐量测试：用 sysy_gen 生成各种形状、逐级翻倍大小的程序，分别以 -koopa 和 -riscv 编译，
+# 报告每秒编译的行数、峰值内存，以及相邻两级之间的增长指数（耗时之比对大小之比取对数，线性为 1.0）
+# 指数明显大于 1 说明出现了超线性的复杂度退化
+#
+# 用法: bench/compile_throughput.sh <compiler> <sysy_gen> [最小行数] [级数] [重复次数]
+# 形状可以用环境变量 SHAPES 指定，种子用 SEED 指定
+set -e
+
+COMPILER=${1:?"usage: $0 <compiler> <sysy_gen> [min-lines] [steps] [repeat]"}
+GENERATOR=${2:?"usage: $0 <compiler> <sysy_gen> [min-lines] [steps] [repeat]"}
+MIN_LINES=${3:-2000}
+STEPS=${4:-5}
+REPEAT=${5:-3}
+SHAPES=${SHAPES:-"chain nested scopes logic fold mixed"}
+SEED=${SEED:-1}
+
+WORK_DIR=$(mktemp -d)
+trap 'rm -rf "$WORK_DIR"' EXIT
+
+# 重复编译 REPEAT 次取最短的耗时 (ns)，峰值 RSS 取自 -fmem-report-json
+measure() {
+    local mode=$1 src=$2 best=
+    for ((r = 0; r < REPEAT; r++)); do
+        local start end
+        start=$(date +%s%N)
+        "$COMPILER" "$mode" "$src" -o "$WORK_DIR/out" -fmem-report-json="$WORK_DIR/mem.json" > /dev/null
+        end=$(date +%s%N)
+        if [ -z "$best" ] || ((end - start < best)); then best=$((end - start)); fi
+    done
+    local rss
+    rss=$(sed -n 's/.*"peak_rss_bytes":\([0-9]*\).*/\1/p' "$WORK_DIR/mem.json")
+    echo "$best $rss"
+}
+
+printf "%-7s %-7s %9s %10s %12s %9s %7s\n" shape mode lines ms lines/s "rss MiB" growth
+status=0
+for shape in $SHAPES; do
+    for mode in -koopa -riscv; do
+        prev_lines=
+        prev_ns=
+        lines=$MIN_LINES
+        for ((step = 0; step < STEPS; step++)); do
+            src="$WORK_DIR/$shape-$lines.c"
+            [ -f "$src" ] || "$GENERATOR" "$shape" "$lines" "$SEED" > "$src"
+            actual=$(wc -l < "$src")
+            if ! result=$(measure "$mode" "$src"); then
+                printf "%-7s %-7s %9d FAILED\n" "$shape" "$mode" "$actual"
+                status=1
+                break
+            fi
+            read -r ns rss <<< "$result"
+            awk -v shape="$shape" -v mode="$mode" -v lines="$actual" -v ns="$ns" -v rss="$rss" \
+                -v prev_lines="$prev_lines" -v prev_ns="$prev_ns" 'BEGIN {
+                growth = "-"
+                if (prev_ns != "" && prev_ns > 0 && ns > 0) {
+                    growth = sprintf("%.2f", log(ns / prev_ns) / log(lines / prev_lines))
+                }
+                printf "%-7s %-7s %9d %10.1f %12.0f %9.1f %7s\n", shape, mode, lines, ns / 1e6,
+                       lines / (ns / 1e9), rss / 1048576, growth
+            }'
+            prev_lines=$actual
+            prev_ns=$ns
+            lines=$((lines * 2))
+        done
+    done
+done
+exit $status
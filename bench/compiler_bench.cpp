@@ -0,0 +1,283 @@
+/*
+编译器热点组件的微基准测试：单独测量每个组件，便于逐个验证针对它们的优化
+
+用法: compiler_bench [-n 样本数] [-w 预热次数] [名字过滤]
+
+每个基准先预热若干次，再采集若干个样本，报告样本耗时的中位数、p95 和最小值，
+以及按中位数折算的每个操作的耗时和每个操作的堆分配次数（由 heap_counter.cpp 统计）。
+只运行名字中包含过滤字符串的基准。
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "koopa_builder.h"
+#include "koopa_parser.h"
+#include "memory_report.h"
+#include "mmap_lexer.h"
+#include "output_buffer.h"
+#include "string_format.h"
+#include "string_interner.h"
+#include "symbol_table.h"
+#include "sysy.tab.hpp"
+
+// sysy.l 中的 flex 扫描器
+extern void* createFlexScanner(StringInterner& interner);
+extern void flexScanBuffer(void* scanner, const char* data, size_t size);
+extern void destroyFlexScanner(void* scanner);
+extern int flex_yylex(YYSTYPE* lval, void* scanner);
+
+namespace {
+
+struct Options {
+    int samples = 31;
+    int warmup = 5;
+    std::string filter;
+};
+
+Options options;
+
+// 累加被测代码的结果，防止编译器把它们优化掉
+volatile std::uint64_t sink = 0;
+
+// 最近一次 timed() 中被测代码的堆分配次数
+std::uint64_t timed_allocations = 0;
+
+template <class Fn>
+std::uint64_t timed(Fn&& fn)
+{
+    const auto allocations = MemoryReport::threadHeap().count;
+    const auto start = std::chrono::steady_clock::now();
+    fn();
+    const auto end = std::chrono::steady_clock::now();
+    timed_allocations = MemoryReport::threadHeap().count - allocations;
+    return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+}
+
+bool selected(const std::string& name)
+{
+    return options.filter.empty() || name.find(options.filter) != std::string::npos;
+}
+
+// sample() 执行一次被测代码并返回计时的纳秒数，需要准备工作的基准只对被测的部分计时
+// ops 为每个样本包含的操作数，unit 为操作的名字
+template <class Sample>
+void run(const std::string& name, double ops, const char* unit, Sample sample)
+{
+    if (!selected(name)) {
+        return;
+    }
+    for (int i = 0; i < options.warmup; ++i) {
+        sample();
+    }
+    std::vector<std::uint64_t> times;
+    for (int i = 0; i < options.samples; ++i) {
+        times.push_back(sample());
+    }
+    std::sort(times.begin(), times.end());
+    const auto median = times[times.size() / 2];
+    const auto p95 = times[std::min(times.size() - 1, static_cast<std::size_t>(std::ceil(times.size() * 0.95)) - 1)];
+    std::printf("%-36s %11.1f %11.1f %11.1f %10.2f ns/%-6s %10.3f\n", name.c_str(), median / 1e3, p95 / 1e3,
+                times.front() / 1e3, median / ops, unit, timed_allocations / ops);
+    std::fflush(stdout);
+}
+
+// 在 depth 层嵌套作用域中，每层声明 4 个变量，查找最外层和最内层的变量
+void benchSymbolTable()
+{
+    constexpr int WIDTH = 4;
+    constexpr int LOOKUPS = 100000;
+    for (const int depth : { 1, 16, 256, 4096 }) {
+        StringInterner interner;
+        SymbolTable table;
+        std::vector<InternedString> names;
+        for (int level = 0; level < depth; ++level) {
+            table.enterScope();
+            for (int i = 0; i < WIDTH; ++i) {
+                names.push_back(interner.intern("var_" + std::to_string(level) + "_" + std::to_string(i)));
+                SymbolTableItem item(SymbolType::VAR, "int", names.back());
+                table.addSymbol(item);
+            }
+        }
+        const auto lookup = [&](std::size_t first) {
+            return timed([&] {
+                std::uint64_t checksum = 0;
+                for (int i = 0; i < LOOKUPS; ++i) {
+                    checksum += reinterpret_cast<std::uintptr_t>(table.getSymbol(names[first + i % WIDTH]));
+                }
+                sink += checksum;
+            });
+        };
+        run("getSymbol/outermost/depth=" + std::to_string(depth), LOOKUPS, "lookup", [&] { return lookup(0); });
+        run("getSymbol/innermost/depth=" + std::to_string(depth), LOOKUPS, "lookup",
+            [&] { return lookup(names.size() - WIDTH); });
+    }
+}
+
+// 短结果走栈上的缓冲区，长结果需要第二次格式化
+void benchStringFormat()
+{
+    constexpr int CALLS = 100000;
+    const std::string name = "while_body_";
+    const std::string long_name(300, 'x');
+    run("stringFormat/short", CALLS, "call", [&] {
+        return timed([&] {
+            for (int i = 0; i < CALLS; ++i) {
+                sink += stringFormat("%s%d", name, i).size();
+            }
+        });
+    });
+    run("stringFormat/long", CALLS, "call", [&] {
+        return timed([&] {
+            for (int i = 0; i < CALLS; ++i) {
+                sink += stringFormat("%s%d", long_name, i).size();
+            }
+        });
+    });
+}
+
+// 约 4 MiB 的源代码，包含标识符、关键字、数字、运算符和注释
+std::string lexerInput()
+{
+    std::string source = "int main() {\n  int alpha = 1, beta = 2;\n";
+    for (int i = 0; source.size() < (4u << 20); ++i) {
+        source += "  if (alpha <= " + std::to_string(i) + " && beta != 0) { alpha = alpha * 3 + beta % 7; } // step\n";
+        source += "  while (beta >= 12345) { beta = beta - 1; /* loop */ }\n";
+    }
+    source += "  return alpha;\n}\n";
+    return source;
+}
+
+void benchLexer()
+{
+    const auto source = lexerInput();
+    const double bytes = static_cast<double>(source.size());
+    run("lex/mmap", bytes, "byte", [&] {
+        StringInterner interner;
+        MmapLexer lexer(interner);
+        return timed([&] {
+            lexer.openBuffer(source.data(), source.size());
+            YYSTYPE lval;
+            std::uint64_t tokens = 0;
+            while (lexer.lex(lval) != 0) {
+                ++tokens;
+            }
+            lexer.close();
+            sink += tokens;
+        });
+    });
+    run("lex/flex", bytes, "byte", [&] {
+        StringInterner interner;
+        void* scanner = createFlexScanner(interner);
+        const auto time = timed([&] {
+            flexScanBuffer(scanner, source.data(), source.size());
+            YYSTYPE lval;
+            std::uint64_t tokens = 0;
+            while (flex_yylex(&lval, scanner) != 0) {
+                ++tokens;
+            }
+            sink += tokens;
+        });
+        destroyFlexScanner(scanner);
+        return time;
+    });
+}
+
+// 一个有 blocks 个基本块的函数，每块 insts_per_block 条指令，奇数号的块不可达
+void buildFunction(KoopaBuilder& builder, int blocks, int insts_per_block)
+{
+    builder.beginFunction("bench");
+    const auto x = builder.alloc("@x");
+    builder.store(builder.integer(1), x);
+    std::vector<KoopaBuilder::Block*> bbs;
+    for (int b = 0; b < blocks; ++b) {
+        bbs.push_back(builder.getBlock("%b_" + std::to_string(b)));
+    }
+    builder.jump(bbs[0]);
+    for (int b = 0; b < blocks; ++b) {
+        builder.insertBlock(bbs[b]);
+        for (int i = 0; i + 3 <= insts_per_block; i += 3) {
+            const auto value = builder.load(x);
+            builder.store(builder.binary(KOOPA_RBO_ADD, value, builder.integer(i)), x);
+        }
+        // 跳过下一个块，使它不可达
+        if (b + 2 < blocks) {
+            builder.jump(bbs[b + 2 - b % 2]);
+        } else {
+            builder.ret(builder.load(x));
+        }
+    }
+}
+
+// 函数结束时的清理：删除不可达的基本块、填写 used_by、生成指令列表
+void benchBlockBuilder()
+{
+    for (const auto& [blocks, insts] : { std::pair { 16, 30000 }, std::pair { 10000, 30 } }) {
+        KoopaBuilder builder;
+        const double total = static_cast<double>(blocks) * insts;
+        run("endFunction/blocks=" + std::to_string(blocks) + "/insts=" + std::to_string(insts), total, "inst", [&] {
+            builder.reset();
+            buildFunction(builder, blocks, insts);
+            return timed([&] { builder.endFunction(); });
+        });
+    }
+}
+
+// 在内存中的 IR 上生成汇编，以及先用 libkoopa 解析 IR 文本再生成汇编
+void benchBackend()
+{
+    constexpr int BLOCKS = 2000;
+    constexpr int INSTS = 150;
+    KoopaBuilder builder;
+    buildFunction(builder, BLOCKS, INSTS);
+    builder.endFunction();
+    const auto program = builder.build();
+    const double total = static_cast<double>(BLOCKS) * INSTS;
+
+    KoopaParser backend;
+    OutputBuffer out;
+    run("compileToAssembly/raw", total, "inst", [&] {
+        const auto time = timed([&] { backend.compileToAssembly(program, out); });
+        sink += out.take().size();
+        return time;
+    });
+
+    const auto text = dumpKoopa(program);
+    run("compileToAssembly/text", total, "inst", [&] {
+        return timed([&] { sink += backend.compileToAssembly(text).size(); });
+    });
+}
+
+} // namespace
+
+int main(int argc, const char* argv[])
+{
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            options.samples = std::max(1, std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "-w") == 0 && i + 1 < argc) {
+            options.warmup = std::max(0, std::atoi(argv[++i]));
+        } else if (argv[i][0] == '-') {
+            std::fprintf(stderr, "usage: %s [-n samples] [-w warmup] [filter]\n", argv[0]);
+            return 1;
+        } else {
+            options.filter = argv[i];
+        }
+    }
+
+    MemoryReport::enableHeapCounting(true);
+    std::printf("%-36s %11s %11s %11s %20s %10s\n", "benchmark (us)", "median", "p95", "min", "per op", "allocs/op");
+    benchSymbolTable();
+    benchStringFormat();
+    benchLexer();
+    benchBlockBuilder();
+    benchBackend();
+    return 0;
+}
@@ -0,0 +1,79 @@
+#!/bin/bash
+# 表达式压力测试：超长运算链、上万层括号、上万层一元运算和长短路链
+# 编译器在这些输入上不应栈溢出，且耗时应与输入大小成线性关系
+#
+# 用法: bench/stress_expressions.sh <compiler> [项数] [嵌套层数]
+set -e
+
+COMPILER=${1:?"usage: $0 <compiler> [terms] [depth]"}
+TERMS=${2:-100000}
+DEPTH=${3:-10000}
+# 用较小的栈运行，递归实现会在这里崩溃
+STACK_KB=${STACK_KB:-1024}
+
+WORK_DIR=$(mktemp -d)
+trap 'rm -rf "$WORK_DIR"' EXIT
+
+# int main() { int a = 1; return a + a - a + ... ; }
+gen_chain() {
+    echo "int main() { int a = 1; return a"
+    for ((i = 1; i < TERMS; i++)); do
+        if ((i % 2)); then echo -n " + a"; else echo -n " - a"; fi
+        if ((i % 16 == 0)); then echo; fi
+    done
+    echo "; }"
+}
+
+# int main() { return 1 + (1 + (1 + ... )); }
+gen_parens() {
+    echo -n "int main() { return "
+    for ((i = 0; i < DEPTH; i++)); do echo -n "1 + ("; done
+    echo -n "1"
+    for ((i = 0; i < DEPTH; i++)); do echo -n ")"; done
+    echo "; }"
+}
+
+# int main() { int a = 1; return - ! - ! ... a; }
+gen_unary() {
+    echo -n "int main() { int a = 1; return "
+    for ((i = 0; i < DEPTH; i++)); do
+        if ((i % 2)); then echo -n "!"; else echo -n "-"; fi
+    done
+    echo " a; }"
+}
+
+# int main() { int a = 1; return a && a || a && ... ; }
+gen_logic() {
+    echo "int main() { int a = 1; return a"
+    for ((i = 1; i < DEPTH; i++)); do
+        if ((i % 2)); then echo -n " && a"; else echo -n " || a"; fi
+        if ((i % 16 == 0)); then echo; fi
+    done
+    echo "; }"
+}
+
+# const int c = 1 + 2 * (3 - ...); 常量折叠
+gen_const() {
+    echo -n "int main() { const int c = "
+    for ((i = 0; i < DEPTH; i++)); do echo -n "$((i % 7)) + 2 * ("; done
+    echo -n "1"
+    for ((i = 0; i < DEPTH; i++)); do echo -n ")"; done
+    echo "; return c; }"
+}
+
+status=0
+for kind in chain parens unary logic const; do
+    src="$WORK_DIR/$kind.c"
+    "gen_$kind" > "$src"
+    for mode in -koopa -riscv; do
+        start=$(date +%s%N)
+        if (ulimit -s "$STACK_KB"; "$COMPILER" "$mode" "$src" -o "$WORK_DIR/out" > /dev/null); then
+            end=$(date +%s%N)
+            printf "%-8s %-7s %8d ms\n" "$kind" "$mode" "$(((end - start) / 1000000))"
+        else
+            printf "%-8s %-7s FAILED\n" "$kind" "$mode"
+            status=1
+        fi
+    done
+done
+exit $status
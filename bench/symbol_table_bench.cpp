@@ -0,0 +1,158 @@
+/*
+符号表基准测试：在深度嵌套的语句块中反复查找外层声明的变量
+
+用法: symbol_table_bench [嵌套层数] [每层变量数] [重复次数]
+
+对比对象 LegacySymbolTable 是旧版 SymbolTable 的实现：
+每次查找都复制整个作用域栈，并按值返回带字符串的符号。
+*/
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <optional>
+#include <stack>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "string_interner.h"
+#include "symbol_table.h"
+
+namespace {
+
+class LegacySymbolTable {
+public:
+    struct Item {
+        std::string type;
+        std::string identifier;
+        std::optional<int> value;
+    };
+
+    LegacySymbolTable() { enterScope(); }
+
+    void enterScope() { scopes.emplace(); }
+    void exitScope() { scopes.pop(); }
+
+    bool addSymbol(const Item& item)
+    {
+        auto& current_scope = scopes.top();
+        if (current_scope.find(item.identifier) != current_scope.end()) {
+            return false;
+        }
+        current_scope[item.identifier] = item;
+        return true;
+    }
+
+    std::optional<Item> getSymbol(const std::string& identifier) const
+    {
+        auto temp_stack = scopes;
+        while (!temp_stack.empty()) {
+            const auto& current_scope = temp_stack.top();
+            auto it = current_scope.find(identifier);
+            if (it != current_scope.end()) {
+                return it->second;
+            }
+            temp_stack.pop();
+        }
+        return std::nullopt;
+    }
+
+private:
+    std::stack<std::unordered_map<std::string, Item>> scopes;
+};
+
+std::string variableName(int level, int index)
+{
+    return "var_" + std::to_string(level) + "_" + std::to_string(index);
+}
+
+// 每进入一层作用域声明 width 个变量，然后在该层查找所有已声明的变量
+template <class Declare, class Lookup, class Enter, class Exit>
+long long runNested(int depth, int width, Declare declare, Lookup lookup, Enter enter, Exit exit)
+{
+    long long checksum = 0;
+    for (int level = 0; level < depth; ++level) {
+        enter();
+        for (int i = 0; i < width; ++i) {
+            declare(level, i);
+        }
+        for (int outer = 0; outer <= level; ++outer) {
+            for (int i = 0; i < width; ++i) {
+                checksum += lookup(outer, i);
+            }
+        }
+    }
+    for (int level = 0; level < depth; ++level) {
+        exit();
+    }
+    return checksum;
+}
+
+template <class Fn>
+double measure(int repeat, Fn fn, long long& checksum)
+{
+    const auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < repeat; ++r) {
+        checksum += fn();
+    }
+    const auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count() / repeat;
+}
+
+} // namespace
+
+int main(int argc, const char* argv[])
+{
+    const int depth = argc > 1 ? std::atoi(argv[1]) : 64;
+    const int width = argc > 2 ? std::atoi(argv[2]) : 4;
+    const int repeat = argc > 3 ? std::atoi(argv[3]) : 5;
+
+    // 预先生成名字，避免把字符串拼接计入测量时间
+    std::vector<std::vector<std::string>> names(depth, std::vector<std::string>(width));
+    StringInterner interner;
+    std::vector<std::vector<InternedString>> interned(depth, std::vector<InternedString>(width));
+    for (int level = 0; level < depth; ++level) {
+        for (int i = 0; i < width; ++i) {
+            names[level][i] = variableName(level, i);
+            interned[level][i] = interner.intern(names[level][i]);
+        }
+    }
+
+    long long legacy_checksum = 0;
+    const double legacy_ms = measure(repeat, [&] {
+        LegacySymbolTable table;
+        return runNested(
+            depth, width,
+            [&](int level, int i) { table.addSymbol({ "int", names[level][i], level * width + i }); },
+            [&](int level, int i) { return static_cast<long long>(table.getSymbol(names[level][i])->value.value()); },
+            [&] { table.enterScope(); },
+            [&] { table.exitScope(); });
+    }, legacy_checksum);
+
+    long long scoped_checksum = 0;
+    const double scoped_ms = measure(repeat, [&] {
+        SymbolTable table;
+        return runNested(
+            depth, width,
+            [&](int level, int i) {
+                SymbolTableItem item(SymbolType::CONST, "int", interned[level][i], level * width + i, true);
+                table.addSymbol(item);
+            },
+            [&](int level, int i) { return static_cast<long long>(table.getSymbol(interned[level][i])->value.value()); },
+            [&] { table.enterScope(); },
+            [&] { table.exitScope(); });
+    }, scoped_checksum);
+
+    if (legacy_checksum != scoped_checksum) {
+        std::fprintf(stderr, "checksum mismatch: %lld vs %lld\n", legacy_checksum, scoped_checksum);
+        return 1;
+    }
+
+    const long long lookups = static_cast<long long>(width) * depth * (depth + 1) / 2;
+    std::printf("depth=%d width=%d lookups=%lld\n", depth, width, lookups);
+    std::printf("legacy (copy per lookup): %10.3f ms\n", legacy_ms);
+    std::printf("scoped (binding chains):  %10.3f ms\n", scoped_ms);
+    std::printf("speedup: %.1fx\n", scoped_ms > 0 ? legacy_ms / scoped_ms : 0.0);
+    return 0;
+}
@@ -0,0 +1,302 @@
+/*
+SysY 程序生成器：按给定的形状、行数和种子生成确定的 SysY 程序，用于测量编译器的吞吐量
+
+用法: sysy_gen <形状> <行数> [种子]
+
+形状:
+  chain   很长的算术运算链
+  nested  多层嵌套的 if / while，带 break / continue
+  scopes  大量嵌套作用域中的声明和遮蔽
+  logic   大量 && / || / ! 组成的条件
+  fold    大量可以在编译期折叠的常量声明和常量表达式
+  mixed   以上各种形状交替出现
+
+生成的程序只有一个 main 函数，可以被编译器接受（不会除以 0，常量不会溢出），但不保证运行时会终止。
+同样的参数在任何平台上都生成完全相同的程序：随机数由 splitmix64 产生，不使用标准库的分布。
+*/
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+namespace {
+
+class Generator {
+public:
+    Generator(std::uint64_t seed, std::size_t target_lines)
+        : state_(seed)
+        , target_lines_(target_lines)
+    {
+    }
+
+    std::string run(const std::string& shape)
+    {
+        line("int main() {");
+        ++indent_;
+        scopes_.emplace_back();
+        // 每种形状都会用到的几个变量
+        std::string decl = "int ";
+        for (int i = 0; i < BASE_VARS; ++i) {
+            const auto name = "v" + std::to_string(i);
+            decl += (i == 0 ? "" : ", ") + name + " = " + std::to_string(i + 1);
+            scopes_.back().push_back({ name, false });
+        }
+        line(decl + ";");
+
+        int round = 0;
+        while (lines_ + 1 < target_lines_) {
+            const auto current = shape == "mixed" ? MIXED[round++ % 5] : shape;
+            if (current == "chain") {
+                chain();
+            } else if (current == "nested") {
+                nested(NESTED_DEPTH);
+            } else if (current == "scopes") {
+                scopes(SCOPE_DEPTH);
+            } else if (current == "logic") {
+                logic();
+            } else {
+                fold();
+            }
+        }
+
+        line("return " + variable() + ";");
+        --indent_;
+        line("}");
+        return std::move(out_);
+    }
+
+    static bool knownShape(const std::string& shape)
+    {
+        for (const auto* known : MIXED) {
+            if (shape == known) {
+                return true;
+            }
+        }
+        return shape == "mixed";
+    }
+
+private:
+    static constexpr int BASE_VARS = 8;
+    static constexpr int CHAIN_TERMS = 64; // 每条语句的项数
+    static constexpr int NESTED_DEPTH = 24;
+    static constexpr int SCOPE_DEPTH = 16;
+    static constexpr const char* MIXED[] = { "chain", "nested", "scopes", "logic", "fold" };
+
+    // splitmix64
+    std::uint64_t next()
+    {
+        std::uint64_t z = (state_ += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+
+    int below(int bound) { return static_cast<int>(next() % static_cast<std::uint64_t>(bound)); }
+
+    bool done() const { return lines_ + 1 >= target_lines_; }
+
+    void line(const std::string& text)
+    {
+        out_.append(indent_ * 2, ' ');
+        out_ += text;
+        out_ += '\n';
+        ++lines_;
+    }
+
+    std::string newName(const char* prefix) { return prefix + std::to_string(serial_++); }
+
+    // 任意一个可见的变量或常量
+    std::string variable()
+    {
+        const auto& scope = scopes_[below(static_cast<int>(scopes_.size()))];
+        if (scope.empty()) {
+            return scopes_.front()[below(BASE_VARS)].name;
+        }
+        return scope[below(static_cast<int>(scope.size()))].name;
+    }
+
+    // 可以赋值的变量：v0 ~ v7 只会被变量遮蔽，总是可以赋值
+    std::string target()
+    {
+        const auto& scope = scopes_.back();
+        if (!scope.empty() && below(2) == 0) {
+            const auto& symbol = scope[below(static_cast<int>(scope.size()))];
+            if (!symbol.constant) {
+                return symbol.name;
+            }
+        }
+        return "v" + std::to_string(below(BASE_VARS));
+    }
+
+    bool declaredInCurrentScope(const std::string& name) const
+    {
+        for (const auto& symbol : scopes_.back()) {
+            if (symbol.name == name) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    std::string number() { return std::to_string(1 + below(100)); }
+
+    std::string operand() { return below(4) == 0 ? number() : variable(); }
+
+    // 二元运算；除数和模数只用非零的字面量
+    std::string binary(const std::string& lhs)
+    {
+        static const char* const ops[] = { " + ", " - ", " * ", " + ", " - " };
+        switch (below(7)) {
+        case 5:
+            return lhs + " / " + std::to_string(1 + below(9));
+        case 6:
+            return lhs + " % " + std::to_string(1 + below(9));
+        default:
+            return lhs + ops[below(5)] + operand();
+        }
+    }
+
+    std::string condition()
+    {
+        static const char* const rel[] = { " < ", " > ", " <= ", " >= ", " == ", " != " };
+        return variable() + rel[below(6)] + operand();
+    }
+
+    void assign() { line(target() + " = " + binary(operand()) + ";"); }
+
+    // v = a + b * c - d / 3 ...，每条语句 CHAIN_TERMS 项
+    void chain()
+    {
+        std::string expr = operand();
+        for (int i = 1; i < CHAIN_TERMS; ++i) {
+            expr = binary(expr);
+            if (i % 4 == 0 && below(3) == 0) {
+                expr = "(" + expr + ")";
+            }
+        }
+        line(target() + " = " + expr + ";");
+    }
+
+    // if / while 交替嵌套 depth 层，最内层是普通的赋值
+    void nested(int depth)
+    {
+        if (depth == 0 || done()) {
+            assign();
+            return;
+        }
+        const bool loop = depth % 2 == 0;
+        line(std::string(loop ? "while (" : "if (") + condition() + ") {");
+        ++indent_;
+        scopes_.emplace_back();
+        assign();
+        nested(depth - 1);
+        if (loop) {
+            line("if (" + condition() + ") break;");
+            line("if (" + condition() + ") continue;");
+            assign();
+        }
+        scopes_.pop_back();
+        --indent_;
+        if (!loop && below(2) == 0) {
+            line("} else {");
+            ++indent_;
+            assign();
+            --indent_;
+        }
+        line("}");
+    }
+
+    // 每层作用域声明几个变量和常量，一部分变量遮蔽外层的同名变量
+    void scopes(int depth)
+    {
+        if (depth == 0 || done()) {
+            assign();
+            return;
+        }
+        line("{");
+        ++indent_;
+        scopes_.emplace_back();
+        for (int i = 0; i < 3; ++i) {
+            if (below(3) == 0) {
+                const auto name = newName("k");
+                line("const int " + name + " = " + number() + " * " + number() + ";");
+                scopes_.back().push_back({ name, true });
+                continue;
+            }
+            // 遮蔽外层的变量，或者声明新的变量；同一个作用域中不能重复声明
+            auto name = "v" + std::to_string(below(BASE_VARS));
+            if (below(2) == 0 || declaredInCurrentScope(name)) {
+                name = newName("s");
+            }
+            line("int " + name + " = " + binary(operand()) + ";");
+            scopes_.back().push_back({ name, false });
+        }
+        scopes(depth - 1);
+        assign();
+        scopes_.pop_back();
+        --indent_;
+        line("}");
+    }
+
+    // if (a < 1 && b || !c && ...) v = v + 1;
+    void logic()
+    {
+        std::string cond = condition();
+        const int terms = 8 + below(24);
+        for (int i = 1; i < terms; ++i) {
+            std::string term = below(3) == 0 ? "!" + variable() : below(2) == 0 ? condition() : variable();
+            if (below(5) == 0) {
+                term = "(" + term + (below(2) == 0 ? " || " : " && ") + condition() + ")";
+            }
+            cond += (below(2) == 0 ? " && " : " || ") + term;
+        }
+        line("if (" + cond + ") " + target() + " = " + variable() + " + 1;");
+    }
+
+    // const int c_i = (c_j * 7 + 13) % 1009; 每个常量都小于 1009，计算中不会溢出
+    void fold()
+    {
+        const auto name = newName("c");
+        std::string expr = "(" + (constants_.empty() ? number() : constants_[below(static_cast<int>(constants_.size()))])
+            + " * " + number() + " + " + number() + ") % 1009";
+        for (int i = below(4); i > 0; --i) {
+            expr = "(" + expr + " + " + number() + " * " + number() + " - " + number() + ") % 1009";
+        }
+        line("const int " + name + " = " + expr + ";");
+        constants_.push_back(name);
+        scopes_.front().push_back({ name, true });
+        line(target() + " = " + name + " * 2 + " + number() + " * " + number() + ";");
+    }
+
+    std::uint64_t state_;
+    std::size_t target_lines_;
+    std::size_t lines_ = 0;
+    int indent_ = 0;
+    int serial_ = 0;
+    std::string out_;
+    struct Symbol {
+        std::string name;
+        bool constant;
+    };
+
+    std::vector<std::vector<Symbol>> scopes_; // 每层作用域中声明的变量和常量
+    std::vector<std::string> constants_; // 最外层作用域中声明的常量
+};
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    if (argc < 3 || !Generator::knownShape(argv[1])) {
+        std::fprintf(stderr, "usage: %s chain|nested|scopes|logic|fold|mixed <lines> [seed]\n", argv[0]);
+        return 1;
+    }
+    const auto lines = std::strtoull(argv[2], nullptr, 10);
+    const auto seed = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 1;
+
+    const auto program = Generator(seed, lines).run(argv[1]);
+    std::fwrite(program.data(), 1, program.size(), stdout);
+    return 0;
+}
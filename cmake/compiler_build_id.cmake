@@ -0,0 +1,22 @@
+# 构建时由 CMakeLists.txt 调用: cmake -DSOURCE_DIR=... -DFLAGS=... -DOUTPUT=... -P compiler_build_id.cmake
+# 把编译器全部源代码 (包括 koopa.h) 和编译选项的哈希写成 OUTPUT 中的 SYSY_COMPILER_BUILD_ID,
+# 编译缓存和编译服务器用它区分不同构建的编译器
+file(GLOB sources "${SOURCE_DIR}/src/*.cpp" "${SOURCE_DIR}/src/*.h" "${SOURCE_DIR}/src/*.l" "${SOURCE_DIR}/src/*.y")
+list(SORT sources)
+set(content "${FLAGS}")
+foreach(source IN LISTS sources)
+  file(SHA256 "${source}" hash)
+  get_filename_component(name "${source}" NAME)
+  string(APPEND content "\n${name} ${hash}")
+endforeach()
+string(SHA256 build_id "${content}")
+
+set(header "#pragma once\n// 由 cmake/compiler_build_id.cmake 生成\n#define SYSY_COMPILER_BUILD_ID \"${build_id}\"\n")
+# 内容不变时不改写, 避免重新编译 compiler_context.cpp
+set(old_header "")
+if(EXISTS "${OUTPUT}")
+  file(READ "${OUTPUT}" old_header)
+endif()
+if(NOT old_header STREQUAL header)
+  file(WRITE "${OUTPUT}" "${header}")
+endif()
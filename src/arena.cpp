@@ -0,0 +1,93 @@
+#include "arena.h"
+
+#include <algorithm>
+
+#include "memory_report.h"
+
+Arena::Arena(std::size_t block_size)
+    : block_size_(block_size)
+{
+}
+
+Arena::~Arena()
+{
+    runFinalizers();
+}
+
+void* Arena::allocate(std::size_t size, std::size_t alignment)
+{
+    auto align_cursor = [&]() -> std::byte* {
+        if (cursor_ == nullptr) {
+            return nullptr;
+        }
+        auto address = reinterpret_cast<std::uintptr_t>(cursor_);
+        auto aligned = (address + alignment - 1) & ~(static_cast<std::uintptr_t>(alignment) - 1);
+        return reinterpret_cast<std::byte*>(aligned);
+    };
+
+    std::byte* result = align_cursor();
+    if (result == nullptr || result + size > limit_) {
+        newBlock(size + alignment);
+        result = align_cursor();
+    }
+
+    cursor_ = result + size;
+    bytes_used_ += size;
+    return result;
+}
+
+void Arena::newBlock(std::size_t min_size)
+{
+    // 优先复用 reset() 之后留下来的块
+    std::size_t next = blocks_.empty() || cursor_ == nullptr ? 0 : current_block_ + 1;
+    while (next < blocks_.size() && blocks_[next].size < min_size) {
+        ++next;
+    }
+
+    if (next >= blocks_.size()) {
+        auto size = std::max(block_size_, min_size);
+        blocks_.push_back(Block { std::make_unique<std::byte[]>(size), size });
+        next = blocks_.size() - 1;
+    }
+
+    current_block_ = next;
+    cursor_ = blocks_[next].data.get();
+    limit_ = cursor_ + blocks_[next].size;
+}
+
+void Arena::registerFinalizer(void* object, void (*destroy)(void*))
+{
+    void* memory = allocate(sizeof(Finalizer), alignof(Finalizer));
+    finalizers_ = new (memory) Finalizer { destroy, object, finalizers_ };
+}
+
+void Arena::countObject(const char* kind, std::size_t size)
+{
+    object_counts_->add(kind, size);
+}
+
+void Arena::runFinalizers()
+{
+    for (auto* finalizer = finalizers_; finalizer != nullptr; finalizer = finalizer->next) {
+        finalizer->destroy(finalizer->object);
+    }
+    finalizers_ = nullptr;
+}
+
+void Arena::reset()
+{
+    runFinalizers();
+    current_block_ = 0;
+    cursor_ = nullptr;
+    limit_ = nullptr;
+    bytes_used_ = 0;
+}
+
+std::size_t Arena::bytesReserved() const
+{
+    std::size_t total = 0;
+    for (const auto& block : blocks_) {
+        total += block.size;
+    }
+    return total;
+}
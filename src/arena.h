@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <typeinfo>
+#include <utility>
+#include <vector>
+
+// Arena 中对象的删除器：对象的存储和析构都由 Arena 统一负责，
+// 因此这里什么也不做。树中的智能指针只用来表达父子结构（所有权的转移），
+// 销毁一棵树时不会再逐个节点递归释放。
+struct ArenaDeleter {
+    void operator()(const void* /* ptr */) const noexcept {}
+};
+
+class ObjectCounts;
+
+// AST 节点之间的指针类型
+template <typename T>
+using AstPtr = std::unique_ptr<T, ArenaDeleter>;
+
+// 线性（bump-pointer）分配器
+// 一个编译单元的所有 AST 节点都从这里分配，reset() 时一次性析构并回收，
+// 已经申请的内存块会被保留下来，供下一次编译复用。
+class Arena {
+public:
+    static constexpr std::size_t DEFAULT_BLOCK_SIZE = 64 * 1024;
+
+    explicit Arena(std::size_t block_size = DEFAULT_BLOCK_SIZE);
+    ~Arena();
+
+    // 禁用拷贝和移动，节点中的指针指向 Arena 内部
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    // 分配一段未初始化的内存
+    void* allocate(std::size_t size, std::size_t alignment = alignof(std::max_align_t));
+
+    // 在 Arena 中构造一个对象，非平凡析构的对象会在 reset() 时被析构
+    template <typename T, typename... Args>
+    AstPtr<T> make(Args&&... args)
+    {
+        void* memory = allocate(sizeof(T), alignof(T));
+        T* object = new (memory) T(std::forward<Args>(args)...);
+        if (object_counts_ != nullptr) {
+            countObject(typeid(T).name(), sizeof(T));
+        }
+        if constexpr (!std::is_trivially_destructible_v<T>) {
+            registerFinalizer(object, [](void* ptr) { static_cast<T*>(ptr)->~T(); });
+        }
+        return AstPtr<T>(object);
+    }
+
+    // 析构所有对象，保留内存块以便复用
+    void reset();
+
+    // 按类型统计之后用 make() 构造的对象（见 memory_report.h），nullptr 表示不统计
+    void setObjectCounts(ObjectCounts* counts) { object_counts_ = counts; }
+
+    // 当前已经分配出去的字节数
+    std::size_t bytesUsed() const { return bytes_used_; }
+    // 向系统申请的内存块总大小
+    std::size_t bytesReserved() const;
+
+private:
+    struct Block {
+        std::unique_ptr<std::byte[]> data;
+        std::size_t size;
+    };
+
+    // 析构记录本身也分配在 Arena 中，按构造的逆序析构
+    struct Finalizer {
+        void (*destroy)(void*);
+        void* object;
+        Finalizer* next;
+    };
+
+    void registerFinalizer(void* object, void (*destroy)(void*));
+    void countObject(const char* kind, std::size_t size);
+    void runFinalizers();
+    void newBlock(std::size_t min_size);
+
+    std::vector<Block> blocks_;
+    std::size_t current_block_ = 0; // 正在使用的内存块下标
+    std::byte* cursor_ = nullptr; // 当前块中下一个可用位置
+    std::byte* limit_ = nullptr; // 当前块的末尾
+    std::size_t block_size_;
+    std::size_t bytes_used_ = 0;
+    Finalizer* finalizers_ = nullptr;
+    ObjectCounts* object_counts_ = nullptr;
+};
@@ -2,14 +2,16 @@
 
 #include <cstdint>
 #include <iostream>
-#include <map>
 #include <memory>
 #include <optional>
 #include <string>
 #include <variant>
 #include <vector>
 
+#include "arena.h"
+#include "koopa_builder.h"
 #include "string_format.h"
+#include "string_interner.h"
 #include "symbol_table.h"
 
 // Forward declarations for all AST node classes
@@ -28,24 +30,8 @@ class IfElseStmtAST;
 class WhileStmtAST;
 class BreakStmtAST;
 class ContinueStmtAST;
-class NumberAST;
 
 class ExpAST;
-class PrimaryExpAST;
-class UnaryExpOpAndExpAST;
-class UnaryExpAST;
-class AddExpAST;
-class AddExpOpAndMulExpAST;
-class MulExpAST;
-class MulExpOpAndExpAST;
-class RelExpAST;
-class RelExpOpAndAddExpAST;
-class EqExpAST;
-class EqExpOpAndRelExpAST;
-class LAndExpAST;
-class LAndExpOpAndEqExpAST;
-class LOrExpAST;
-class LOrExpOpAndLAndExpAST;
 
 class DeclAST;
 class ConstDeclAST;
@@ -63,35 +49,34 @@ enum UnaryOp : std::uint8_t {
     UNARY_OP_NOT, // !
 };
 
-enum MulOp : std::uint8_t {
-    MUL_OP_MUL, // *
-    MUL_OP_DIV, // /
-    MUL_OP_MOD, // %
-};
-
-enum AddOp : std::uint8_t {
-    ADD_OP_ADD, // +
-    ADD_OP_SUB, // -
-};
-
-enum RelOp : std::uint8_t {
-    REL_OP_LT, // <
-    REL_OP_LE, // <=
-    REL_OP_GT, // >
-    REL_OP_GE, // >=
-};
-
-enum EqOp : std::uint8_t {
-    EQ_OP_EQ, // ==
-    EQ_OP_NE, // !=
+// 所有二元运算符，按优先级从高到低排列
+enum BinaryOp : std::uint8_t {
+    BINARY_OP_MUL, // *
+    BINARY_OP_DIV, // /
+    BINARY_OP_MOD, // %
+    BINARY_OP_ADD, // +
+    BINARY_OP_SUB, // -
+    BINARY_OP_LT, // <
+    BINARY_OP_LE, // <=
+    BINARY_OP_GT, // >
+    BINARY_OP_GE, // >=
+    BINARY_OP_EQ, // ==
+    BINARY_OP_NE, // !=
+    BINARY_OP_LAND, // &&
+    BINARY_OP_LOR, // ||
 };
 
 enum BType : std::uint8_t {
     BT_INT, // int
 };
 
-// LAndOp 和 LOrOp 不需要枚举，因为它们没有额外的操作符
 
+// 一段 token 的范围，first 和 last 是 token 在输入中的序号（从 0 开始，包含两端）
+// 用作 Bison 的位置类型，规则的位置由其第一个和最后一个符号的位置得到
+struct TokenSpan {
+    int first;
+    int last;
+};
 
 // 所有 AST 的基类
 class BaseAST {
@@ -99,36 +84,9 @@ public:
     virtual ~BaseAST() = default;
 
     virtual void Dump() const;
-    virtual std::string toKoopa() const;
 
     // 添加常量求值方法 - 如果表达式是常量则返回其值，否则返回nullopt
-    virtual std::optional<int> evaluateConstant(SymbolTable& symbol_table) const;
-
-    // 全局符号表引用（在main中初始化）
-    static SymbolTable* global_symbol_table;
-
-    static int getNewTempVar() {
-        static int temp_var_count = 0;
-        return temp_var_count++;
-    }
-
-    // 重置临时变量计数器（在每个函数开始时调用）
-    static void resetTempVarCounter() {
-        static int temp_var_count = 0;
-        temp_var_count = 0;
-    }
-};
-
-// Number
-class NumberAST : public BaseAST {
-public:
-    int value;
-
-    explicit NumberAST(int val);
-
-    void Dump() const override;
-    std::string toKoopa() const override;
-    std::optional<int> evaluateConstant(SymbolTable& symbol_table) const override;
+    virtual std::optional<int> evaluateConstant() const;
 };
 
 // FuncType
@@ -140,43 +98,36 @@ public:
     FuncTypeAST(const std::string& name);
 
     void Dump() const override;
-    std::string toKoopa() const override;
-
-private:
-    std::map<std::string, std::string> koopa_type_map = {
-        { "int", "i32" },
-        { "void", "void" },
-    };
 };
 
 class StmtAST : public BaseAST {
 public:
-    std::variant<std::unique_ptr<LValEqExpStmtAST>, std::unique_ptr<ReturnExpStmtAST>,
-        std::unique_ptr<OptionalExpStmtAST>, std::unique_ptr<BlockStmtAST>, 
-        std::unique_ptr<IfElseStmtAST>, std::unique_ptr<WhileStmtAST>,
-        std::unique_ptr<BreakStmtAST>, std::unique_ptr<ContinueStmtAST>>
+    std::variant<AstPtr<LValEqExpStmtAST>, AstPtr<ReturnExpStmtAST>,
+        AstPtr<OptionalExpStmtAST>, AstPtr<BlockStmtAST>, 
+        AstPtr<IfElseStmtAST>, AstPtr<WhileStmtAST>,
+        AstPtr<BreakStmtAST>, AstPtr<ContinueStmtAST>>
         statement;
 
-    StmtAST(std::unique_ptr<LValEqExpStmtAST> lval_eq_exp_stmt)
+    StmtAST(AstPtr<LValEqExpStmtAST> lval_eq_exp_stmt)
         : statement(std::move(lval_eq_exp_stmt)) {}
-    StmtAST(std::unique_ptr<ReturnExpStmtAST> return_exp_stmt)
+    StmtAST(AstPtr<ReturnExpStmtAST> return_exp_stmt)
         : statement(std::move(return_exp_stmt)) {}
-    StmtAST(std::unique_ptr<OptionalExpStmtAST> optional_exp_stmt)
+    StmtAST(AstPtr<OptionalExpStmtAST> optional_exp_stmt)
         : statement(std::move(optional_exp_stmt)) {}
-    StmtAST(std::unique_ptr<BlockStmtAST> block_stmt)
+    StmtAST(AstPtr<BlockStmtAST> block_stmt)
         : statement(std::move(block_stmt)) {}
-    StmtAST(std::unique_ptr<IfElseStmtAST> if_else_stmt)
+    StmtAST(AstPtr<IfElseStmtAST> if_else_stmt)
         : statement(std::move(if_else_stmt)) {}
-    StmtAST(std::unique_ptr<WhileStmtAST> while_stmt)
+    StmtAST(AstPtr<WhileStmtAST> while_stmt)
         : statement(std::move(while_stmt)) {}
-    StmtAST(std::unique_ptr<BreakStmtAST> break_stmt)
+    StmtAST(AstPtr<BreakStmtAST> break_stmt)
         : statement(std::move(break_stmt)) {}
-    StmtAST(std::unique_ptr<ContinueStmtAST> continue_stmt)
+    StmtAST(AstPtr<ContinueStmtAST> continue_stmt)
         : statement(std::move(continue_stmt)) {}
     
     void Dump() const override;
-    std::string toKoopa() const override;
-    std::string toKoopa(std::vector<std::string>& generated_instructions, SymbolTable& symbol_table) const;
+    void toKoopa(KoopaBuilder& builder) const;
+    void resolve(SymbolTable& symbol_table);
 };
 
 class BreakStmtAST : public BaseAST {
@@ -190,7 +141,7 @@ public:
         std::cout << "BreakStmtAST { break; }";
     }
 
-    std::string toKoopa(std::vector<std::string>& generated_instructions, SymbolTable& symbol_table);
+    void toKoopa(KoopaBuilder& builder);
 };
 
 class ContinueStmtAST : public BaseAST {
@@ -204,20 +155,21 @@ public:
         std::cout << "ContinueStmtAST { continue; }";
     }
 
-    std::string toKoopa(std::vector<std::string>& generated_instructions, SymbolTable& symbol_table);
+    void toKoopa(KoopaBuilder& builder);
 };
 
 class WhileStmtAST : public BaseAST {
 public:
-    std::unique_ptr<ExpAST> condition; // 循环条件表达式
-    std::unique_ptr<StmtAST> body; // 循环体
+    AstPtr<ExpAST> condition; // 循环条件表达式
+    AstPtr<StmtAST> body; // 循环体
     std::optional<int> loop_id; // 循环 ID，用于生成唯一的标签
 
-    WhileStmtAST(std::unique_ptr<ExpAST> cond, std::unique_ptr<StmtAST> body_stmt)
-        : condition(std::move(cond)), body(std::move(body_stmt)), loop_id(getNewTempVar()) {}
+    WhileStmtAST(AstPtr<ExpAST> cond, AstPtr<StmtAST> body_stmt)
+        : condition(std::move(cond)), body(std::move(body_stmt)) {}
     
     void Dump() const override;
-    std::string toKoopa(std::vector<std::string>& generated_instructions, SymbolTable& symbol_table);
+    void toKoopa(KoopaBuilder& builder);
+    void resolve(SymbolTable& symbol_table);
     void setBodyLoopIds(int loop_id) const;
 
 private:
@@ -227,415 +179,258 @@ private:
 
 class LValEqExpStmtAST : public BaseAST {
 public:
-    std::unique_ptr<LValAST> lval; // 左值
-    std::unique_ptr<ExpAST> expression; // 右值表达式
+    AstPtr<LValAST> lval; // 左值
+    AstPtr<ExpAST> expression; // 右值表达式
 
-    LValEqExpStmtAST(std::unique_ptr<LValAST> lval, std::unique_ptr<ExpAST> exp)
+    LValEqExpStmtAST(AstPtr<LValAST> lval, AstPtr<ExpAST> exp)
         : lval(std::move(lval)), expression(std::move(exp)) {}
     
     void Dump() const override;
-    std::string toKoopa(std::vector<std::string>& generated_instructions, SymbolTable& symbol_table) const;
+    void toKoopa(KoopaBuilder& builder) const;
+    void resolve(SymbolTable& symbol_table);
 };
 
 class OptionalExpStmtAST : public BaseAST {
 public:
-    std::optional<std::unique_ptr<ExpAST>> expression; // 可选的表达式
+    std::optional<AstPtr<ExpAST>> expression; // 可选的表达式
 
-    OptionalExpStmtAST(std::unique_ptr<ExpAST> exp)
+    OptionalExpStmtAST(AstPtr<ExpAST> exp)
         : expression(std::move(exp)) {}
     OptionalExpStmtAST(): expression(std::nullopt) {}
     
     void Dump() const override;
-    std::string toKoopa(std::vector<std::string>& generated_instructions, SymbolTable& symbol_table) const;
+    void toKoopa(KoopaBuilder& builder) const;
+    void resolve(SymbolTable& symbol_table);
 };
 
 class BlockStmtAST : public BaseAST {
 public:
-    std::unique_ptr<BlockAST> block; // 块内容
+    AstPtr<BlockAST> block; // 块内容
 
-    explicit BlockStmtAST(std::unique_ptr<BlockAST> blk)
+    explicit BlockStmtAST(AstPtr<BlockAST> blk)
         : block(std::move(blk)) {}
     
     void Dump() const override;
-    std::string toKoopa(std::vector<std::string>& generated_instructions, SymbolTable& symbol_table) const;
+    void toKoopa(KoopaBuilder& builder) const;
+    void resolve(SymbolTable& symbol_table);
 };
 
 // Stmt
 class ReturnExpStmtAST : public BaseAST {
 public:
     // Stmt -> "return" Exp ";"
-    // std::unique_ptr<NumberAST> number;
-    std::optional<std::unique_ptr<ExpAST>> expression;
-
-    std::vector<std::string> generated_instructions; // 存储中间过程用于计算的 IR 指令
+    // AstPtr<NumberAST> number;
+    std::optional<AstPtr<ExpAST>> expression;
 
-    ReturnExpStmtAST(std::optional<std::unique_ptr<ExpAST>> exp);
+    ReturnExpStmtAST(std::optional<AstPtr<ExpAST>> exp);
 
     void Dump() const override;
-    std::string toKoopa() const override;
-    std::string toKoopa() ;
+    void toKoopa(KoopaBuilder& builder) const;
+    void resolve(SymbolTable& symbol_table);
 };
 
 class IfElseStmtAST : public BaseAST {
 public:
-    std::unique_ptr<ExpAST> condition; // 条件表达式
-    std::unique_ptr<StmtAST> then_stmt; // if 分支语句
-    std::optional<std::unique_ptr<StmtAST>> else_stmt; // 可选的 else 分支语句
+    AstPtr<ExpAST> condition; // 条件表达式
+    AstPtr<StmtAST> then_stmt; // if 分支语句
+    std::optional<AstPtr<StmtAST>> else_stmt; // 可选的 else 分支语句
 
-    IfElseStmtAST(std::unique_ptr<ExpAST> cond, std::unique_ptr<StmtAST> then_stmt,
-        std::optional<std::unique_ptr<StmtAST>> else_stmt = std::nullopt)
+    IfElseStmtAST(AstPtr<ExpAST> cond, AstPtr<StmtAST> then_stmt,
+        std::optional<AstPtr<StmtAST>> else_stmt = std::nullopt)
         : condition(std::move(cond))
         , then_stmt(std::move(then_stmt))
         , else_stmt(std::move(else_stmt))
     {}
 
     void Dump() const override;
-    std::string toKoopa(std::vector<std::string>& generated_instructions, SymbolTable& symbol_table) const;
+    void toKoopa(KoopaBuilder& builder) const;
+    void resolve(SymbolTable& symbol_table);
 };
 
 // Block
 class BlockAST : public BaseAST {
 public:
-    std::vector<std::unique_ptr<BlockItemAST>> block_items; // BlockItem 列表
+    std::vector<AstPtr<BlockItemAST>> block_items; // BlockItem 列表
 
-    explicit BlockAST(std::vector<std::unique_ptr<BlockItemAST>> items)
+    explicit BlockAST(std::vector<AstPtr<BlockItemAST>> items)
         : block_items(std::move(items)) {}
     BlockAST() = default;
 
     void Dump() const override;
-    std::string toKoopa() const override;
-    
-    // 处理块中的声明，维护符号表
-    std::string toKoopa(std::vector<std::string>& generated_instructions, SymbolTable& symbol_table) const;
+    void toKoopa(KoopaBuilder& builder) const;
+
+    // 块内的声明只在块的作用域内可见
+    void resolve(SymbolTable& symbol_table);
 };
 
 class BlockItemAST : public BaseAST {
 public:
     // BlockItem 可以是声明或语句
-    std::variant<std::unique_ptr<DeclAST>, std::unique_ptr<StmtAST>> item;
+    std::variant<AstPtr<DeclAST>, AstPtr<StmtAST>> item;
 
-    explicit BlockItemAST(std::unique_ptr<DeclAST> decl)
+    explicit BlockItemAST(AstPtr<DeclAST> decl)
         : item(std::move(decl)) {}
-    explicit BlockItemAST(std::unique_ptr<StmtAST> stmt)
+    explicit BlockItemAST(AstPtr<StmtAST> stmt)
         : item(std::move(stmt)) {}
 
     void Dump() const override;
     
-    // 处理BlockItem，维护符号表并生成IR
-    std::string toKoopa(std::vector<std::string>& generated_instructions, SymbolTable& symbol_table) const;
+    // 处理BlockItem并生成IR
+    void toKoopa(KoopaBuilder& builder) const;
+    void resolve(SymbolTable& symbol_table);
 };
 
 // FuncDef 也是 BaseAST
 class FuncDefAST : public BaseAST {
 public:
-    std::unique_ptr<FuncTypeAST> func_type;
-    std::string ident;
-    std::unique_ptr<BlockAST> block;
+    AstPtr<FuncTypeAST> func_type;
+    InternedString ident;
+    AstPtr<BlockAST> block;
+    TokenSpan tokens {}; // 函数定义的 token 范围，用于按函数缓存生成的代码
 
-    FuncDefAST(std::unique_ptr<FuncTypeAST> type, const std::string& id, std::unique_ptr<BlockAST> blk);
+    FuncDefAST(AstPtr<FuncTypeAST> type, InternedString id, AstPtr<BlockAST> blk);
 
     void Dump() const override;
-    // std::string toKoopa() const override;
-    std::string toKoopa(std::vector<std::string>& generated_instructions) const;
-
-private:
-    // Helper function to remove duplicate return statements in basic blocks
-    void removeDuplicateReturns(std::vector<std::string>& instructions) const;
-    void removeUnreachableInstructions(std::vector<std::string>& instructions) const;
+    void toKoopa(KoopaBuilder& builder) const;
+    void resolve(SymbolTable& symbol_table);
 };
 
 // CompUnit 是 BaseAST
 class CompUnitAST : public BaseAST {
 public:
     // 用智能指针管理对象
-    std::unique_ptr<FuncDefAST> func_def;
-
-    CompUnitAST(std::unique_ptr<FuncDefAST> func);
-
-    void Dump() const override;
-    std::string toKoopa() const override;
-    std::string toKoopa(std::vector<std::string>& generated_instructions) const;
-};
-
-/// 一元表达式
-
-class PrimaryExpAST : public BaseAST {
-public:
-    std::variant<std::unique_ptr<ExpAST>, NumberAST, std::unique_ptr<LValAST>> expression;
+    AstPtr<FuncDefAST> func_def;
 
-    explicit PrimaryExpAST(std::unique_ptr<ExpAST> exp)
-        : expression(std::move(exp)) {}
-    explicit PrimaryExpAST(NumberAST number)
-        : expression(std::move(number)) {}
-    explicit PrimaryExpAST(std::unique_ptr<LValAST> lval)
-        : expression(std::move(lval)) {}
+    CompUnitAST(AstPtr<FuncDefAST> func);
 
     void Dump() const override;
-    std::string toKoopa(std::vector<std::string>& generated_instructions);
-    std::optional<int> evaluateConstant(SymbolTable& symbol_table) const override;
-};
-
-class UnaryExpAST : public BaseAST {
-public:
-    std::variant<std::unique_ptr<PrimaryExpAST>, std::unique_ptr<UnaryExpOpAndExpAST>> expression;
+    // 在 builder 中构造整个编译单元的 Koopa IR
+    void toKoopa(KoopaBuilder& builder) const;
 
-    explicit UnaryExpAST(std::unique_ptr<PrimaryExpAST> primary_exp)
-        : expression(std::move(primary_exp)) {}
-    explicit UnaryExpAST(std::unique_ptr<UnaryExpOpAndExpAST> unary_exp_op_and_exp)
-        : expression(std::move(unary_exp_op_and_exp)) {}
-    
-    void Dump() const override;
-    std::string toKoopa(std::vector<std::string>& generated_instructions);
-    std::optional<int> evaluateConstant(SymbolTable& symbol_table) const override;
+    // 名字解析，在解析完成后、生成 IR 之前调用一次
+    // 把每个标识符绑定到符号表中的记录，并折叠常量的值
+    void resolve(SymbolTable& symbol_table);
 };
 
-// UnaryOp UnaryExp
-class UnaryExpOpAndExpAST : public BaseAST {
-public:
-    UnaryOp op; // 一元运算符
-    std::unique_ptr<UnaryExpAST> latter_expression;
-
-    UnaryExpOpAndExpAST(UnaryOp operation, std::unique_ptr<UnaryExpAST> exp)
-        : op(operation), latter_expression(std::move(exp)) {}
-    
-    void Dump() const override;
-    std::string toKoopa(std::vector<std::string>& generated_instructions);
-    std::optional<int> evaluateConstant(SymbolTable& symbol_table) const override;
+// 表达式
+// 数字、左值、一元运算和二元运算共用这一种紧凑的节点，按 kind 区分，
+// 运算符的优先级和结合性由 sysy.y 中的优先级声明决定，不再为每一层优先级生成包装节点。
+enum ExpKind : std::uint8_t {
+    EXP_NUMBER, // 整数字面量
+    EXP_LVAL, // 左值
+    EXP_UNARY, // 一元运算
+    EXP_BINARY, // 二元运算
 };
 
 class ExpAST : public BaseAST {
 public:
-    std::unique_ptr<LOrExpAST> expression;
-
-    explicit ExpAST(std::unique_ptr<LOrExpAST> add_exp)
-        : expression(std::move(add_exp)) {}
-    
-    void Dump() const override;
-    std::string toKoopa(std::vector<std::string>& generated_instructions);
-    std::optional<int> evaluateConstant(SymbolTable& symbol_table) const override;
-};
-
-class MulExpOpAndExpAST : public BaseAST {
-public:
-    MulOp op; // 乘法运算符
-    std::unique_ptr<MulExpAST> first_expression;
-    std::unique_ptr<UnaryExpAST> latter_expression;
-
-    MulExpOpAndExpAST(MulOp operation, std::unique_ptr<MulExpAST> first_exp, std::unique_ptr<UnaryExpAST> latter_exp)
-        : op(operation), first_expression(std::move(first_exp)), latter_expression(std::move(latter_exp)) {}
-
-    void Dump() const override;
-    std::string toKoopa(std::vector<std::string>& generated_instructions);
-    std::optional<int> evaluateConstant(SymbolTable& symbol_table) const override;
-};
-
-class MulExpAST : public BaseAST {
-public:
-    std::variant<std::unique_ptr<UnaryExpAST>, std::unique_ptr<MulExpOpAndExpAST>> expression;
-    
-    explicit MulExpAST(std::unique_ptr<UnaryExpAST> unary_exp)
-        : expression(std::move(unary_exp)) {}
-    explicit MulExpAST(std::unique_ptr<MulExpOpAndExpAST> mul_exp_op_and_exp)
-        : expression(std::move(mul_exp_op_and_exp)) {}
-
-    void Dump() const override;
-    std::string toKoopa(std::vector<std::string>& generated_instructions);
-    std::optional<int> evaluateConstant(SymbolTable& symbol_table) const override;
-};
-
-class AddExpOpAndMulExpAST : public BaseAST {
-public:
-    AddOp op; // 加法运算符
-    std::unique_ptr<AddExpAST> first_expression;
-    std::unique_ptr<MulExpAST> latter_expression;
-
-    AddExpOpAndMulExpAST(AddOp operation, std::unique_ptr<AddExpAST> first_exp, std::unique_ptr<MulExpAST> latter_exp)
-        : op(operation), first_expression(std::move(first_exp)), latter_expression(std::move(latter_exp)) {}
-
-    void Dump() const override;
-    std::string toKoopa(std::vector<std::string>& generated_instructions);
-    std::optional<int> evaluateConstant(SymbolTable& symbol_table) const override;
-};
-
-class AddExpAST : public BaseAST {
-public:
-    std::variant<std::unique_ptr<MulExpAST>, std::unique_ptr<AddExpOpAndMulExpAST>> expression;
-
-    explicit AddExpAST(std::unique_ptr<MulExpAST> mul_exp)
-        : expression(std::move(mul_exp)) {}
-    explicit AddExpAST(std::unique_ptr<AddExpOpAndMulExpAST> add_exp_op_and_mul_exp)
-        : expression(std::move(add_exp_op_and_mul_exp)) {}
-    
-    void Dump() const override;
-    std::string toKoopa(std::vector<std::string>& generated_instructions);
-    std::optional<int> evaluateConstant(SymbolTable& symbol_table) const override;
-};
-
-class RelExpOpAndAddExpAST : public BaseAST {
-public:
-    RelOp op; // 关系运算符
-    std::unique_ptr<RelExpAST> first_expression;
-    std::unique_ptr<AddExpAST> latter_expression;
-
-    RelExpOpAndAddExpAST(RelOp operation, std::unique_ptr<RelExpAST> first_exp, std::unique_ptr<AddExpAST> latter_exp)
-        : op(operation), first_expression(std::move(first_exp)), latter_expression(std::move(latter_exp)) {}
-
-    void Dump() const override;
-    std::string toKoopa(std::vector<std::string>& generated_instructions);
-    std::optional<int> evaluateConstant(SymbolTable& symbol_table) const override;
-};
-
-class RelExpAST : public BaseAST {
-public:
-    std::variant<std::unique_ptr<AddExpAST>, std::unique_ptr<RelExpOpAndAddExpAST>> expression;
-
-    explicit RelExpAST(std::unique_ptr<AddExpAST> add_exp)
-        : expression(std::move(add_exp)) {}
-    explicit RelExpAST(std::unique_ptr<RelExpOpAndAddExpAST> rel_exp)
-        : expression(std::move(rel_exp)) {}
-    
-    void Dump() const override;
-    std::string toKoopa(std::vector<std::string>& generated_instructions);
-    std::optional<int> evaluateConstant(SymbolTable& symbol_table) const override;
-};
-
-class EqExpOpAndRelExpAST : public BaseAST {
-public:
-    EqOp op; // 相等运算符
-    std::unique_ptr<EqExpAST> first_expression;
-    std::unique_ptr<RelExpAST> latter_expression;
-
-    EqExpOpAndRelExpAST(EqOp operation, std::unique_ptr<EqExpAST> first_exp, std::unique_ptr<RelExpAST> latter_exp)
-        : op(operation), first_expression(std::move(first_exp)), latter_expression(std::move(latter_exp)) {}
-    
-    void Dump() const override;
-    std::string toKoopa(std::vector<std::string>& generated_instructions);
-    std::optional<int> evaluateConstant(SymbolTable& symbol_table) const override;
-};
-
-class EqExpAST : public BaseAST {
-public:
-    std::variant<std::unique_ptr<RelExpAST>, std::unique_ptr<EqExpOpAndRelExpAST>> expression;
-
-    explicit EqExpAST(std::unique_ptr<RelExpAST> rel_exp)
-        : expression(std::move(rel_exp)) {}
-    explicit EqExpAST(std::unique_ptr<EqExpOpAndRelExpAST> eq_exp_op_and_rel_exp)
-        : expression(std::move(eq_exp_op_and_rel_exp)) {}
-    
-    void Dump() const override;
-    std::string toKoopa(std::vector<std::string>& generated_instructions);
-    std::optional<int> evaluateConstant(SymbolTable& symbol_table) const override;
-};
+    ExpKind kind;
+    UnaryOp unary_op = UNARY_OP_POSITIVE; // kind == EXP_UNARY 时有效
+    BinaryOp binary_op = BINARY_OP_ADD; // kind == EXP_BINARY 时有效
+    int value = 0; // kind == EXP_NUMBER 时有效
+    AstPtr<LValAST> lval; // kind == EXP_LVAL 时有效
+    AstPtr<ExpAST> lhs; // 一元运算的操作数，或二元运算的左操作数
+    AstPtr<ExpAST> rhs; // 二元运算的右操作数
+
+    explicit ExpAST(int number)
+        : kind(EXP_NUMBER), value(number) {}
+    explicit ExpAST(AstPtr<LValAST> lval)
+        : kind(EXP_LVAL), lval(std::move(lval)) {}
+    ExpAST(UnaryOp op, AstPtr<ExpAST> operand)
+        : kind(EXP_UNARY), unary_op(op), lhs(std::move(operand)) {}
+    ExpAST(BinaryOp op, AstPtr<ExpAST> left, AstPtr<ExpAST> right)
+        : kind(EXP_BINARY), binary_op(op), lhs(std::move(left)), rhs(std::move(right)) {}
+
+    void Dump() const override;
+    // 生成表达式的 IR，返回表达式的值
+    koopa_raw_value_t toKoopa(KoopaBuilder& builder);
+    // 常量求值，结果（值或"不是常量"）在第一次求值后缓存在节点上，每个子树最多求值一次
+    std::optional<int> evaluateConstant() const override;
+    void resolve(SymbolTable& symbol_table);
+
+    // 是否为编译期常量，首次调用之后为 O(1)
+    bool isConstant() const { return evaluateConstant().has_value(); }
 
-class LAndExpOpAndEqExpAST : public BaseAST {
-public:
-    std::unique_ptr<LAndExpAST> first_expression;
-    std::unique_ptr<EqExpAST> latter_expression;
-
-    LAndExpOpAndEqExpAST(std::unique_ptr<LAndExpAST> first_exp, std::unique_ptr<EqExpAST> latter_exp)
-        : first_expression(std::move(first_exp)), latter_expression(std::move(latter_exp)) {}
-    
-    void Dump() const override;
-    std::string toKoopa(std::vector<std::string>& generated_instructions);
-    std::optional<int> evaluateConstant(SymbolTable& symbol_table) const override;
-};
-
-class LAndExpAST : public BaseAST {
-public:
-    std::variant<std::unique_ptr<EqExpAST>, std::unique_ptr<LAndExpOpAndEqExpAST>> expression;
-
-    explicit LAndExpAST(std::unique_ptr<EqExpAST> eq_exp)
-        : expression(std::move(eq_exp)) {}
-    explicit LAndExpAST(std::unique_ptr<LAndExpOpAndEqExpAST> land_exp_op_and_eq_exp)
-        : expression(std::move(land_exp_op_and_eq_exp)) {}
-
-    void Dump() const override;
-    std::string toKoopa(std::vector<std::string>& generated_instructions);
-    std::optional<int> evaluateConstant(SymbolTable& symbol_table) const override;
-};
-
-class LOrExpOpAndLAndExpAST : public BaseAST {
-public:
-    std::unique_ptr<LOrExpAST> first_expression;
-    std::unique_ptr<LAndExpAST> latter_expression;
-
-    LOrExpOpAndLAndExpAST(std::unique_ptr<LOrExpAST> first_exp, std::unique_ptr<LAndExpAST> latter_exp)
-        : first_expression(std::move(first_exp)), latter_expression(std::move(latter_exp)) {}
-    
-    void Dump() const override;
-    std::string toKoopa(std::vector<std::string>& generated_instructions);
-    std::optional<int> evaluateConstant(SymbolTable& symbol_table) const override;
-};
+private:
+    enum ConstState : std::uint8_t {
+        CONST_UNKNOWN, // 还没有求值过
+        CONST_VALUE, // 是常量，值保存在 const_value 中
+        CONST_NONE, // 不是常量
+    };
 
-class LOrExpAST : public BaseAST {
-public:
-    std::variant<std::unique_ptr<LAndExpAST>, std::unique_ptr<LOrExpOpAndLAndExpAST>> expression;
+    // 常量求值的缓存，名字解析会改变 LVal 的绑定，因此 resolve() 时清空
+    mutable ConstState const_state = CONST_UNKNOWN;
+    mutable int const_value = 0;
 
-    explicit LOrExpAST(std::unique_ptr<LAndExpAST> land_exp)
-        : expression(std::move(land_exp)) {}
-    explicit LOrExpAST(std::unique_ptr<LOrExpOpAndLAndExpAST> lor_exp_op_and_land_exp)
-        : expression(std::move(lor_exp_op_and_land_exp)) {}
+    // 假定子表达式已经求值过，只计算本节点
+    std::optional<int> computeConstant() const;
 
-    void Dump() const override;
-    std::string toKoopa(std::vector<std::string>& generated_instructions);
-    std::optional<int> evaluateConstant(SymbolTable& symbol_table) const override;
+    // 以下函数只处理单个节点，操作数由 toKoopa 的工作栈事先求出
+    koopa_raw_value_t lvalToKoopa(KoopaBuilder& builder) const;
+    koopa_raw_value_t unaryToKoopa(koopa_raw_value_t operand, KoopaBuilder& builder) const;
+    // && 和 || 的短路求值，分为求出左操作数之后的分支部分，和求出右操作数之后的汇合部分
+    // 分支部分返回保存结果的变量，汇合部分从中读出表达式的值
+    koopa_raw_value_t shortCircuitBranchToKoopa(int result_var, koopa_raw_value_t lhs, KoopaBuilder& builder) const;
+    koopa_raw_value_t shortCircuitMergeToKoopa(int result_var, koopa_raw_value_t result, koopa_raw_value_t rhs, KoopaBuilder& builder) const;
 };
 
 class DeclAST : public BaseAST {
 public:
-    std::variant<std::unique_ptr<ConstDeclAST>, std::unique_ptr<VarDeclAST>> declaration;
+    std::variant<AstPtr<ConstDeclAST>, AstPtr<VarDeclAST>> declaration;
     
-    DeclAST(std::unique_ptr<ConstDeclAST> decl)
+    DeclAST(AstPtr<ConstDeclAST> decl)
         : declaration(std::move(decl)) {}
-    DeclAST(std::unique_ptr<VarDeclAST> decl)
+    DeclAST(AstPtr<VarDeclAST> decl)
         : declaration(std::move(decl)) {}
 
     void Dump() const override;
-    std::string toKoopa(std::vector<std::string>& generated_instructions, SymbolTable& symbol_table) const;
+    void toKoopa(KoopaBuilder& builder) const;
+    void resolve(SymbolTable& symbol_table);
 };
 
 class ConstDeclAST : public BaseAST {
 public:
     BType btype; // 基本类型
-    std::vector<std::unique_ptr<ConstDefAST>> const_defs; // 常量定义列表
+    std::vector<AstPtr<ConstDefAST>> const_defs; // 常量定义列表
 
-    ConstDeclAST(BType type, std::vector<std::unique_ptr<ConstDefAST>> defs)
+    ConstDeclAST(BType type, std::vector<AstPtr<ConstDefAST>> defs)
         : btype(type), const_defs(std::move(defs)) {}
     explicit ConstDeclAST(BType type)
         : btype(type) {}
     
-    ConstDeclAST(BType type, std::unique_ptr<ConstDefAST> def)
+    ConstDeclAST(BType type, AstPtr<ConstDefAST> def)
         : btype(type) {
         const_defs.push_back(std::move(def));
     }
 
-    void pushConstDef(std::unique_ptr<ConstDefAST> def) {
+    void pushConstDef(AstPtr<ConstDefAST> def) {
         const_defs.push_back(std::move(def));
     }
 
     void Dump() const override;
-    // 处理常量声明并添加到符号表
-    void processConstDecl(SymbolTable& symbol_table) const;
+    // 求出常量的值并添加到符号表
+    void resolve(SymbolTable& symbol_table);
 };
 
 class ConstDefAST : public BaseAST {
 public:
-    std::string ident; // 标识符
-    std::unique_ptr<ConstInitValAST> const_init_val; // 初始化值
+    InternedString ident; // 标识符
+    AstPtr<ConstInitValAST> const_init_val; // 初始化值
+    const SymbolTableItem* symbol = nullptr; // 名字解析后绑定的符号，初始化值不是常量时为空
 
-    ConstDefAST(const std::string& identifier, std::unique_ptr<ConstInitValAST> init_val)
+    ConstDefAST(InternedString identifier, AstPtr<ConstInitValAST> init_val)
         : ident(identifier), const_init_val(std::move(init_val)) {}
 
     void Dump() const override;
-    // 处理常量定义并添加到符号表，返回常量值
-    std::optional<int> processConstDef(SymbolTable& symbol_table) const;
+    // 求出常量的值并添加到符号表，返回常量值
+    std::optional<int> resolve(SymbolTable& symbol_table);
 };
 
 class ConstInitValAST : public BaseAST {
 public:
-    std::unique_ptr<ConstExpAST> const_exp; // 常量表达式
+    AstPtr<ConstExpAST> const_exp; // 常量表达式
 
-    ConstInitValAST(std::unique_ptr<ConstExpAST> exp)
+    ConstInitValAST(AstPtr<ConstExpAST> exp)
         : const_exp(std::move(exp)) {}
 
     void Dump() const override;
@@ -643,58 +438,63 @@ public:
 
 class ConstExpAST : public BaseAST {
 public:
-    std::unique_ptr<ExpAST> expression; // 表达式
+    AstPtr<ExpAST> expression; // 表达式
 
-    explicit ConstExpAST(std::unique_ptr<ExpAST> exp)
+    explicit ConstExpAST(AstPtr<ExpAST> exp)
         : expression(std::move(exp)) {}
 
     void Dump() const override;
-    std::optional<int> evaluateConstant(SymbolTable& symbol_table) const override;
+    std::optional<int> evaluateConstant() const override;
+    void resolve(SymbolTable& symbol_table);
 };
 
 class LValAST : public BaseAST {
 public:
-    std::string ident; // 标识符
+    InternedString ident; // 标识符
+    const SymbolTableItem* symbol = nullptr; // 名字解析后绑定的符号，未定义的标识符为空
 
-    explicit LValAST(const std::string& id)
+    explicit LValAST(InternedString id)
         : ident(id) {}
 
     void Dump() const override;
-    std::optional<int> evaluateConstant(SymbolTable& symbol_table) const override;
+    std::optional<int> evaluateConstant() const override;
+    void resolve(SymbolTable& symbol_table);
 };
 
 class VarDefAST : public BaseAST {
 public:
-    std::string ident; // 标识符
-    std::optional<std::unique_ptr<ConstInitValAST>> const_init_val; // 可选的常量初始化值
+    InternedString ident; // 标识符
+    std::optional<AstPtr<ConstInitValAST>> const_init_val; // 可选的常量初始化值
+    SymbolTableItem* symbol = nullptr; // 名字解析后绑定的符号，IR 生成时在其中记录变量的 alloc
 
-    VarDefAST(const std::string& identifier, std::unique_ptr<ConstInitValAST> init_val)
+    VarDefAST(InternedString identifier, AstPtr<ConstInitValAST> init_val)
         : ident(identifier), const_init_val(std::move(init_val)) {}
-    VarDefAST(const std::string& identifier)
+    VarDefAST(InternedString identifier)
         : ident(identifier), const_init_val(std::nullopt) {}
     
     void Dump() const override;
-    std::string toKoopa(std::vector<std::string>& generated_instructions, SymbolTable& symbol_table) const;
+    void resolve(SymbolTable& symbol_table, std::string_view type_name);
 };
 
 class VarDeclAST : public BaseAST {
 public:
     BType btype; // 基本类型
-    std::vector<std::unique_ptr<VarDefAST>> var_defs; // 变量定义列表
+    std::vector<AstPtr<VarDefAST>> var_defs; // 变量定义列表
 
-    VarDeclAST(BType type, std::vector<std::unique_ptr<VarDefAST>> defs)
+    VarDeclAST(BType type, std::vector<AstPtr<VarDefAST>> defs)
         : btype(type), var_defs(std::move(defs)) {}
     explicit VarDeclAST(BType type)
         : btype(type) {}
-    VarDeclAST(BType type, std::unique_ptr<VarDefAST> def)
+    VarDeclAST(BType type, AstPtr<VarDefAST> def)
         : btype(type) {
         var_defs.push_back(std::move(def));
     }
-    void pushVarDef(std::unique_ptr<VarDefAST> def) {
+    void pushVarDef(AstPtr<VarDefAST> def) {
         var_defs.push_back(std::move(def));
     }
 
     void Dump() const override;
-    std::string toKoopa(std::vector<std::string>& generated_instructions, SymbolTable& symbol_table) const;
+    void toKoopa(KoopaBuilder& builder) const;
+    void resolve(SymbolTable& symbol_table);
 };
 
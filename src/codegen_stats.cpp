@@ -0,0 +1,52 @@
+#include "codegen_stats.h"
+
+#include <cstdio>
+#include <iterator>
+
+#include "string_format.h"
+
+void CodegenStats::add(const std::string& unit, std::vector<FunctionStats> functions)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& target = units_[unit];
+    target.insert(target.end(), std::make_move_iterator(functions.begin()), std::make_move_iterator(functions.end()));
+}
+
+bool CodegenStats::writeJson(const std::string& path) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    FILE* file = std::fopen(path.c_str(), "w");
+    if (file == nullptr) {
+        return false;
+    }
+
+    std::fputs("{\"units\":[", file);
+    const char* unit_separator = "";
+    for (const auto& [unit, functions] : units_) {
+        std::fprintf(file, "%s\n{\"unit\":\"%s\",\"functions\":[", unit_separator, escapeJson(unit).c_str());
+        unit_separator = ",";
+        const char* function_separator = "";
+        for (const auto& function : functions) {
+            std::fprintf(file,
+                         "%s\n {\"name\":\"%s\",\"koopa_instructions\":%u,\"basic_blocks\":%u,\"riscv_instructions\":%u,"
+                         "\"frame_size\":%d,\"spilled_values\":%u,\"li\":%u,\"loads\":%u,\"stores\":%u,\"blocks\":[",
+                         function_separator, escapeJson(function.name).c_str(), function.koopa_instructions,
+                         function.basic_blocks, function.riscv_instructions, function.frame_size,
+                         function.spilled_values, function.li, function.loads, function.stores);
+            function_separator = ",";
+            const char* block_separator = "";
+            for (const auto& block : function.blocks) {
+                std::fprintf(file,
+                             "%s\n  {\"name\":\"%s\",\"koopa_instructions\":%u,\"riscv_instructions\":%u,\"loads\":%u,"
+                             "\"stores\":%u}",
+                             block_separator, escapeJson(block.name).c_str(), block.koopa_instructions,
+                             block.riscv_instructions, block.loads, block.stores);
+                block_separator = ",";
+            }
+            std::fputs("]}", file);
+        }
+        std::fputs("]}", file);
+    }
+    std::fputs("\n]}\n", file);
+    return std::fclose(file) == 0;
+}
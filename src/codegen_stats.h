@@ -0,0 +1,46 @@
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// 生成代码的质量统计，由后端在生成 RISC-V 汇编时记录（见 KoopaParser::setCollectStats）
+// 用于在不运行目标代码的情况下发现代码生成的退化，例如不同版本之间指令数或溢出到栈上的值变多。
+
+// 一个基本块
+struct BlockStats {
+    std::string name;
+    unsigned koopa_instructions = 0;
+    unsigned riscv_instructions = 0;
+    unsigned loads = 0; // lw
+    unsigned stores = 0; // sw
+};
+
+// 一个函数
+struct FunctionStats {
+    std::string name;
+    unsigned koopa_instructions = 0;
+    unsigned basic_blocks = 0;
+    unsigned riscv_instructions = 0; // 包括 prologue 和 epilogue
+    int frame_size = 0; // getPrologueOffset() 计算的栈帧大小
+    unsigned spilled_values = 0; // 被多次使用（used_by.len > 1）而存到栈上的值
+    unsigned li = 0; // 生成的 li 指令
+    unsigned loads = 0;
+    unsigned stores = 0;
+    std::vector<BlockStats> blocks;
+};
+
+// 多个编译单元的统计，多个线程可以同时添加
+class CodegenStats {
+public:
+    // unit 为编译单元的名字（输入文件）
+    void add(const std::string& unit, std::vector<FunctionStats> functions);
+
+    // 按编译单元的名字排序写出 JSON，结果与批量编译的调度无关；无法写入时返回 false
+    bool writeJson(const std::string& path) const;
+
+private:
+    mutable std::mutex mutex_; // 保护以下状态
+    std::map<std::string, std::vector<FunctionStats>> units_;
+};
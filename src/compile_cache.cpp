@@ -0,0 +1,348 @@
+#include "compile_cache.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <system_error>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "compiler_context.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr std::uint32_t ENTRY_MAGIC = 0x43535953; // "SYSC"
+// 记录格式或键的计算方式改变时加一，旧的记录自然失效
+constexpr std::uint32_t ENTRY_FORMAT = 2;
+
+struct EntryHeader {
+    std::uint32_t magic;
+    std::uint32_t format;
+    std::uint64_t source_size;
+    std::uint64_t output_size;
+};
+
+// 写入中途崩溃的进程留下的临时文件超过这个时间后在淘汰时删除，正常的写入远远用不了这么久
+constexpr auto STALE_TEMP_AGE = std::chrono::minutes(10);
+
+constexpr std::uint64_t PRIME_1 = 0x9E3779B185EBCA87ULL;
+constexpr std::uint64_t PRIME_2 = 0xC2B2AE3D27D4EB4FULL;
+
+inline std::uint64_t rotl(std::uint64_t value, int shift)
+{
+    return (value << shift) | (value >> (64 - shift));
+}
+
+inline std::uint64_t mix(std::uint64_t value)
+{
+    value ^= value >> 33;
+    value *= 0xFF51AFD7ED558CCDULL;
+    value ^= value >> 33;
+    value *= 0xC4CEB9FE1A85EC53ULL;
+    value ^= value >> 33;
+    return value;
+}
+
+inline std::uint64_t load64(const char* data)
+{
+    std::uint64_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+// 128 位的非密码学哈希，每次处理 16 字节，比逐字节的 FNV-1a 快得多
+void hashBytes(std::string_view data, std::uint64_t& high, std::uint64_t& low)
+{
+    std::uint64_t a = high ^ PRIME_1;
+    std::uint64_t b = low ^ PRIME_2;
+    const char* cursor = data.data();
+    std::size_t remaining = data.size();
+    while (remaining >= 16) {
+        a = rotl(a ^ (load64(cursor) * PRIME_2), 31) * PRIME_1;
+        b = rotl(b ^ (load64(cursor + 8) * PRIME_1), 29) * PRIME_2;
+        cursor += 16;
+        remaining -= 16;
+    }
+    char tail[16] = {};
+    std::memcpy(tail, cursor, remaining);
+    a = rotl(a ^ (load64(tail) * PRIME_2), 31) * PRIME_1;
+    b = rotl(b ^ (load64(tail + 8) * PRIME_1), 29) * PRIME_2;
+
+    a ^= data.size();
+    b ^= data.size() * PRIME_1;
+    a += b;
+    b += a;
+    high = mix(a);
+    low = mix(b) + high;
+}
+
+// 加锁打开缓存目录中的统计文件，析构时解锁
+class LockedStats {
+public:
+    LockedStats(const std::string& directory, bool create)
+    {
+        const auto path = directory + "/stats";
+        fd_ = ::open(path.c_str(), create ? (O_RDWR | O_CREAT | O_CLOEXEC) : (O_RDONLY | O_CLOEXEC), 0644);
+        if (fd_ >= 0 && ::flock(fd_, create ? LOCK_EX : LOCK_SH) != 0) {
+            ::close(fd_);
+            fd_ = -1;
+        }
+    }
+
+    ~LockedStats()
+    {
+        if (fd_ >= 0) {
+            ::close(fd_); // 关闭时自动释放 flock
+        }
+    }
+
+    LockedStats(const LockedStats&) = delete;
+    LockedStats& operator=(const LockedStats&) = delete;
+
+    bool valid() const { return fd_ >= 0; }
+
+    CompileCache::Stats read() const
+    {
+        CompileCache::Stats stats;
+        char buffer[256] = {};
+        const auto size = ::pread(fd_, buffer, sizeof(buffer) - 1, 0);
+        if (size > 0) {
+            std::sscanf(buffer, "hits %" SCNu64 "\nmisses %" SCNu64 "\nbytes %" SCNu64, &stats.hits, &stats.misses,
+                        &stats.bytes);
+        }
+        return stats;
+    }
+
+    void write(const CompileCache::Stats& stats)
+    {
+        char buffer[256];
+        const auto size = std::snprintf(buffer, sizeof(buffer), "hits %" PRIu64 "\nmisses %" PRIu64 "\nbytes %" PRIu64 "\n",
+                                        stats.hits, stats.misses, stats.bytes);
+        if (::pwrite(fd_, buffer, size, 0) == size) {
+            (void)::ftruncate(fd_, size);
+        }
+    }
+
+private:
+    int fd_ = -1;
+};
+
+} // namespace
+
+std::string CompileCache::Key::hex() const
+{
+    char buffer[33];
+    std::snprintf(buffer, sizeof(buffer), "%016" PRIx64 "%016" PRIx64, high, low);
+    return buffer;
+}
+
+CompileCache::CompileCache(std::string directory, std::uint64_t max_size)
+    : directory_(std::move(directory))
+    , max_size_(max_size)
+{
+}
+
+CompileCache::~CompileCache()
+{
+    flushStats();
+}
+
+CompileCache::Key CompileCache::makeKey(std::string_view source, CompileMode mode, std::string_view options)
+{
+    Key key { ENTRY_FORMAT, static_cast<std::uint64_t>(mode), source.size() };
+    hashBytes(compilerVersion(), key.high, key.low);
+    hashBytes(options, key.high, key.low);
+    hashBytes(source, key.high, key.low);
+    return key;
+}
+
+CompileCache::Key CompileCache::makeFunctionKey(const std::uint64_t* token_hashes, std::size_t count, CompileMode mode)
+{
+    const std::string_view tokens(reinterpret_cast<const char*>(token_hashes), count * sizeof(std::uint64_t));
+    Key key { ENTRY_FORMAT, static_cast<std::uint64_t>(mode), tokens.size() };
+    hashBytes(compilerVersion(), key.high, key.low);
+    hashBytes("function", key.high, key.low);
+    hashBytes(tokens, key.high, key.low);
+    return key;
+}
+
+std::string CompileCache::entryPath(const Key& key) const
+{
+    const auto hex = key.hex();
+    return directory_ + "/" + hex.substr(0, 2) + "/" + hex;
+}
+
+std::optional<std::string> CompileCache::lookup(const Key& key)
+{
+    const auto path = entryPath(key);
+    FILE* file = std::fopen(path.c_str(), "rb");
+    if (file == nullptr) {
+        ++misses_;
+        return std::nullopt;
+    }
+
+    std::optional<std::string> output;
+    EntryHeader header;
+    if (std::fread(&header, sizeof(header), 1, file) == 1 && header.magic == ENTRY_MAGIC
+        && header.format == ENTRY_FORMAT && header.source_size == key.source_size) {
+        std::string content(header.output_size, '\0');
+        if (std::fread(content.data(), 1, content.size(), file) == content.size()) {
+            output = std::move(content);
+        }
+    }
+    std::fclose(file);
+
+    if (!output) {
+        // 损坏的记录，删除后当作未命中
+        ::unlink(path.c_str());
+        ++misses_;
+        return std::nullopt;
+    }
+
+    // 更新修改时间，供 LRU 淘汰使用
+    ::utimensat(AT_FDCWD, path.c_str(), nullptr, 0);
+    ++hits_;
+    return output;
+}
+
+void CompileCache::store(const Key& key, std::string_view output)
+{
+    const auto path = entryPath(key);
+    const auto parent = fs::path(path).parent_path();
+    std::error_code ec;
+    fs::create_directories(parent, ec);
+    if (ec) {
+        return;
+    }
+
+    // 先写到同一目录下的临时文件，再原子地 rename 成正式的记录
+    const auto temp_path = (parent / (".tmp." + std::to_string(::getpid()) + "." + std::to_string(temp_counter_++))).string();
+    FILE* file = std::fopen(temp_path.c_str(), "wb");
+    if (file == nullptr) {
+        return;
+    }
+    const EntryHeader header { ENTRY_MAGIC, ENTRY_FORMAT, key.source_size, output.size() };
+    bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1
+        && std::fwrite(output.data(), 1, output.size(), file) == output.size();
+    ok = std::fclose(file) == 0 && ok;
+    if (!ok) {
+        ::unlink(temp_path.c_str());
+        return;
+    }
+
+    // 持有锁时替换记录，覆盖同一个键时从统计中减去旧记录的大小
+    LockedStats locked(directory_, true);
+    struct stat old {};
+    const std::uint64_t old_size = ::stat(path.c_str(), &old) == 0 ? old.st_size : 0;
+    if (std::rename(temp_path.c_str(), path.c_str()) != 0) {
+        ::unlink(temp_path.c_str());
+        return;
+    }
+    if (!locked.valid()) {
+        return;
+    }
+    auto stats = locked.read();
+    const auto new_size = sizeof(header) + output.size();
+    stats.bytes = stats.bytes + new_size > old_size ? stats.bytes + new_size - old_size : 0;
+    if (stats.bytes > max_size_) {
+        stats.bytes = evict();
+    }
+    locked.write(stats);
+}
+
+std::uint64_t CompileCache::evict()
+{
+    struct Entry {
+        fs::file_time_type time;
+        std::uint64_t size;
+        fs::path path;
+    };
+
+    // 重新统计所有记录，顺便纠正统计文件中累积的误差（如其他进程写入中途崩溃），并删除过期的临时文件
+    std::vector<Entry> entries;
+    std::uint64_t total = 0;
+    std::error_code ec;
+    const auto stale_before = fs::file_time_type::clock::now() - STALE_TEMP_AGE;
+    for (const auto& subdir : fs::directory_iterator(directory_, ec)) {
+        if (!subdir.is_directory(ec)) {
+            continue;
+        }
+        for (const auto& item : fs::directory_iterator(subdir.path(), ec)) {
+            if (!item.is_regular_file(ec)) {
+                continue;
+            }
+            if (item.path().filename().string().rfind(".tmp.", 0) == 0) {
+                const auto time = item.last_write_time(ec);
+                if (!ec && time < stale_before) {
+                    fs::remove(item.path(), ec);
+                }
+                continue;
+            }
+            if (item.path().filename().string()[0] == '.') {
+                continue;
+            }
+            const auto size = item.file_size(ec);
+            const auto time = item.last_write_time(ec);
+            if (!ec) {
+                entries.push_back({ time, size, item.path() });
+                total += size;
+            }
+        }
+    }
+    if (total <= max_size_) {
+        return total;
+    }
+
+    // 从最久未使用的开始删除，删到上限的 90%，避免每次写入都触发淘汰
+    std::sort(entries.begin(), entries.end(), [](const Entry& lhs, const Entry& rhs) { return lhs.time < rhs.time; });
+    const auto target = max_size_ / 10 * 9;
+    for (const auto& entry : entries) {
+        if (total <= target) {
+            break;
+        }
+        if (fs::remove(entry.path, ec)) {
+            total -= entry.size;
+        }
+    }
+    return total;
+}
+
+void CompileCache::flushStats()
+{
+    const auto hits = hits_.load();
+    const auto misses = misses_.load();
+    const auto new_hits = hits - flushed_hits_.exchange(hits);
+    const auto new_misses = misses - flushed_misses_.exchange(misses);
+    if (new_hits == 0 && new_misses == 0) {
+        return;
+    }
+
+    std::error_code ec;
+    fs::create_directories(directory_, ec);
+    LockedStats locked(directory_, true);
+    if (!locked.valid()) {
+        return;
+    }
+    auto stats = locked.read();
+    stats.hits += new_hits;
+    stats.misses += new_misses;
+    locked.write(stats);
+}
+
+std::optional<CompileCache::Stats> CompileCache::readStats(const std::string& directory)
+{
+    LockedStats locked(directory, false);
+    if (!locked.valid()) {
+        return std::nullopt;
+    }
+    return locked.read();
+}
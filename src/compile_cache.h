@@ -0,0 +1,78 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+enum class CompileMode;
+
+// 以内容寻址的编译结果缓存
+// 键由源代码的哈希、源代码长度、输出模式、影响输出的选项和编译器版本组成，
+// 命中时直接返回上次的输出，完全跳过解析和代码生成。
+//
+// 缓存是一个本地目录，每条记录一个文件 <dir>/<键的前两位>/<键>：
+// - 写入时先写临时文件再 rename，读者不会看到写了一半的记录；
+// - 命中时更新记录的修改时间，总大小超过上限时按修改时间从旧到新淘汰（LRU）；
+// - <dir>/stats 记录累计的命中、未命中次数和记录的总大小，用 flock 保护。
+// 多个进程、多个线程可以同时使用同一个缓存目录。
+class CompileCache {
+public:
+    static constexpr std::uint64_t DEFAULT_MAX_SIZE = 256ull << 20;
+
+    struct Key {
+        std::uint64_t high;
+        std::uint64_t low;
+        std::uint64_t source_size; // 记录中也保存一份，读取时再校验一次
+
+        // 32 位十六进制字符串，用作文件名
+        std::string hex() const;
+    };
+
+    // 缓存目录中累计的统计
+    struct Stats {
+        std::uint64_t hits = 0;
+        std::uint64_t misses = 0;
+        std::uint64_t bytes = 0; // 所有记录的总大小
+    };
+
+    CompileCache(std::string directory, std::uint64_t max_size = DEFAULT_MAX_SIZE);
+    // 把本进程的命中次数累加到统计文件
+    ~CompileCache();
+
+    CompileCache(const CompileCache&) = delete;
+    CompileCache& operator=(const CompileCache&) = delete;
+
+    // options 为其他影响输出的选项（如词法分析器），编译器版本由可执行文件本身决定
+    static Key makeKey(std::string_view source, CompileMode mode, std::string_view options = {});
+    // 单个函数的键，由函数定义中每个 token 的哈希得到，与整个源文件的键互不冲突
+    static Key makeFunctionKey(const std::uint64_t* token_hashes, std::size_t count, CompileMode mode);
+
+    std::optional<std::string> lookup(const Key& key);
+    // 写入失败（如磁盘已满）时静默放弃，缓存只是加速手段
+    void store(const Key& key, std::string_view output);
+
+    // 本进程的命中和未命中次数
+    std::uint64_t hits() const { return hits_; }
+    std::uint64_t misses() const { return misses_; }
+
+    // 把本进程尚未写入的命中次数累加到统计文件
+    void flushStats();
+    // 读取缓存目录中累计的统计，目录不存在时返回 std::nullopt
+    static std::optional<Stats> readStats(const std::string& directory);
+
+private:
+    std::string entryPath(const Key& key) const;
+    // 在持有统计文件锁的情况下淘汰最久未使用的记录，返回剩余记录的总大小
+    std::uint64_t evict();
+
+    std::string directory_;
+    std::uint64_t max_size_;
+    std::atomic<std::uint64_t> hits_ { 0 };
+    std::atomic<std::uint64_t> misses_ { 0 };
+    std::atomic<std::uint64_t> flushed_hits_ { 0 };
+    std::atomic<std::uint64_t> flushed_misses_ { 0 };
+    std::atomic<std::uint64_t> temp_counter_ { 0 };
+};
@@ -0,0 +1,273 @@
+#include "compile_server.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr std::uint32_t PROTOCOL_MAGIC = 0x59535953; // "SYSY"
+constexpr std::uint32_t PROTOCOL_VERSION = 2;
+// 拒绝过大的请求，避免错误的头部导致巨大的内存分配
+constexpr std::uint32_t MAX_SOURCE_SIZE = 256u << 20;
+constexpr std::uint16_t MAX_COMPILER_SIZE = 1024;
+// 客户端等待回复的上限，服务器卡住时改为在本进程内编译
+constexpr timeval CLIENT_TIMEOUT { 60, 0 };
+
+// 回复的状态
+constexpr std::uint32_t STATUS_OK = 0;
+constexpr std::uint32_t STATUS_ERROR = 1; // 编译出错，随后是错误信息
+constexpr std::uint32_t STATUS_WRONG_COMPILER = 2; // 服务器是另一个版本的编译器，拒绝编译
+
+struct RequestHeader {
+    std::uint32_t magic;
+    std::uint32_t version;
+    std::uint8_t mode;
+    std::uint8_t lexer;
+    std::uint16_t compiler_size; // compilerVersion() 的长度
+    std::uint32_t source_size;
+};
+
+struct ReplyHeader {
+    std::uint32_t status;
+    std::uint32_t size;
+};
+
+// 读满 size 字节，对端提前关闭或出错时返回 false
+bool readFull(int fd, void* buffer, std::size_t size)
+{
+    auto* cursor = static_cast<char*>(buffer);
+    while (size > 0) {
+        const auto count = ::read(fd, cursor, size);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            return false;
+        }
+        cursor += count;
+        size -= static_cast<std::size_t>(count);
+    }
+    return true;
+}
+
+// 写满 size 字节，对端已经关闭时不产生 SIGPIPE
+bool writeFull(int fd, const void* buffer, std::size_t size)
+{
+    const auto* cursor = static_cast<const char*>(buffer);
+    while (size > 0) {
+        const auto count = ::send(fd, cursor, size, MSG_NOSIGNAL);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            return false;
+        }
+        cursor += count;
+        size -= static_cast<std::size_t>(count);
+    }
+    return true;
+}
+
+bool makeAddress(const std::string& socket_path, sockaddr_un& address)
+{
+    if (socket_path.size() >= sizeof(address.sun_path)) {
+        return false;
+    }
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    std::memcpy(address.sun_path, socket_path.c_str(), socket_path.size() + 1);
+    return true;
+}
+
+int connectTo(const std::string& socket_path)
+{
+    sockaddr_un address;
+    if (!makeAddress(socket_path, address)) {
+        return -1;
+    }
+    const int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    if (::connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// 收到 SIGINT / SIGTERM 时删除套接字文件并退出
+char server_socket_path[sizeof(sockaddr_un::sun_path)];
+
+extern "C" void stopServer(int /* signal */)
+{
+    ::unlink(server_socket_path);
+    ::_exit(0);
+}
+
+// 处理一个连接上的一个请求
+void serveConnection(int fd, std::unique_ptr<CompilerContext> (&contexts)[2])
+{
+    RequestHeader request;
+    if (!readFull(fd, &request, sizeof(request)) || request.magic != PROTOCOL_MAGIC
+        || request.version != PROTOCOL_VERSION || request.mode > static_cast<std::uint8_t>(CompileMode::KOOPA_IMAGE) || request.lexer > 1
+        || request.compiler_size > MAX_COMPILER_SIZE || request.source_size > MAX_SOURCE_SIZE) {
+        return;
+    }
+    std::string compiler(request.compiler_size, '\0');
+    std::string source(request.source_size, '\0');
+    if (!readFull(fd, compiler.data(), compiler.size()) || !readFull(fd, source.data(), source.size())) {
+        return;
+    }
+
+    // 客户端和服务器不是同一个编译器（例如重新编译了编译器而服务器还在运行），
+    // 服务器的输出可能已经过时，让客户端自己编译
+    if (compiler != compilerVersion()) {
+        const ReplyHeader reply { STATUS_WRONG_COMPILER, 0 };
+        writeFull(fd, &reply, sizeof(reply));
+        return;
+    }
+
+    // 每种词法分析器一个 CompilerContext，第一次用到时创建，之后一直复用
+    auto& context = contexts[request.lexer];
+    if (!context) {
+        context = std::make_unique<CompilerContext>(request.lexer == 0 ? LexerKind::FLEX : LexerKind::MMAP);
+    }
+
+    ReplyHeader reply { STATUS_OK, 0 };
+    std::string output;
+    try {
+        output = context->compile(source, static_cast<CompileMode>(request.mode));
+    } catch (const std::exception& e) {
+        reply.status = STATUS_ERROR;
+        output = e.what();
+    }
+    reply.size = static_cast<std::uint32_t>(output.size());
+    if (writeFull(fd, &reply, sizeof(reply))) {
+        writeFull(fd, output.data(), output.size());
+    }
+}
+
+void serverLoop(int listen_fd)
+{
+    std::unique_ptr<CompilerContext> contexts[2];
+    while (true) {
+        const int fd = ::accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            std::perror("accept");
+            return;
+        }
+        // 客户端卡住时不要一直占着这个线程
+        const timeval timeout { 10, 0 };
+        ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        serveConnection(fd, contexts);
+        ::close(fd);
+    }
+}
+
+} // namespace
+
+int runCompileServer(const std::string& socket_path, unsigned thread_count)
+{
+    sockaddr_un address;
+    if (!makeAddress(socket_path, address)) {
+        std::cerr << "Socket path is too long: " << socket_path << std::endl;
+        return 1;
+    }
+
+    // 已经有服务器在监听时不抢占它；连接不上说明是上次遗留的套接字文件，删除后重新监听
+    const int existing = connectTo(socket_path);
+    if (existing >= 0) {
+        ::close(existing);
+        std::cerr << "A compile server is already listening on " << socket_path << std::endl;
+        return 1;
+    }
+    ::unlink(socket_path.c_str());
+
+    const int listen_fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listen_fd < 0 || ::bind(listen_fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0
+        || ::listen(listen_fd, SOMAXCONN) != 0) {
+        std::perror(socket_path.c_str());
+        return 1;
+    }
+
+    std::memcpy(server_socket_path, address.sun_path, sizeof(server_socket_path));
+    std::signal(SIGINT, stopServer);
+    std::signal(SIGTERM, stopServer);
+
+    if (thread_count == 0) {
+        thread_count = std::max(1u, std::thread::hardware_concurrency());
+    }
+    std::cerr << "Compile server listening on " << socket_path << " with " << thread_count << " threads" << std::endl;
+
+    // 所有线程在同一个监听套接字上 accept，由内核把连接分给空闲的线程
+    std::vector<std::thread> workers;
+    for (unsigned i = 1; i < thread_count; ++i) {
+        workers.emplace_back(serverLoop, listen_fd);
+    }
+    serverLoop(listen_fd);
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    ::close(listen_fd);
+    ::unlink(socket_path.c_str());
+    return 1;
+}
+
+std::optional<CompileReply> requestCompile(const std::string& socket_path, std::string_view source,
+                                           CompileMode mode, LexerKind lexer_kind)
+{
+    if (source.size() > MAX_SOURCE_SIZE) {
+        return std::nullopt;
+    }
+    const auto compiler = compilerVersion();
+    if (compiler.size() > MAX_COMPILER_SIZE) {
+        return std::nullopt;
+    }
+    const int fd = connectTo(socket_path);
+    if (fd < 0) {
+        return std::nullopt;
+    }
+    // 超时后 read / send 失败，按通信出错处理
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &CLIENT_TIMEOUT, sizeof(CLIENT_TIMEOUT));
+    ::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &CLIENT_TIMEOUT, sizeof(CLIENT_TIMEOUT));
+
+    RequestHeader request {};
+    request.magic = PROTOCOL_MAGIC;
+    request.version = PROTOCOL_VERSION;
+    request.mode = static_cast<std::uint8_t>(mode);
+    request.lexer = lexer_kind == LexerKind::FLEX ? 0 : 1;
+    request.compiler_size = static_cast<std::uint16_t>(compiler.size());
+    request.source_size = static_cast<std::uint32_t>(source.size());
+
+    std::optional<CompileReply> result;
+    ReplyHeader reply;
+    if (writeFull(fd, &request, sizeof(request)) && writeFull(fd, compiler.data(), compiler.size())
+        && writeFull(fd, source.data(), source.size()) && readFull(fd, &reply, sizeof(reply))
+        && reply.status != STATUS_WRONG_COMPILER) {
+        std::string output(reply.size, '\0');
+        if (readFull(fd, output.data(), output.size())) {
+            result = CompileReply { reply.status == STATUS_OK, std::move(output) };
+        }
+    }
+    ::close(fd);
+    return result;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "compiler_context.h"
+
+// 常驻的编译服务
+// 服务器在 Unix 域套接字上监听，每个连接发送一个编译请求（模式、词法分析器、源代码），
+// 返回 Koopa IR / RISC-V 汇编或者错误信息。
+// 每个工作线程各自 accept 连接，并持有自己的 CompilerContext，Arena 等内存在请求之间保持热的状态。
+//
+// 请求和回复都以一个固定的头部开始，整数使用本机字节序（套接字只在本机使用）：
+//   请求: magic, version, mode, lexer, compiler_size, source_size, 随后是 compilerVersion() 和源代码
+//   回复: status (0 成功, 1 编译出错, 2 编译器版本不同), size, 随后是目标代码或错误信息
+// 服务器只处理与自己是同一个编译器（见 compilerVersion()）的请求，
+// 重新编译编译器后还在运行的旧服务器会拒绝请求，客户端改为在本进程内编译。
+
+// 客户端通过这个环境变量找到服务器的套接字
+constexpr const char* COMPILE_SERVER_ENV = "SYSY_COMPILER_SERVER";
+
+// 编译请求的结果
+struct CompileReply {
+    bool ok;
+    std::string output; // 成功时为目标代码，失败时为错误信息
+};
+
+// 在 socket_path 上监听并处理请求，直到收到 SIGINT / SIGTERM
+// thread_count 为 0 时使用机器的硬件线程数；返回进程的退出码
+int runCompileServer(const std::string& socket_path, unsigned thread_count);
+
+// 把一个编译请求发给服务器
+// 无法连接服务器、通信出错、等待回复超时或服务器是另一个版本的编译器时返回 std::nullopt，
+// 调用方可以改为在本进程内编译
+std::optional<CompileReply> requestCompile(const std::string& socket_path, std::string_view source,
+                                           CompileMode mode, LexerKind lexer_kind);
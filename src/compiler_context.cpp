@@ -0,0 +1,328 @@
+#include "compiler_context.h"
+
+#include <cassert>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+#include "ast.h"
+#include "compile_cache.h"
+#include "koopa_image.h"
+#include "mmap_lexer.h"
+#include "output_buffer.h"
+#include "string_format.h"
+#include "time_report.h"
+
+// CMake 在构建时生成 compiler_build_id.h，其中是编译器全部源代码和编译选项的哈希
+#if __has_include("compiler_build_id.h")
+#include "compiler_build_id.h"
+#endif
+#ifndef SYSY_COMPILER_BUILD_ID
+// 不经过 CMake 构建时退而使用编译这个文件的时间
+#define SYSY_COMPILER_BUILD_ID __DATE__ " " __TIME__
+#endif
+
+// 声明 parser 函数以及 sysy.l 中创建 flex 扫描器的函数
+// 与 main.cpp 相同, 不引用 Bison/Flex 生成的头文件
+extern int yyparse(AstPtr<BaseAST>& ast, Arena& arena, CompilerContext& context);
+extern void* createFlexScanner(StringInterner& interner);
+extern void flexScanFile(void* scanner, FILE* file);
+extern void flexScanBuffer(void* scanner, const char* data, size_t size);
+extern void destroyFlexScanner(void* scanner);
+
+CompilerContext::CompilerContext(LexerKind lexer_kind)
+{
+    if (lexer_kind == LexerKind::MMAP) {
+        mmap_lexer_ = std::make_unique<MmapLexer>(interner_);
+    }
+}
+
+CompilerContext::~CompilerContext()
+{
+    // AST 和 IR 引用了驻留表和符号表中的数据，先销毁它们
+    reset();
+}
+
+void CompilerContext::setTimeReport(TimeReport* report)
+{
+    time_report_ = report;
+    builder_.setTimeReport(report);
+    backend_.setTimeReport(report);
+}
+
+void CompilerContext::setMemoryReport(MemoryReport* report)
+{
+    memory_report_ = report;
+    arena_.setObjectCounts(report != nullptr ? &ast_objects_ : nullptr);
+    builder_.setObjectCounts(report != nullptr ? &ir_objects_ : nullptr);
+}
+
+void CompilerContext::flushObjectCounts()
+{
+    if (memory_report_ != nullptr) {
+        memory_report_->merge(ast_objects_, ir_objects_);
+    }
+}
+
+void CompilerContext::reset()
+{
+    ast_ = nullptr;
+    builder_.reset();
+    symbol_table_.reset();
+    arena_.reset();
+    interner_.reset();
+    syntax_error_.clear();
+    token_hashes_.clear();
+    token_count_ = 0;
+    if (flex_scanner_ != nullptr) {
+        destroyFlexScanner(flex_scanner_);
+        flex_scanner_ = nullptr;
+    }
+    if (mmap_lexer_) {
+        mmap_lexer_->close();
+    }
+}
+
+CompUnitAST& CompilerContext::parse(std::string_view source)
+{
+    reset();
+    if (mmap_lexer_) {
+        mmap_lexer_->openBuffer(source.data(), source.size());
+    } else {
+        flex_scanner_ = createFlexScanner(interner_);
+        if (flex_scanner_ == nullptr) {
+            throw std::runtime_error("Failed to create the flex scanner");
+        }
+        flexScanBuffer(flex_scanner_, source.data(), source.size());
+    }
+    return parseInput();
+}
+
+CompUnitAST& CompilerContext::parseFile(const char* path)
+{
+    reset();
+    if (mmap_lexer_) {
+        if (!mmap_lexer_->open(path)) {
+            throw std::runtime_error(stringFormat("Cannot open input file '%s'", path));
+        }
+        return parseInput();
+    }
+
+    // 打开输入文件, 并且指定 lexer 在解析的时候读取这个文件
+    FILE* file = fopen(path, "r");
+    if (file == nullptr) {
+        throw std::runtime_error(stringFormat("Cannot open input file '%s'", path));
+    }
+    flex_scanner_ = createFlexScanner(interner_);
+    if (flex_scanner_ == nullptr) {
+        fclose(file);
+        throw std::runtime_error("Failed to create the flex scanner");
+    }
+    flexScanFile(flex_scanner_, file);
+    try {
+        auto& ast = parseInput();
+        fclose(file);
+        return ast;
+    } catch (...) {
+        fclose(file);
+        throw;
+    }
+}
+
+CompUnitAST& CompilerContext::parseInput()
+{
+    // 调用 parser 函数, parser 函数会进一步调用 lexer 解析输入
+    AstPtr<BaseAST> ast;
+    lex_time_ = 0;
+    int ret;
+    {
+        const TimeReport::Scope scope(time_report_, "parse");
+        ret = yyparse(ast, arena_, *this);
+    }
+    if (time_report_ != nullptr) {
+        time_report_->accumulate("lex", lex_time_);
+    }
+
+    // 输入已经读完, 扫描器不再需要
+    if (flex_scanner_ != nullptr) {
+        destroyFlexScanner(flex_scanner_);
+        flex_scanner_ = nullptr;
+    }
+    if (mmap_lexer_) {
+        mmap_lexer_->close();
+    }
+
+    if (ret != 0 || !ast) {
+        throw std::runtime_error(syntax_error_.empty() ? "syntax error" : syntax_error_);
+    }
+
+    // 名字解析: 把标识符绑定到符号表中的记录, 并折叠常量
+    auto* comp_unit = static_cast<CompUnitAST*>(ast.release());
+    const TimeReport::Scope scope(time_report_, "resolve");
+    symbol_table_.emplace();
+    comp_unit->resolve(*symbol_table_);
+    ast_ = comp_unit;
+    flushObjectCounts();
+    return *ast_;
+}
+
+void CompilerContext::reportSyntaxError(const char* message)
+{
+    // 只保留第一个错误
+    if (syntax_error_.empty()) {
+        syntax_error_ = message;
+    }
+}
+
+std::string CompilerContext::generate(CompileMode mode)
+{
+    OutputBuffer out;
+    generate(mode, out);
+    return out.take();
+}
+
+void CompilerContext::generate(CompileMode mode, OutputBuffer& out)
+{
+    if (ast_ == nullptr) {
+        throw std::runtime_error("CompilerContext::generate: nothing has been parsed");
+    }
+
+    // 映像是整个程序的一块内存，不能按函数拼接
+    if (cache_ != nullptr && cache_layer_ == CacheLayer::FUNCTION && mode != CompileMode::KOOPA_IMAGE) {
+        out << generateCached(mode);
+        flushObjectCounts();
+        return;
+    }
+
+    // 在内存中构造 Koopa IR, 后端直接使用, 只有 -koopa 模式才需要打印成文本
+    builder_.reset();
+    {
+        const TimeReport::Scope scope(time_report_, "lower", ast_->func_def->ident.view());
+        ast_->toKoopa(builder_);
+    }
+    const auto raw_program = builder_.build();
+    flushObjectCounts();
+
+    if (mode == CompileMode::KOOPA) {
+        const TimeReport::Scope scope(time_report_, "dump-koopa");
+        dumpKoopa(raw_program, out);
+    } else if (mode == CompileMode::KOOPA_IMAGE) {
+        const TimeReport::Scope scope(time_report_, "serialize");
+        out << serializeKoopa(raw_program);
+    } else {
+        backend_.compileToAssembly(raw_program, out);
+    }
+}
+
+std::string CompilerContext::generateCached(CompileMode mode)
+{
+    // 函数的 IR 和汇编只取决于函数本身（标签在函数内编号，后端逐个函数生成），
+    // 键由函数定义的 token 序列得到，改动空白和注释不会使缓存失效。
+    // 限制：sysy.y 中的 CompUnit 只有一个函数定义、没有全局声明，所以键只覆盖这个函数定义；
+    // 支持全局声明后，键还需要包含函数引用的全局声明。
+    auto* func_def = ast_->func_def.get();
+    const auto& tokens = func_def->tokens;
+    assert(record_tokens_ && tokens.first <= tokens.last && static_cast<std::size_t>(tokens.last) < token_hashes_.size());
+    const auto key = CompileCache::makeFunctionKey(&token_hashes_[tokens.first], tokens.last - tokens.first + 1, mode);
+
+    builder_.reset();
+    std::string output = mode == CompileMode::RISCV ? backend_.compileHeaderToAssembly(builder_.build()) : "";
+    if (auto cached = cache_->lookup(key)) {
+        return output + *cached;
+    }
+
+    builder_.reset();
+    {
+        const TimeReport::Scope scope(time_report_, "lower", func_def->ident.view());
+        func_def->toKoopa(builder_);
+    }
+    const auto raw_program = builder_.build();
+    std::string code;
+    if (mode == CompileMode::KOOPA) {
+        const TimeReport::Scope scope(time_report_, "dump-koopa");
+        code = dumpKoopa(raw_program);
+    } else {
+        code = backend_.compileFunctionsToAssembly(raw_program);
+    }
+    cache_->store(key, code);
+    return output + code;
+}
+
+std::string CompilerContext::compile(std::string_view source, CompileMode mode)
+{
+    // 按函数缓存时由 generate() 查找缓存
+    if (cache_ == nullptr || cache_layer_ == CacheLayer::FUNCTION) {
+        parse(source);
+        return generate(mode);
+    }
+
+    // 两个词法分析器应当产生相同的 token 流，键仍然区分它们：一个扫描器的缺陷不会经由共享的缓存影响另一个
+    const auto key = CompileCache::makeKey(source, mode, mmap_lexer_ ? "lexer=mmap" : "lexer=flex");
+    if (auto cached = cache_->lookup(key)) {
+        return std::move(*cached);
+    }
+    parse(source);
+    auto output = generate(mode);
+    cache_->store(key, output);
+    return output;
+}
+
+std::string CompilerContext::compileFile(const char* path, CompileMode mode)
+{
+    if (cache_ == nullptr || cache_layer_ == CacheLayer::FUNCTION) {
+        parseFile(path);
+        return generate(mode);
+    }
+
+    // 按文件缓存时需要先读入整个文件计算哈希
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        throw std::runtime_error(stringFormat("Cannot open input file '%s'", path));
+    }
+    const std::string source((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    return compile(source, mode);
+}
+
+std::string CompilerContext::compileKoopa(const std::string& koopa_ir)
+{
+    if (cache_ == nullptr) {
+        return backend_.compileToAssembly(koopa_ir);
+    }
+
+    // 与 SysY 源代码的键通过 options 区分
+    const auto key = CompileCache::makeKey(koopa_ir, CompileMode::RISCV, "koopa-input");
+    if (auto cached = cache_->lookup(key)) {
+        return std::move(*cached);
+    }
+    auto output = backend_.compileToAssembly(koopa_ir);
+    cache_->store(key, output);
+    return output;
+}
+
+std::string CompilerContext::compileKoopaFile(const char* path)
+{
+    // 映像不经过缓存：装载映像本身几乎没有开销
+    if (KoopaImage::isImageFile(path)) {
+        const KoopaImage image(path);
+        return backend_.compileToAssembly(image.program());
+    }
+
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        throw std::runtime_error(stringFormat("Cannot open input file '%s'", path));
+    }
+    const std::string koopa_ir((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    return compileKoopa(koopa_ir);
+}
+
+std::string compile(std::string_view source, CompileMode mode)
+{
+    CompilerContext context;
+    return context.compile(source, mode);
+}
+
+std::string_view compilerVersion()
+{
+    return "sysy-compiler " SYSY_COMPILER_BUILD_ID;
+}
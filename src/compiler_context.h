@@ -0,0 +1,160 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "arena.h"
+#include "koopa_builder.h"
+#include "koopa_parser.h"
+#include "memory_report.h"
+#include "string_interner.h"
+#include "symbol_table.h"
+
+class CompUnitAST;
+class CompileCache;
+class MmapLexer;
+class OutputBuffer;
+class TimeReport;
+
+// 输出的目标代码
+enum class CompileMode {
+    KOOPA, // Koopa IR 文本
+    RISCV, // RISC-V 汇编
+    KOOPA_IMAGE, // Koopa IR 的二进制映像，见 koopa_image.h
+};
+
+// 词法分析器的实现
+enum class LexerKind {
+    FLEX, // sysy.l 生成的扫描器
+    MMAP, // 手写的 MmapLexer
+};
+
+// 编译缓存的粒度，每次编译只查找和写入其中一层
+enum class CacheLayer {
+    FILE, // 按整个源文件的字节查找，命中时跳过解析和代码生成
+    FUNCTION, // 解析后按每个函数的 token 序列查找，只为改动过的函数生成代码，改动空白和注释不影响命中
+};
+
+// 一次编译所需的全部状态
+// 驻留表、Arena、符号表、IR 构造器、后端和扫描器都归 CompilerContext 所有，不再使用任何全局变量，
+// 因此不同的 CompilerContext 可以在不同线程上同时编译。
+// 同一个 CompilerContext 可以反复编译多个源文件：每次编译开始时清空上一次的状态，
+// 已经申请的内存保留下来复用。上一次编译得到的 AST 和 IR 随之失效。
+class CompilerContext {
+public:
+    explicit CompilerContext(LexerKind lexer_kind = LexerKind::FLEX);
+    ~CompilerContext();
+
+    // 禁用拷贝和移动，AST 和 IR 中的指针指向内部的 Arena
+    CompilerContext(const CompilerContext&) = delete;
+    CompilerContext& operator=(const CompilerContext&) = delete;
+
+    // 解析一段源代码并完成名字解析，出错时抛出 std::runtime_error
+    // source 只需要在调用期间有效
+    CompUnitAST& parse(std::string_view source);
+    // 解析一个源文件，其余同 parse()
+    CompUnitAST& parseFile(const char* path);
+
+    // 为最近一次解析得到的 AST 生成目标代码
+    // 使用 CacheLayer::FUNCTION 的缓存时逐个函数查找缓存，只为没有命中的函数生成代码，再按原来的顺序拼接
+    std::string generate(CompileMode mode);
+    // 同上，目标代码直接写入 out（例如流式写入输出文件）
+    void generate(CompileMode mode, OutputBuffer& out);
+
+    // 解析并生成目标代码
+    // 使用 CacheLayer::FILE 的缓存时先按整个源文件查找缓存，命中则跳过解析和代码生成
+    std::string compile(std::string_view source, CompileMode mode);
+    std::string compileFile(const char* path, CompileMode mode);
+
+    // 只使用后端：把 Koopa IR 文本编译为 RISC-V 汇编，不经过 SysY 前端
+    // 用于单独测试和缓存后端、重放保存下来的 IR，IR 不合法时抛出 std::runtime_error
+    std::string compileKoopa(const std::string& koopa_ir);
+    // 文件可以是 Koopa 文本，也可以是二进制映像，映像 mmap 进来后直接交给后端
+    std::string compileKoopaFile(const char* path);
+
+    // 设置 compile() / compileFile() / compileKoopa() 使用的缓存，nullptr 表示不使用缓存
+    // 缓存可以被多个 CompilerContext 共享，需要比它们活得更久
+    // layer 决定 SysY 源代码按文件还是按函数缓存；Koopa IR 输入总是按文件缓存
+    void setCache(CompileCache* cache, CacheLayer layer = CacheLayer::FILE)
+    {
+        cache_ = cache;
+        cache_layer_ = layer;
+        // 只有按函数缓存时才需要 token 的哈希
+        record_tokens_ = cache != nullptr && layer == CacheLayer::FUNCTION;
+        if (!record_tokens_) {
+            token_hashes_.clear();
+        }
+    }
+    // 设置记录各阶段耗时的报告，nullptr 表示不计时；报告可以被多个 CompilerContext 共享
+    void setTimeReport(TimeReport* report);
+    TimeReport* timeReport() const { return time_report_; }
+    // 设置统计 AST 节点和 IR 对象的报告，nullptr 表示不统计；报告可以被多个 CompilerContext 共享
+    void setMemoryReport(MemoryReport* report);
+    // 开始或停止记录生成的 RISC-V 汇编的统计（见 codegen_stats.h）；命中缓存的编译不生成代码，也就没有统计
+    void setCollectCodegenStats(bool collect) { backend_.setCollectStats(collect); }
+    // 取走自上次调用以来生成的每个函数的统计
+    std::vector<FunctionStats> takeCodegenStats() { return backend_.takeStats(); }
+
+    // 以下接口供 sysy.y / sysy.l 中的 yylex 和 yyerror 使用
+
+    // 使用 mmap 扫描器时返回它，否则返回 nullptr
+    MmapLexer* mmapLexer() const { return mmap_lexer_.get(); }
+    // flex 扫描器的 yyscan_t
+    void* flexScanner() const { return flex_scanner_; }
+    // 记录语法错误，parse() 结束后以异常的形式抛出
+    void reportSyntaxError(const char* message);
+    // 是否需要记录每个 token 的哈希，不需要时 yylex 不计算哈希
+    bool recordsTokens() const { return record_tokens_; }
+    // 记录下一个 token，需要时连同它的哈希，返回它的序号
+    int recordToken(std::uint64_t hash = 0)
+    {
+        if (record_tokens_) {
+            token_hashes_.push_back(hash);
+        }
+        return token_count_++;
+    }
+    // 累加词法分析的耗时，解析结束后一次性计入报告
+    void addLexTime(std::uint64_t ns) { lex_time_ += ns; }
+
+private:
+    // 清空上一次编译的状态
+    void reset();
+    // 调用 parser 并做名字解析，输入已经交给扫描器
+    CompUnitAST& parseInput();
+    // 使用缓存时的代码生成
+    std::string generateCached(CompileMode mode);
+    // 把本次编译分配的对象并入内存报告
+    void flushObjectCounts();
+
+    StringInterner interner_;
+    Arena arena_; // AST 的所有节点
+    std::optional<SymbolTable> symbol_table_; // 需要和 AST 活得一样久，IR 生成时会直接读取其中的记录
+    KoopaBuilder builder_;
+    KoopaParser backend_; // 生成 RISC-V 汇编，在多次编译之间复用
+    std::unique_ptr<MmapLexer> mmap_lexer_;
+    void* flex_scanner_ = nullptr;
+    CompUnitAST* ast_ = nullptr;
+    CompileCache* cache_ = nullptr;
+    CacheLayer cache_layer_ = CacheLayer::FILE;
+    TimeReport* time_report_ = nullptr;
+    MemoryReport* memory_report_ = nullptr;
+    ObjectCounts ast_objects_;
+    ObjectCounts ir_objects_;
+    std::uint64_t lex_time_ = 0;
+    std::string syntax_error_;
+    bool record_tokens_ = false;
+    int token_count_ = 0;
+    std::vector<std::uint64_t> token_hashes_; // 按函数缓存时按顺序记录每个 token 的哈希
+};
+
+// 库接口：用一个临时的 CompilerContext 编译一段 SysY 源代码，返回 Koopa IR 文本或 RISC-V 汇编
+// 出错时抛出 std::runtime_error；需要连续编译多个文件时直接复用 CompilerContext 更省内存分配
+std::string compile(std::string_view source, CompileMode mode);
+
+// 编译器版本：构建时由编译器的源代码和编译选项算出的哈希，与链接它的程序无关，修改编译器后随之改变
+// 编译缓存的键和编译服务器的请求都带上它，旧版本的输出不会被当作新版本的输出
+std::string_view compilerVersion();
@@ -1,295 +1,178 @@
 /*
 实现表达式相关的 IR 生成 和 目标代码生成
+表达式树可能非常深（十万项的加法链、上万层括号），因此这里不使用递归，
+而是用显式的工作栈做后序遍历，原生栈深度与表达式大小无关。
 */
 
 #include "ast.h"
 #include "string_format.h"
-#include <variant>
 
-std::string ExpAST::toKoopa(std::vector<std::string>& generated_instructions)
-{
-    if (expression) {
-        return expression->toKoopa(generated_instructions);
-    }
-    return "";
-}
+namespace {
 
-std::string PrimaryExpAST::toKoopa(std::vector<std::string>& generated_instructions)
+koopa_raw_binary_op_t binaryOpKoopa(BinaryOp op)
 {
-    if (std::holds_alternative<NumberAST>(expression)) {
-        return std::get<NumberAST>(expression).toKoopa();
-    } else if (std::holds_alternative<std::unique_ptr<LValAST>>(expression)) {
-        // 处理LVal，如果是常量则替换为其值
-        const auto& lval = std::get<std::unique_ptr<LValAST>>(expression);
-        if (BaseAST::global_symbol_table != nullptr) {
-            const auto& symbol_item = BaseAST::global_symbol_table->getSymbol(lval->ident);
-            if (symbol_item.has_value() && symbol_item->is_const && symbol_item->value.has_value()) {
-                // 是常量，直接返回常量值
-                return std::to_string(symbol_item->value.value());
-            }
-            // 是变量，需要生成load指令
-            if (symbol_item.has_value() && symbol_item->symbol_type == SymbolType::VAR) {
-                auto new_var = BaseAST::getNewTempVar();
-                // 使用完整变量名格式
-                const auto full_var_name = stringFormat("%s_%d", lval->ident.c_str(), symbol_item->scope_identifier);
-                generated_instructions.push_back(stringFormat("%%%d = load @%s", new_var, full_var_name.c_str()));
-                return stringFormat("%%%d", new_var);
-            }
-        }
-        // 不是常量，按变量处理（这里暂时返回错误，因为还没实现变量）
-        return "/* variable not supported yet */";
-    } else {
-        // 括号表达式
-        return std::get<std::unique_ptr<ExpAST>>(expression)->toKoopa(generated_instructions);
+    switch (op) {
+        case BINARY_OP_MUL: return KOOPA_RBO_MUL;
+        case BINARY_OP_DIV: return KOOPA_RBO_DIV;
+        case BINARY_OP_MOD: return KOOPA_RBO_MOD;
+        case BINARY_OP_ADD: return KOOPA_RBO_ADD;
+        case BINARY_OP_SUB: return KOOPA_RBO_SUB;
+        case BINARY_OP_LT: return KOOPA_RBO_LT;
+        case BINARY_OP_LE: return KOOPA_RBO_LE;
+        case BINARY_OP_GT: return KOOPA_RBO_GT;
+        case BINARY_OP_GE: return KOOPA_RBO_GE;
+        case BINARY_OP_EQ: return KOOPA_RBO_EQ;
+        case BINARY_OP_NE: return KOOPA_RBO_NOT_EQ;
+        case BINARY_OP_LAND: return KOOPA_RBO_AND;
+        case BINARY_OP_LOR: return KOOPA_RBO_OR;
     }
+    return KOOPA_RBO_ADD;
 }
 
-std::string UnaryExpAST::toKoopa(std::vector<std::string>& generated_instructions)
-{
-    return std::visit([&](auto& expr) -> std::string {
-        return expr->toKoopa(generated_instructions);
-    }, expression);
+// 工作栈中的一帧
+// stage 表示该节点已经处理完几个操作数，temp 和 result 保存短路求值中结果变量的编号和 alloc
+struct LoweringFrame {
+    ExpAST* node;
+    std::uint8_t stage;
+    int temp;
+    koopa_raw_value_t result;
+};
 
-}
+} // namespace
 
-std::string UnaryExpOpAndExpAST::toKoopa(std::vector<std::string>& generated_instructions)
+koopa_raw_value_t ExpAST::toKoopa(KoopaBuilder& builder)
 {
-    switch (op) {
-        case UNARY_OP_POSITIVE:
-            return latter_expression->toKoopa(generated_instructions);
-        case UNARY_OP_NEGATIVE: {
-            auto exp = latter_expression->toKoopa(generated_instructions);
-            auto new_var = BaseAST::getNewTempVar();
-            generated_instructions.push_back(stringFormat("%%%d = sub 0, %s", new_var, exp));
-            return stringFormat("%%%d", new_var);
-        }
-        case UNARY_OP_NOT: {
-            auto exp = latter_expression->toKoopa(generated_instructions);
-            auto new_var = BaseAST::getNewTempVar();
-            generated_instructions.push_back(stringFormat("%%%d = eq %s, 0", new_var, exp));
-            return stringFormat("%%%d", new_var);
+    std::vector<LoweringFrame> frames;
+    std::vector<koopa_raw_value_t> values; // 已经求出的操作数
+
+    frames.push_back({ this, 0, 0, nullptr });
+    while (!frames.empty()) {
+        const auto index = frames.size() - 1;
+        auto* node = frames[index].node;
+        const auto stage = frames[index].stage;
+
+        switch (node->kind) {
+            case EXP_NUMBER:
+                values.push_back(builder.integer(node->value));
+                frames.pop_back();
+                break;
+
+            case EXP_LVAL:
+                values.push_back(node->lvalToKoopa(builder));
+                frames.pop_back();
+                break;
+
+            case EXP_UNARY:
+                if (stage == 0) {
+                    frames[index].stage = 1;
+                    frames.push_back({ node->lhs.get(), 0, 0, nullptr });
+                } else {
+                    auto operand = values.back();
+                    values.pop_back();
+                    values.push_back(node->unaryToKoopa(operand, builder));
+                    frames.pop_back();
+                }
+                break;
+
+            case EXP_BINARY:
+                if (node->binary_op == BINARY_OP_LAND || node->binary_op == BINARY_OP_LOR) {
+                    // 短路求值：先求左操作数，再在条件分支中求右操作数
+                    if (stage == 0) {
+                        frames[index].stage = 1;
+                        frames[index].temp = builder.newId();
+                        frames.push_back({ node->lhs.get(), 0, 0, nullptr });
+                    } else if (stage == 1) {
+                        auto lhs = values.back();
+                        values.pop_back();
+                        frames[index].result = node->shortCircuitBranchToKoopa(frames[index].temp, lhs, builder);
+                        frames[index].stage = 2;
+                        frames.push_back({ node->rhs.get(), 0, 0, nullptr });
+                    } else {
+                        auto rhs = values.back();
+                        values.pop_back();
+                        values.push_back(node->shortCircuitMergeToKoopa(frames[index].temp, frames[index].result, rhs, builder));
+                        frames.pop_back();
+                    }
+                } else if (stage == 0) {
+                    frames[index].stage = 1;
+                    frames.push_back({ node->lhs.get(), 0, 0, nullptr });
+                } else if (stage == 1) {
+                    frames[index].stage = 2;
+                    frames.push_back({ node->rhs.get(), 0, 0, nullptr });
+                } else {
+                    auto rhs = values.back();
+                    values.pop_back();
+                    auto lhs = values.back();
+                    values.pop_back();
+                    values.push_back(builder.binary(binaryOpKoopa(node->binary_op), lhs, rhs));
+                    frames.pop_back();
+                }
+                break;
         }
     }
-
+    return values.back();
 }
 
-std::string AddExpAST::toKoopa(std::vector<std::string>& generated_instructions)
+koopa_raw_value_t ExpAST::lvalToKoopa(KoopaBuilder& builder) const
 {
-    return std::visit([&](auto& expr) -> std::string {
-        return expr->toKoopa(generated_instructions);
-    }, expression);
-}
-
-std::string MulExpAST::toKoopa(std::vector<std::string>& generated_instructions)
-{
-    return std::visit([&](auto& expr) -> std::string {
-        return expr->toKoopa(generated_instructions);
-    }, expression);
-}
-
-std::string AddExpOpAndMulExpAST::toKoopa(std::vector<std::string>& generated_instructions)
-{
-    auto first_exp = first_expression->toKoopa(generated_instructions);
-    auto second_exp = latter_expression->toKoopa(generated_instructions);
-    auto new_var = BaseAST::getNewTempVar();
-    
-    switch (op) {
-        case ADD_OP_ADD:
-            generated_instructions.push_back(stringFormat("%%%d = add %s, %s", new_var, first_exp, second_exp));
-            break;
-        case ADD_OP_SUB:
-            generated_instructions.push_back(stringFormat("%%%d = sub %s, %s", new_var, first_exp, second_exp));
-            break;
+    // 处理LVal，如果是常量则替换为其值
+    const auto* symbol_item = lval->symbol;
+    if (symbol_item != nullptr && symbol_item->is_const && symbol_item->value.has_value()) {
+        // 是常量，直接使用常量值
+        return builder.integer(symbol_item->value.value());
     }
-    
-    return stringFormat("%%%d", new_var);
-}
-
-std::string MulExpOpAndExpAST::toKoopa(std::vector<std::string>& generated_instructions)
-{
-    auto first_exp = first_expression->toKoopa(generated_instructions);
-    auto second_exp = latter_expression->toKoopa(generated_instructions);
-    auto new_var = BaseAST::getNewTempVar();
-    
-    switch (op) {
-        case MUL_OP_MUL:
-            generated_instructions.push_back(stringFormat("%%%d = mul %s, %s", new_var, first_exp, second_exp));
-            break;
-        case MUL_OP_DIV:
-            generated_instructions.push_back(stringFormat("%%%d = div %s, %s", new_var, first_exp, second_exp));
-            break;
-        case MUL_OP_MOD:
-            generated_instructions.push_back(stringFormat("%%%d = mod %s, %s", new_var, first_exp, second_exp));
-            break;
+    // 是变量，需要生成load指令
+    if (symbol_item != nullptr && symbol_item->symbol_type == SymbolType::VAR && symbol_item->koopa_value != nullptr) {
+        return builder.load(symbol_item->koopa_value);
     }
-    
-    return stringFormat("%%%d", new_var);
-}
-
-std::string RelExpAST::toKoopa(std::vector<std::string>& generated_instructions)
-{
-    return std::visit([&](auto& expr) -> std::string {
-        return expr->toKoopa(generated_instructions);
-    }, expression);
+    throw std::runtime_error(stringFormat("Identifier '%s' is not a defined variable", lval->ident.c_str()));
 }
 
-std::string RelExpOpAndAddExpAST::toKoopa(std::vector<std::string>& generated_instructions)
+koopa_raw_value_t ExpAST::unaryToKoopa(koopa_raw_value_t operand, KoopaBuilder& builder) const
 {
-    auto first_exp = first_expression->toKoopa(generated_instructions);
-    auto second_exp = latter_expression->toKoopa(generated_instructions);
-    auto new_var = BaseAST::getNewTempVar();
-    
-    switch (op) {
-        case REL_OP_LT:
-            generated_instructions.push_back(stringFormat("%%%d = lt %s, %s", new_var, first_exp, second_exp));
-            break;
-        case REL_OP_LE:
-            generated_instructions.push_back(stringFormat("%%%d = le %s, %s", new_var, first_exp, second_exp));
-            break;
-        case REL_OP_GT:
-            generated_instructions.push_back(stringFormat("%%%d = gt %s, %s", new_var, first_exp, second_exp));
-            break;
-        case REL_OP_GE:
-            generated_instructions.push_back(stringFormat("%%%d = ge %s, %s", new_var, first_exp, second_exp));
-            break;
+    switch (unary_op) {
+        case UNARY_OP_POSITIVE:
+            return operand;
+        case UNARY_OP_NEGATIVE:
+            return builder.binary(KOOPA_RBO_SUB, builder.integer(0), operand);
+        case UNARY_OP_NOT:
+            return builder.binary(KOOPA_RBO_EQ, operand, builder.integer(0));
     }
-    
-    return stringFormat("%%%d", new_var);
+    return operand;
 }
 
-std::string EqExpAST::toKoopa(std::vector<std::string>& generated_instructions)
+// a && b：result 初始为 0，只有 a 非零时才计算 b，并令 result = (b != 0)
+// a || b：result 初始为 1，只有 a 为零时才计算 b，并令 result = (b != 0)
+koopa_raw_value_t ExpAST::shortCircuitBranchToKoopa(int result_var, koopa_raw_value_t lhs, KoopaBuilder& builder) const
 {
-    return std::visit([&](auto& expr) -> std::string {
-        return expr->toKoopa(generated_instructions);
-    }, expression);
-}
-
-std::string EqExpOpAndRelExpAST::toKoopa(std::vector<std::string>& generated_instructions)
-{
-    auto first_exp = first_expression->toKoopa(generated_instructions);
-    auto second_exp = latter_expression->toKoopa(generated_instructions);
-    auto new_var = BaseAST::getNewTempVar();
-    
-    switch (op) {
-        case EQ_OP_EQ:
-            generated_instructions.push_back(stringFormat("%%%d = eq %s, %s", new_var, first_exp, second_exp));
-            break;
-        case EQ_OP_NE:
-            generated_instructions.push_back(stringFormat("%%%d = ne %s, %s", new_var, first_exp, second_exp));
-            break;
-    }
-    
-    return stringFormat("%%%d", new_var);
-}
-
-std::string LAndExpAST::toKoopa(std::vector<std::string>& generated_instructions)
-{   
-    // 短路求值优化
-    if (std::holds_alternative<std::unique_ptr<LAndExpOpAndEqExpAST>>(expression)) {
-        // LAndExp "&&" EqExp
-        auto result_var = BaseAST::getNewTempVar();
-        const auto& land_exp_op_and_eq_exp = std::get<std::unique_ptr<LAndExpOpAndEqExpAST>>(expression);
-        const auto& lhs_exp = land_exp_op_and_eq_exp->first_expression->toKoopa(generated_instructions);
-        auto lhs_bool_var = BaseAST::getNewTempVar();
-
-        const auto short_true_bb = stringFormat("short_true_%d", result_var);
-        const auto short_false_bb = stringFormat("short_false_%d", result_var);
-
-        generated_instructions.push_back(stringFormat("@_result_%d = alloc i32", result_var));
-        generated_instructions.push_back(stringFormat("store 0, @_result_%d", result_var));    // int result = 0;
-        generated_instructions.push_back(stringFormat("br %s, %%%s, %%%s", lhs_exp, short_true_bb, short_false_bb)); // if (lhs != 0)
-
-        generated_instructions.push_back(stringFormat("%%%s:", short_true_bb)); // 短路求值，直接跳转到短路真分支
-        // 计算 rhs != 0
-        auto rhs_exp = land_exp_op_and_eq_exp->latter_expression->toKoopa(generated_instructions);
-        auto rhs_bool_var = BaseAST::getNewTempVar();
-        generated_instructions.push_back(stringFormat("%%%d = ne %s, 0", rhs_bool_var, rhs_exp));
-        generated_instructions.push_back(stringFormat("store %%%d, @_result_%d", rhs_bool_var, result_var)); // result = (rhs != 0)
-        generated_instructions.push_back(stringFormat("jump %%%s", short_false_bb)); // 跳转到短路假分支
-        generated_instructions.push_back(stringFormat("%%%s:", short_false_bb)); // 短路假分支
+    const bool is_and = binary_op == BINARY_OP_LAND;
 
-        auto new_result_temp_var = BaseAST::getNewTempVar();
-        generated_instructions.push_back(stringFormat("%%%d = load @_result_%d", new_result_temp_var, result_var)); // 将结果存储到变量中
+    auto* short_true_bb = builder.getBlock(KoopaBuilder::Label::SHORT_TRUE, result_var);
+    auto* short_false_bb = builder.getBlock(KoopaBuilder::Label::SHORT_FALSE, result_var);
 
-        return stringFormat("%%%d", new_result_temp_var);
+    auto result = builder.alloc("@_result_", result_var);
+    builder.store(builder.integer(is_and ? 0 : 1), result);
+    if (is_and) {
+        // if (lhs != 0) 计算 rhs
+        builder.branch(lhs, short_true_bb, short_false_bb);
+    } else {
+        // if (lhs == 0) 计算 rhs
+        builder.branch(lhs, short_false_bb, short_true_bb);
     }
 
-    return std::visit([&](auto& expr) -> std::string {
-        return expr->toKoopa(generated_instructions);
-    }, expression);
-}
-
-std::string LAndExpOpAndEqExpAST::toKoopa(std::vector<std::string>& generated_instructions)
-{
-    // a && b 等价于：
-    // %left_bool = ne %a, 0    // 将左操作数转为布尔值
-    // %right_bool = ne %b, 0   // 将右操作数转为布尔值  
-    // %result = and %left_bool, %right_bool  // 按位与
-
-    auto left_bool_var = BaseAST::getNewTempVar();
-    auto right_bool_var = BaseAST::getNewTempVar();
-    auto result_var = BaseAST::getNewTempVar();
-
-    auto first_exp = first_expression->toKoopa(generated_instructions);
-    auto second_exp = latter_expression->toKoopa(generated_instructions);
-    // auto new_var = BaseAST::getNewTempVar();
-    
-    generated_instructions.push_back(stringFormat("%%%d = ne %s, 0", left_bool_var, first_exp));
-    generated_instructions.push_back(stringFormat("%%%d = ne %s, 0", right_bool_var, second_exp));
-    generated_instructions.push_back(stringFormat("%%%d = and %%%d, %%%d", result_var, left_bool_var, right_bool_var));
-    
-    return stringFormat("%%%d", result_var);
+    builder.insertBlock(short_true_bb); // 需要计算右操作数的分支
+    return result;
 }
 
-std::string LOrExpAST::toKoopa(std::vector<std::string>& generated_instructions)
+koopa_raw_value_t ExpAST::shortCircuitMergeToKoopa(int result_var, koopa_raw_value_t result, koopa_raw_value_t rhs, KoopaBuilder& builder) const
 {
-    // 短路求值优化
-    if (std::holds_alternative<std::unique_ptr<LOrExpOpAndLAndExpAST>>(expression)) {
-        // LOrExp "||" LAndExp
-        auto result_var = BaseAST::getNewTempVar();
-        const auto& lor_exp_op_and_land_exp = std::get<std::unique_ptr<LOrExpOpAndLAndExpAST>>(expression);
-        const auto& lhs_exp = lor_exp_op_and_land_exp->first_expression->toKoopa(generated_instructions);
-        auto lhs_bool_var = BaseAST::getNewTempVar();
+    auto* short_false_bb = builder.getBlock(KoopaBuilder::Label::SHORT_FALSE, result_var);
 
-        const auto short_true_bb = stringFormat("short_true_%d", result_var);
-        const auto short_false_bb = stringFormat("short_false_%d", result_var);
+    // 计算 rhs != 0
+    auto rhs_bool = builder.binary(KOOPA_RBO_NOT_EQ, rhs, builder.integer(0));
+    builder.store(rhs_bool, result); // result = (rhs != 0)
+    builder.jump(short_false_bb); // 跳转到汇合点
+    builder.insertBlock(short_false_bb); // 汇合点
 
-        generated_instructions.push_back(stringFormat("@_result_%d = alloc i32", result_var));
-        generated_instructions.push_back(stringFormat("store 1, @_result_%d", result_var));    // int result = 1;
-        generated_instructions.push_back(stringFormat("br %s, %%%s, %%%s", lhs_exp, short_false_bb, short_true_bb)); // if (lhs == 0)
-
-        generated_instructions.push_back(stringFormat("%%%s:", short_true_bb)); // 短路求值，直接跳转到短路真分支
-        // 计算 rhs != 0
-        auto rhs_exp = lor_exp_op_and_land_exp->latter_expression->toKoopa(generated_instructions);
-        auto rhs_bool_var = BaseAST::getNewTempVar();
-        generated_instructions.push_back(stringFormat("%%%d = ne %s, 0", rhs_bool_var, rhs_exp));
-        generated_instructions.push_back(stringFormat("store %%%d, @_result_%d", rhs_bool_var, result_var)); // result = (rhs != 0)
-        generated_instructions.push_back(stringFormat("jump %%%s", short_false_bb)); // 跳转到短路假分支
-        generated_instructions.push_back(stringFormat("%%%s:", short_false_bb)); // 短路假分支
-
-        auto new_result_temp_var = BaseAST::getNewTempVar();
-        generated_instructions.push_back(stringFormat("%%%d = load @_result_%d", new_result_temp_var, result_var)); // 将结果存储到变量中
-
-        return stringFormat("%%%d", new_result_temp_var);
-    }
-    return std::visit([&](auto& expr) -> std::string {
-        return expr->toKoopa(generated_instructions);
-    }, expression);
+    return builder.load(result); // 读出结果
 }
-
-std::string LOrExpOpAndLAndExpAST::toKoopa(std::vector<std::string>& generated_instructions)
-{
-    auto first_exp = first_expression->toKoopa(generated_instructions);
-    auto second_exp = latter_expression->toKoopa(generated_instructions);
-    
-    // 将操作数转换为布尔值（非零为1，零为0）
-    auto left_bool_var = BaseAST::getNewTempVar();
-    auto right_bool_var = BaseAST::getNewTempVar();
-    auto result_var = BaseAST::getNewTempVar();
-    
-    generated_instructions.push_back(stringFormat("%%%d = ne %s, 0", left_bool_var, first_exp));
-    generated_instructions.push_back(stringFormat("%%%d = ne %s, 0", right_bool_var, second_exp));
-    generated_instructions.push_back(stringFormat("%%%d = or %%%d, %%%d", result_var, left_bool_var, right_bool_var));
-    
-    return stringFormat("%%%d", result_var);
-}
\ No newline at end of file
@@ -0,0 +1,99 @@
+#include "file_watcher.h"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include "string_format.h"
+
+namespace {
+
+// 文件写完关闭、被 rename 覆盖或者新建后写完，都会产生其中一种事件
+constexpr std::uint32_t WATCH_EVENTS = IN_CLOSE_WRITE | IN_MOVED_TO;
+
+} // namespace
+
+FileWatcher::FileWatcher()
+    : fd_(::inotify_init1(IN_NONBLOCK | IN_CLOEXEC))
+{
+    if (fd_ < 0) {
+        throw std::runtime_error(stringFormat("inotify_init1: %s", std::strerror(errno)));
+    }
+}
+
+FileWatcher::~FileWatcher()
+{
+    ::close(fd_);
+}
+
+std::size_t FileWatcher::add(const std::string& path)
+{
+    const std::filesystem::path file(path);
+    auto directory = file.parent_path().string();
+    if (directory.empty()) {
+        directory = ".";
+    }
+
+    // 同一个目录只会得到一个 watch descriptor，多个文件共用
+    const int wd = ::inotify_add_watch(fd_, directory.c_str(), WATCH_EVENTS);
+    if (wd < 0) {
+        throw std::runtime_error(stringFormat("Cannot watch '%s': %s", directory.c_str(), std::strerror(errno)));
+    }
+    watches_[wd].push_back({ file.filename().string(), count_ });
+    return count_++;
+}
+
+bool FileWatcher::readEvents(std::vector<char>& changed)
+{
+    // inotify_event 后面紧跟着变长的文件名，缓冲区需要按 inotify_event 对齐
+    alignas(inotify_event) char buffer[16 * 1024];
+    bool any = false;
+    while (true) {
+        const auto size = ::read(fd_, buffer, sizeof(buffer));
+        if (size < 0 && errno == EINTR) {
+            continue;
+        }
+        if (size <= 0) {
+            return any;
+        }
+        for (const char* cursor = buffer; cursor < buffer + size;) {
+            const auto* event = reinterpret_cast<const inotify_event*>(cursor);
+            cursor += sizeof(inotify_event) + event->len;
+            const auto it = watches_.find(event->wd);
+            if (it == watches_.end() || event->len == 0) {
+                continue;
+            }
+            for (const auto& entry : it->second) {
+                if (entry.name == event->name) {
+                    changed[entry.index] = true;
+                    any = true;
+                }
+            }
+        }
+    }
+}
+
+std::vector<std::size_t> FileWatcher::wait()
+{
+    std::vector<char> changed(count_, false);
+    while (!readEvents(changed)) {
+        pollfd pfd { fd_, POLLIN, 0 };
+        if (::poll(&pfd, 1, -1) < 0 && errno != EINTR) {
+            throw std::runtime_error(stringFormat("poll: %s", std::strerror(errno)));
+        }
+    }
+
+    std::vector<std::size_t> indices;
+    for (std::size_t i = 0; i < count_; ++i) {
+        if (changed[i]) {
+            indices.push_back(i);
+        }
+    }
+    return indices;
+}
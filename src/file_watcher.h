@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// 用 inotify 监视一组文件的修改
+// 监视的是文件所在的目录而不是文件本身：编辑器保存时常常先写临时文件再 rename 覆盖原文件，
+// 原文件的 inode 随之消失，只有目录上的 IN_MOVED_TO 事件能反映这种修改。
+class FileWatcher {
+public:
+    // inotify 不可用时抛出 std::runtime_error
+    FileWatcher();
+    ~FileWatcher();
+
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+
+    // 开始监视 path，返回它的编号（按加入的顺序从 0 开始）
+    // 所在目录无法监视时抛出 std::runtime_error
+    std::size_t add(const std::string& path);
+
+    // 阻塞直到至少一个文件被写入或替换，返回这些文件的编号（按编号排序，不重复）
+    // 一次保存常常产生多个事件，已经到达的事件会合并到同一次返回中
+    std::vector<std::size_t> wait();
+
+private:
+    struct Entry {
+        std::string name; // 目录中的文件名
+        std::size_t index;
+    };
+
+    // 读取已经到达的全部事件，把变化了的文件的编号加入 changed
+    // 没有事件时立即返回 false
+    bool readEvents(std::vector<char>& changed);
+
+    int fd_ = -1;
+    std::size_t count_ = 0;
+    std::unordered_map<int, std::vector<Entry>> watches_; // inotify 的 watch descriptor -> 该目录中监视的文件
+};
@@ -0,0 +1,38 @@
+// 替换全局的 operator new / delete，为 -fmem-report 和 -ftime-trace 统计每个阶段的堆分配
+//
+// 单独放在一个翻译单元中，不属于 sysy_compiler 库：链接这个库的其他程序不会被替换全局的分配函数，
+// 需要堆分配统计的程序（命令行的编译器、compiler_bench）链接 CMake 目标 sysy_heap_counter。
+// 分配本身仍由 malloc 完成。没有调用 MemoryReport::enableHeapCounting() 时只多一次判断，
+// 开启后累加本线程的两个计数器；new[] 和 nothrow 版本都会调用这里。
+
+#include <cstdlib>
+#include <new>
+
+#include "memory_report.h"
+
+void* operator new(std::size_t size)
+{
+    if (MemoryReport::heapCountingEnabled()) {
+        MemoryReport::recordHeapAllocation(size);
+    }
+    while (true) {
+        if (void* ptr = std::malloc(size == 0 ? 1 : size)) {
+            return ptr;
+        }
+        auto handler = std::get_new_handler();
+        if (handler == nullptr) {
+            throw std::bad_alloc();
+        }
+        handler();
+    }
+}
+
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t /* size */) noexcept
+{
+    std::free(ptr);
+}
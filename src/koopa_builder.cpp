@@ -0,0 +1,594 @@
+#include "koopa_builder.h"
+
+#include <algorithm>
+#include <cassert>
+#include <charconv>
+#include <cstring>
+#include <iterator>
+
+#include "memory_report.h"
+#include "output_buffer.h"
+#include "time_report.h"
+
+namespace {
+
+koopa_raw_type_t int32Type()
+{
+    static const koopa_raw_type_kind_t type = { KOOPA_RTT_INT32, {} };
+    return &type;
+}
+
+koopa_raw_type_t unitType()
+{
+    static const koopa_raw_type_kind_t type = { KOOPA_RTT_UNIT, {} };
+    return &type;
+}
+
+koopa_raw_type_t int32PointerType()
+{
+    static const auto type = [] {
+        koopa_raw_type_kind_t pointer {};
+        pointer.tag = KOOPA_RTT_POINTER;
+        pointer.data.pointer.base = int32Type();
+        return pointer;
+    }();
+    return &type;
+}
+
+// 没有参数、返回 i32 的函数
+koopa_raw_type_t int32FunctionType()
+{
+    static const auto type = [] {
+        koopa_raw_type_kind_t function {};
+        function.tag = KOOPA_RTT_FUNCTION;
+        function.data.function.params = { nullptr, 0, KOOPA_RSIK_TYPE };
+        function.data.function.ret = int32Type();
+        return function;
+    }();
+    return &type;
+}
+
+// 依次访问一条指令用到的值，同一个值只访问一次
+template <typename F>
+void forEachOperand(koopa_raw_value_t inst, F&& visit)
+{
+    const auto& kind = inst->kind;
+    switch (kind.tag) {
+        case KOOPA_RVT_LOAD:
+            visit(kind.data.load.src);
+            break;
+        case KOOPA_RVT_STORE:
+            visit(kind.data.store.value);
+            if (kind.data.store.dest != kind.data.store.value) {
+                visit(kind.data.store.dest);
+            }
+            break;
+        case KOOPA_RVT_BINARY:
+            visit(kind.data.binary.lhs);
+            if (kind.data.binary.rhs != kind.data.binary.lhs) {
+                visit(kind.data.binary.rhs);
+            }
+            break;
+        case KOOPA_RVT_BRANCH:
+            visit(kind.data.branch.cond);
+            break;
+        case KOOPA_RVT_RETURN:
+            if (kind.data.ret.value != nullptr) {
+                visit(kind.data.ret.value);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+// 构造器创建的值的种类名，用于内存报告
+const char* valueKindName(koopa_raw_value_tag_t tag)
+{
+    switch (tag) {
+    case KOOPA_RVT_INTEGER:
+        return "integer";
+    case KOOPA_RVT_ALLOC:
+        return "alloc";
+    case KOOPA_RVT_LOAD:
+        return "load";
+    case KOOPA_RVT_STORE:
+        return "store";
+    case KOOPA_RVT_BINARY:
+        return "binary";
+    case KOOPA_RVT_BRANCH:
+        return "branch";
+    case KOOPA_RVT_JUMP:
+        return "jump";
+    case KOOPA_RVT_RETURN:
+        return "return";
+    default:
+        return "other value";
+    }
+}
+
+} // namespace
+
+void KoopaBuilder::countObject(const char* kind, std::size_t bytes)
+{
+    if (object_counts_ != nullptr) {
+        object_counts_->add(kind, bytes);
+    }
+}
+
+const char* KoopaBuilder::copyName(std::string_view name)
+{
+    countObject("name", name.size() + 1);
+    auto* buffer = static_cast<char*>(arena_.allocate(name.size() + 1, 1));
+    std::memcpy(buffer, name.data(), name.size());
+    buffer[name.size()] = '\0';
+    return buffer;
+}
+
+const char* KoopaBuilder::copyName(std::string_view prefix, int id)
+{
+    char digits[16];
+    const auto digits_end = std::to_chars(digits, digits + sizeof(digits), id).ptr;
+    const auto digits_size = static_cast<std::size_t>(digits_end - digits);
+    const auto size = prefix.size() + digits_size;
+    countObject("name", size + 1);
+    auto* buffer = static_cast<char*>(arena_.allocate(size + 1, 1));
+    std::memcpy(buffer, prefix.data(), prefix.size());
+    std::memcpy(buffer + prefix.size(), digits, digits_size);
+    buffer[size] = '\0';
+    return buffer;
+}
+
+koopa_raw_slice_t KoopaBuilder::createSlice(std::size_t len, koopa_raw_slice_item_kind_t kind)
+{
+    koopa_raw_slice_t slice { nullptr, static_cast<std::uint32_t>(len), kind };
+    if (len > 0) {
+        countObject("slice", len * sizeof(const void*));
+        slice.buffer = static_cast<const void**>(arena_.allocate(len * sizeof(const void*), alignof(const void*)));
+    }
+    return slice;
+}
+
+koopa_raw_value_data_t* KoopaBuilder::createValue(koopa_raw_type_t type, koopa_raw_value_tag_t tag)
+{
+    countObject(valueKindName(tag), sizeof(koopa_raw_value_data_t));
+    auto* value = create<koopa_raw_value_data_t>();
+    value->ty = type;
+    value->name = nullptr;
+    value->used_by = { nullptr, 0, KOOPA_RSIK_VALUE };
+    value->kind.tag = tag;
+    return value;
+}
+
+void KoopaBuilder::beginFunction(std::string_view name)
+{
+    assert(current_func_ == nullptr);
+    countObject("function", sizeof(koopa_raw_function_data_t));
+    current_func_ = create<koopa_raw_function_data_t>();
+    current_func_->ty = int32FunctionType();
+    current_func_->name = copyName("@" + std::string(name));
+    current_func_->params = { nullptr, 0, KOOPA_RSIK_VALUE };
+    // 标签只在函数内可见，每个函数从 0 开始编号，函数的 IR 与其他函数无关
+    next_id_ = 0;
+
+    insertBlock(getBlock("%entry"));
+}
+
+KoopaBuilder::Block* KoopaBuilder::createBlock(const char* name)
+{
+    countObject("basic block", sizeof(koopa_raw_basic_block_data_t));
+    auto* data = create<koopa_raw_basic_block_data_t>();
+    data->name = name;
+    data->params = { nullptr, 0, KOOPA_RSIK_VALUE };
+    data->used_by = { nullptr, 0, KOOPA_RSIK_VALUE };
+    data->insts = { nullptr, 0, KOOPA_RSIK_VALUE };
+    return &blocks_.emplace_back(Block { data });
+}
+
+KoopaBuilder::Block* KoopaBuilder::getBlock(std::string_view name)
+{
+    auto iter = blocks_by_name_.find(name);
+    if (iter != blocks_by_name_.end()) {
+        return iter->second;
+    }
+
+    auto* block = createBlock(copyName(name));
+    blocks_by_name_.emplace(std::string_view(block->data->name, name.size()), block);
+    return block;
+}
+
+KoopaBuilder::Block* KoopaBuilder::getBlock(Label label, int id)
+{
+    static constexpr std::string_view PREFIXES[] = {
+        "%then_", "%else_", "%end_", "%while_entry_", "%while_body_", "%while_continue_", "%while_end_",
+        "%short_true_", "%short_false_",
+    };
+    static_assert(std::size(PREFIXES) == static_cast<std::size_t>(Label::COUNT));
+    assert(id >= 0);
+
+    // 编号在函数内从 0 开始连续分配，直接用数组
+    const auto index = static_cast<std::size_t>(id) * static_cast<std::size_t>(Label::COUNT) + static_cast<std::size_t>(label);
+    if (index >= blocks_by_label_.size()) {
+        blocks_by_label_.resize(index + 1, nullptr);
+    }
+    auto& block = blocks_by_label_[index];
+    if (block == nullptr) {
+        block = createBlock(copyName(PREFIXES[static_cast<std::size_t>(label)], id));
+    }
+    return block;
+}
+
+void KoopaBuilder::insertBlock(Block* block)
+{
+    assert(!block->inserted);
+    // 上一个基本块没有结束指令时顺序执行到新块
+    if (current_block_ != nullptr && !current_block_->terminated) {
+        jump(block);
+    }
+    block->inserted = true;
+    layout_.push_back(block);
+    current_block_ = block;
+}
+
+void KoopaBuilder::append(koopa_raw_value_t inst)
+{
+    assert(current_block_ != nullptr);
+    // 当前基本块已经结束，之后的指令不可达
+    if (!current_block_->terminated) {
+        current_block_->insts.push_back(inst);
+    }
+}
+
+void KoopaBuilder::terminate(koopa_raw_value_t inst, Block* first_target, Block* second_target)
+{
+    assert(current_block_ != nullptr);
+    if (current_block_->terminated) {
+        return;
+    }
+    current_block_->insts.push_back(inst);
+    current_block_->terminated = true;
+    if (first_target != nullptr) {
+        current_block_->successors.push_back(first_target);
+    }
+    if (second_target != nullptr && second_target != first_target) {
+        current_block_->successors.push_back(second_target);
+    }
+}
+
+koopa_raw_value_t KoopaBuilder::integer(int value)
+{
+    auto* integer = createValue(int32Type(), KOOPA_RVT_INTEGER);
+    integer->kind.data.integer.value = value;
+    return integer;
+}
+
+koopa_raw_value_t KoopaBuilder::alloc(std::string_view name)
+{
+    auto* inst = createValue(int32PointerType(), KOOPA_RVT_ALLOC);
+    inst->name = copyName(name);
+    append(inst);
+    return inst;
+}
+
+koopa_raw_value_t KoopaBuilder::alloc(std::string_view prefix, int id)
+{
+    auto* inst = createValue(int32PointerType(), KOOPA_RVT_ALLOC);
+    inst->name = copyName(prefix, id);
+    append(inst);
+    return inst;
+}
+
+koopa_raw_value_t KoopaBuilder::load(koopa_raw_value_t src)
+{
+    auto* inst = createValue(src->ty->data.pointer.base, KOOPA_RVT_LOAD);
+    inst->kind.data.load.src = src;
+    append(inst);
+    return inst;
+}
+
+void KoopaBuilder::store(koopa_raw_value_t value, koopa_raw_value_t dest)
+{
+    auto* inst = createValue(unitType(), KOOPA_RVT_STORE);
+    inst->kind.data.store.value = value;
+    inst->kind.data.store.dest = dest;
+    append(inst);
+}
+
+koopa_raw_value_t KoopaBuilder::binary(koopa_raw_binary_op_t op, koopa_raw_value_t lhs, koopa_raw_value_t rhs)
+{
+    auto* inst = createValue(int32Type(), KOOPA_RVT_BINARY);
+    inst->kind.data.binary.op = op;
+    inst->kind.data.binary.lhs = lhs;
+    inst->kind.data.binary.rhs = rhs;
+    append(inst);
+    return inst;
+}
+
+void KoopaBuilder::branch(koopa_raw_value_t cond, Block* true_bb, Block* false_bb)
+{
+    auto* inst = createValue(unitType(), KOOPA_RVT_BRANCH);
+    inst->kind.data.branch.cond = cond;
+    inst->kind.data.branch.true_bb = true_bb->data;
+    inst->kind.data.branch.false_bb = false_bb->data;
+    inst->kind.data.branch.true_args = { nullptr, 0, KOOPA_RSIK_VALUE };
+    inst->kind.data.branch.false_args = { nullptr, 0, KOOPA_RSIK_VALUE };
+    terminate(inst, true_bb, false_bb);
+}
+
+void KoopaBuilder::jump(Block* target)
+{
+    auto* inst = createValue(unitType(), KOOPA_RVT_JUMP);
+    inst->kind.data.jump.target = target->data;
+    inst->kind.data.jump.args = { nullptr, 0, KOOPA_RSIK_VALUE };
+    terminate(inst, target);
+}
+
+void KoopaBuilder::ret(koopa_raw_value_t value)
+{
+    auto* inst = createValue(unitType(), KOOPA_RVT_RETURN);
+    inst->kind.data.ret.value = value;
+    terminate(inst);
+}
+
+void KoopaBuilder::endFunction()
+{
+    assert(current_func_ != nullptr);
+    const TimeReport::Scope scope(time_report_, "finalize", current_func_->name + 1);
+
+    // SysY 的函数可以不写 return 直接结束，Koopa 要求每个基本块都有结束指令
+    if (!current_block_->terminated) {
+        ret(integer(0));
+    }
+
+    // 从入口出发标记可达的基本块，例如 return 之后的语句生成的块不可达
+    std::vector<Block*> worklist { layout_.front() };
+    layout_.front()->reachable = true;
+    while (!worklist.empty()) {
+        auto* block = worklist.back();
+        worklist.pop_back();
+        for (auto* successor : block->successors) {
+            if (!successor->reachable) {
+                successor->reachable = true;
+                worklist.push_back(successor);
+            }
+        }
+    }
+    layout_.erase(std::remove_if(layout_.begin(), layout_.end(), [](const Block* block) { return !block->reachable; }),
+        layout_.end());
+
+    // 值和基本块都是构造器自己创建的，这里去掉 const 以填写 used_by
+    auto mutable_value = [](koopa_raw_value_t value) {
+        return const_cast<koopa_raw_value_data_t*>(value);
+    };
+
+    // 统计每个值和基本块的使用者数量，之后按数量分配 used_by 再填入使用者
+    for (const auto* block : layout_) {
+        for (const auto& inst : block->insts) {
+            forEachOperand(inst, [&](koopa_raw_value_t value) { mutable_value(value)->used_by.len++; });
+        }
+        for (auto* successor : block->successors) {
+            successor->data->used_by.len++;
+        }
+    }
+
+    auto add_user = [&](koopa_raw_slice_t& used_by, koopa_raw_value_t user) {
+        if (used_by.buffer == nullptr) {
+            used_by = createSlice(used_by.len, KOOPA_RSIK_VALUE);
+            used_by.len = 0;
+        }
+        used_by.buffer[used_by.len++] = user;
+    };
+    current_func_->bbs = createSlice(layout_.size(), KOOPA_RSIK_BASIC_BLOCK);
+    for (std::size_t i = 0; i < layout_.size(); ++i) {
+        auto* block = layout_[i];
+        for (const auto& inst : block->insts) {
+            forEachOperand(inst, [&](koopa_raw_value_t value) { add_user(mutable_value(value)->used_by, inst); });
+        }
+        for (auto* successor : block->successors) {
+            add_user(successor->data->used_by, block->insts.back());
+        }
+
+        // 写入指令列表和基本块列表
+        block->data->insts = createSlice(block->insts.size(), KOOPA_RSIK_VALUE);
+        std::copy(block->insts.begin(), block->insts.end(), block->data->insts.buffer);
+        current_func_->bbs.buffer[i] = block->data;
+    }
+
+    funcs_.push_back(current_func_);
+    current_func_ = nullptr;
+    blocks_.clear();
+    blocks_by_name_.clear();
+    blocks_by_label_.clear();
+    layout_.clear();
+    current_block_ = nullptr;
+}
+
+koopa_raw_program_t KoopaBuilder::build()
+{
+    assert(current_func_ == nullptr);
+
+    koopa_raw_program_t program;
+    program.values = createSlice(0, KOOPA_RSIK_VALUE);
+    program.funcs = createSlice(funcs_.size(), KOOPA_RSIK_FUNCTION);
+    std::copy(funcs_.begin(), funcs_.end(), program.funcs.buffer);
+    return program;
+}
+
+void KoopaBuilder::reset()
+{
+    // 上一次编译可能在函数中途因为错误而中止
+    current_func_ = nullptr;
+    blocks_.clear();
+    blocks_by_name_.clear();
+    blocks_by_label_.clear();
+    layout_.clear();
+    current_block_ = nullptr;
+
+    funcs_.clear();
+    next_id_ = 0;
+    arena_.reset();
+}
+
+namespace {
+
+const char* binaryOpName(koopa_raw_binary_op_t op)
+{
+    switch (op) {
+        case KOOPA_RBO_NOT_EQ: return "ne";
+        case KOOPA_RBO_EQ: return "eq";
+        case KOOPA_RBO_GT: return "gt";
+        case KOOPA_RBO_LT: return "lt";
+        case KOOPA_RBO_GE: return "ge";
+        case KOOPA_RBO_LE: return "le";
+        case KOOPA_RBO_ADD: return "add";
+        case KOOPA_RBO_SUB: return "sub";
+        case KOOPA_RBO_MUL: return "mul";
+        case KOOPA_RBO_DIV: return "div";
+        case KOOPA_RBO_MOD: return "mod";
+        case KOOPA_RBO_AND: return "and";
+        case KOOPA_RBO_OR: return "or";
+        case KOOPA_RBO_XOR: return "xor";
+        case KOOPA_RBO_SHL: return "shl";
+        case KOOPA_RBO_SHR: return "shr";
+        case KOOPA_RBO_SAR: return "sar";
+    }
+    return "add";
+}
+
+class KoopaDumper {
+public:
+    explicit KoopaDumper(OutputBuffer& out)
+        : out_(out)
+    {
+    }
+
+    void dump(const koopa_raw_program_t& program)
+    {
+        for (std::uint32_t i = 0; i < program.funcs.len; ++i) {
+            dumpFunction(static_cast<koopa_raw_function_t>(program.funcs.buffer[i]));
+        }
+    }
+
+private:
+    void dumpType(koopa_raw_type_t type)
+    {
+        switch (type->tag) {
+            case KOOPA_RTT_INT32:
+                out_ << "i32";
+                break;
+            case KOOPA_RTT_UNIT:
+                break;
+            case KOOPA_RTT_POINTER:
+                out_ << '*';
+                dumpType(type->data.pointer.base);
+                break;
+            default:
+                assert(false);
+        }
+    }
+
+    // 值作为操作数时的写法：整数直接写出数值，其他值写名字
+    void dumpOperand(koopa_raw_value_t value)
+    {
+        if (value->kind.tag == KOOPA_RVT_INTEGER) {
+            out_ << value->kind.data.integer.value;
+        } else if (value->name != nullptr) {
+            out_ << value->name;
+        } else {
+            auto [iter, inserted] = value_ids_.emplace(value, static_cast<int>(value_ids_.size()));
+            out_ << '%';
+            out_ << iter->second;
+        }
+    }
+
+    void dumpFunction(koopa_raw_function_t func)
+    {
+        value_ids_.clear();
+        out_ << "fun ";
+        out_ << func->name;
+        out_ << "(): ";
+        dumpType(func->ty->data.function.ret);
+        out_ << " {\n";
+        for (std::uint32_t i = 0; i < func->bbs.len; ++i) {
+            const auto* block = static_cast<koopa_raw_basic_block_t>(func->bbs.buffer[i]);
+            out_ << block->name;
+            out_ << ":\n";
+            for (std::uint32_t j = 0; j < block->insts.len; ++j) {
+                dumpInstruction(static_cast<koopa_raw_value_t>(block->insts.buffer[j]));
+            }
+        }
+        out_ << "}\n";
+    }
+
+    void dumpInstruction(koopa_raw_value_t inst)
+    {
+        const auto& kind = inst->kind;
+        out_ << "  ";
+        if (inst->ty->tag != KOOPA_RTT_UNIT) {
+            dumpOperand(inst);
+            out_ << " = ";
+        }
+        switch (kind.tag) {
+            case KOOPA_RVT_ALLOC:
+                out_ << "alloc ";
+                dumpType(inst->ty->data.pointer.base);
+                break;
+            case KOOPA_RVT_LOAD:
+                out_ << "load ";
+                dumpOperand(kind.data.load.src);
+                break;
+            case KOOPA_RVT_STORE:
+                out_ << "store ";
+                dumpOperand(kind.data.store.value);
+                out_ << ", ";
+                dumpOperand(kind.data.store.dest);
+                break;
+            case KOOPA_RVT_BINARY:
+                out_ << binaryOpName(kind.data.binary.op);
+                out_ << ' ';
+                dumpOperand(kind.data.binary.lhs);
+                out_ << ", ";
+                dumpOperand(kind.data.binary.rhs);
+                break;
+            case KOOPA_RVT_BRANCH:
+                out_ << "br ";
+                dumpOperand(kind.data.branch.cond);
+                out_ << ", ";
+                out_ << kind.data.branch.true_bb->name;
+                out_ << ", ";
+                out_ << kind.data.branch.false_bb->name;
+                break;
+            case KOOPA_RVT_JUMP:
+                out_ << "jump ";
+                out_ << kind.data.jump.target->name;
+                break;
+            case KOOPA_RVT_RETURN:
+                out_ << "ret";
+                if (kind.data.ret.value != nullptr) {
+                    out_ << ' ';
+                    dumpOperand(kind.data.ret.value);
+                }
+                break;
+            default:
+                assert(false);
+        }
+        out_ << '\n';
+    }
+
+    OutputBuffer& out_;
+    std::unordered_map<koopa_raw_value_t, int> value_ids_; // 没有名字的值的编号
+};
+
+} // namespace
+
+std::string dumpKoopa(const koopa_raw_program_t& program)
+{
+    OutputBuffer out;
+    dumpKoopa(program, out);
+    return out.take();
+}
+
+void dumpKoopa(const koopa_raw_program_t& program, OutputBuffer& out)
+{
+    KoopaDumper(out).dump(program);
+}
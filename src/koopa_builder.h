@@ -0,0 +1,138 @@
+#pragma once
+
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "arena.h"
+#include "koopa.h"
+
+class ObjectCounts;
+class OutputBuffer;
+class TimeReport;
+
+// 在内存中直接构造 Koopa IR
+// IR 生成阶段调用这里的接口得到 libkoopa 定义的 koopa_raw_* 结构，后端直接遍历它们，
+// 不再先拼出 Koopa 文本再交给 koopa_parse_from_string 重新解析。
+// 只有输出 -koopa 时才调用 dumpKoopa() 把 IR 打印成文本。
+//
+// 构造器记录当前基本块是否已经以 br / jump / ret 结束：
+// 结束之后、下一个基本块开始之前生成的指令不可达，直接丢弃；
+// 开始新的基本块时如果当前块还没有结束，则补一条跳转到新块的 jump。
+// 因此函数结束时不需要再扫描指令清理，只需删除从入口不可达的基本块并填写 used_by。
+//
+// 所有的值、基本块和函数都分配在构造器内部的 Arena 中，
+// build() 返回的程序只在构造器的生命周期内有效。
+class KoopaBuilder {
+public:
+    // 正在构造的基本块，指令先追加到 insts 中，函数结束时再写入 data
+    struct Block {
+        koopa_raw_basic_block_data_t* data;
+        std::vector<koopa_raw_value_t> insts;
+        std::vector<Block*> successors; // 结束指令跳转到的基本块
+        bool inserted = false; // 是否已经加入函数的基本块列表
+        bool terminated = false; // 是否已经以 br / jump / ret 结束
+        bool reachable = false; // 函数结束时标记，是否能从入口到达
+    };
+
+    // 控制流语句使用的基本块的种类，基本块的名字为种类的前缀加上 newId() 分配的编号，如 %then_3
+    enum class Label {
+        THEN,
+        ELSE,
+        END,
+        WHILE_ENTRY,
+        WHILE_BODY,
+        WHILE_CONTINUE,
+        WHILE_END,
+        SHORT_TRUE,
+        SHORT_FALSE,
+        COUNT,
+    };
+
+    KoopaBuilder() = default;
+
+    // 禁用拷贝和移动，IR 中的指针指向构造器内部
+    KoopaBuilder(const KoopaBuilder&) = delete;
+    KoopaBuilder& operator=(const KoopaBuilder&) = delete;
+
+    // 开始一个返回 i32 的函数，并进入它的入口基本块 %entry
+    void beginFunction(std::string_view name);
+    // 结束当前函数：末尾没有 return 时补上 ret 0，删除从入口不可达的基本块，
+    // 统计每个值和基本块的使用者，生成基本块和指令列表
+    void endFunction();
+
+    // 按名字（如 "%entry"）取得当前函数中的基本块，第一次引用时创建
+    Block* getBlock(std::string_view name);
+    // 按种类和编号取得当前函数中的基本块，第一次引用时创建并生成名字
+    // 之后的引用（如 break / continue）按整数查找，不再格式化名字；名字不能与按名字创建的基本块重复
+    Block* getBlock(Label label, int id);
+    // 把基本块追加到当前函数的末尾，之后的指令都插入到这个块中
+    void insertBlock(Block* block);
+
+    // 每次调用都创建一个新的整数常量，与 libkoopa 解析文本得到的结果一致
+    koopa_raw_value_t integer(int value);
+    // name 为 Koopa 中的名字，如 "@x_3"
+    koopa_raw_value_t alloc(std::string_view name);
+    // 名字为 prefix 加上编号，如 alloc("@_result_", 5) 的名字为 "@_result_5"
+    koopa_raw_value_t alloc(std::string_view prefix, int id);
+    koopa_raw_value_t load(koopa_raw_value_t src);
+    void store(koopa_raw_value_t value, koopa_raw_value_t dest);
+    koopa_raw_value_t binary(koopa_raw_binary_op_t op, koopa_raw_value_t lhs, koopa_raw_value_t rhs);
+    void branch(koopa_raw_value_t cond, Block* true_bb, Block* false_bb);
+    void jump(Block* target);
+    void ret(koopa_raw_value_t value);
+
+    // 分配一个在当前函数内唯一的编号，用于基本块标签和短路求值的结果变量，如 %then_3、@_result_5
+    int newId() { return next_id_++; }
+
+    // 得到整个程序，所有函数都必须已经结束
+    koopa_raw_program_t build();
+
+    // 记录 endFunction() 中清理工作的耗时，nullptr 表示不计时
+    void setTimeReport(TimeReport* report) { time_report_ = report; }
+    // 按种类（各种指令、基本块、函数、名字、列表）统计分配的 IR 对象，nullptr 表示不统计
+    void setObjectCounts(ObjectCounts* counts) { object_counts_ = counts; }
+
+    // 丢弃已经构造的所有函数（包括因出错而没有结束的函数）并把编号清零，
+    // 保留 Arena 的内存供下一个编译单元复用；之前 build() 得到的程序随之失效
+    void reset();
+
+private:
+    // 在 Arena 中创建一个清零的 koopa_raw_* 结构
+    template <typename T>
+    T* create()
+    {
+        return new (arena_.allocate(sizeof(T), alignof(T))) T {};
+    }
+
+    void countObject(const char* kind, std::size_t bytes);
+    const char* copyName(std::string_view name);
+    const char* copyName(std::string_view prefix, int id);
+    Block* createBlock(const char* name);
+    koopa_raw_value_data_t* createValue(koopa_raw_type_t type, koopa_raw_value_tag_t tag);
+    void append(koopa_raw_value_t inst);
+    void terminate(koopa_raw_value_t inst, Block* first_target = nullptr, Block* second_target = nullptr);
+    koopa_raw_slice_t createSlice(std::size_t len, koopa_raw_slice_item_kind_t kind);
+
+    Arena arena_;
+    TimeReport* time_report_ = nullptr;
+    ObjectCounts* object_counts_ = nullptr;
+    std::vector<koopa_raw_function_t> funcs_;
+    int next_id_ = 0;
+
+    // 当前函数的状态
+    koopa_raw_function_data_t* current_func_ = nullptr;
+    std::deque<Block> blocks_; // 当前函数中引用过的所有基本块，地址保持不变
+    std::unordered_map<std::string_view, Block*> blocks_by_name_; // 键指向 Arena 中的名字
+    std::vector<Block*> blocks_by_label_; // 下标为 编号 * Label::COUNT + 种类，没有创建的为 nullptr
+    std::vector<Block*> layout_; // 基本块在函数中的顺序
+    Block* current_block_ = nullptr;
+};
+
+// 把内存中的 Koopa IR 打印成文本
+// 没有名字的值按出现顺序命名为 %0, %1, ...
+std::string dumpKoopa(const koopa_raw_program_t& program);
+// 同上，文本直接写入 out
+void dumpKoopa(const koopa_raw_program_t& program, OutputBuffer& out);
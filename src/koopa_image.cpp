@@ -0,0 +1,587 @@
+#include "koopa_image.h"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "string_format.h"
+
+#ifndef MAP_FIXED_NOREPLACE
+// 旧的内核不认识这个标志，会把地址当作提示，装载时检查实际得到的地址
+#define MAP_FIXED_NOREPLACE 0x100000
+#endif
+
+namespace {
+
+constexpr std::uint32_t IMAGE_MAGIC = 0x494b5953; // "SYKI"
+// 格式改变时加一
+constexpr std::uint32_t IMAGE_VERSION = 1;
+// 写入时假定的装载地址，远离可执行文件、堆和共享库通常所在的区域
+constexpr std::uint64_t IMAGE_BASE = 0x3f5900000000ULL;
+
+// koopa.h 中各个结构的大小，编译器或 libkoopa 版本不同导致布局改变时拒绝旧的映像
+constexpr std::uint64_t LAYOUT = sizeof(void*) | sizeof(koopa_raw_slice_t) << 8
+    | sizeof(koopa_raw_type_kind_t) << 16 | sizeof(koopa_raw_function_data_t) << 24
+    | sizeof(koopa_raw_basic_block_data_t) << 32 | sizeof(koopa_raw_value_data_t) << 40;
+
+struct ImageHeader {
+    std::uint32_t magic;
+    std::uint32_t version;
+    std::uint64_t layout;
+    std::uint64_t base; // 写入时假定的装载地址
+    std::uint64_t size; // 整个映像的大小
+    std::uint64_t program; // koopa_raw_program_t 的偏移
+    // 重定位表的偏移，表是一个位图，每一位对应它之前的一个 8 字节字，为 1 表示这个字是指针
+    // 位图紧接在所有对象之后，一直到映像的末尾
+    std::uint64_t relocations;
+};
+
+// 覆盖 data_size 字节所需的位图大小，以 8 字节为单位
+constexpr std::uint64_t bitmapWords(std::uint64_t data_size)
+{
+    return (data_size / sizeof(std::uint64_t) + 63) / 64;
+}
+
+constexpr std::uint64_t NO_OBJECT = ~0ULL;
+
+// 把程序中所有可以到达的对象依次写入映像
+// 对象第一次被引用时只分配位置并加入待写列表，之后再填写内容，
+// 很长的 use-def 链也不会导致深度递归。
+class ImageWriter {
+public:
+    std::string write(const koopa_raw_program_t& program)
+    {
+        buffer_.assign(sizeof(ImageHeader), '\0');
+        const auto program_offset = reserve(sizeof(koopa_raw_program_t), alignof(koopa_raw_program_t));
+        putSlice(program_offset + offsetof(koopa_raw_program_t, values), program.values);
+        putSlice(program_offset + offsetof(koopa_raw_program_t, funcs), program.funcs);
+
+        while (!pending_.empty()) {
+            const auto item = pending_.back();
+            pending_.pop_back();
+            switch (item.kind) {
+                case KOOPA_RSIK_TYPE:
+                    writeType(item.offset, static_cast<koopa_raw_type_t>(item.object));
+                    break;
+                case KOOPA_RSIK_FUNCTION:
+                    writeFunction(item.offset, static_cast<koopa_raw_function_t>(item.object));
+                    break;
+                case KOOPA_RSIK_BASIC_BLOCK:
+                    writeBlock(item.offset, static_cast<koopa_raw_basic_block_t>(item.object));
+                    break;
+                default:
+                    writeValue(item.offset, static_cast<koopa_raw_value_t>(item.object));
+                    break;
+            }
+        }
+
+        const auto relocations = reserve(0, alignof(std::uint64_t));
+        std::vector<std::uint64_t> bitmap(bitmapWords(relocations));
+        for (const auto field : relocations_) {
+            const auto word = field / sizeof(std::uint64_t);
+            bitmap[word / 64] |= 1ULL << (word % 64);
+        }
+        reserve(bitmap.size() * sizeof(std::uint64_t), alignof(std::uint64_t));
+        std::memcpy(&buffer_[relocations], bitmap.data(), bitmap.size() * sizeof(std::uint64_t));
+
+        const ImageHeader header { IMAGE_MAGIC, IMAGE_VERSION, LAYOUT, IMAGE_BASE, buffer_.size(), program_offset,
+                                   relocations };
+        std::memcpy(&buffer_[0], &header, sizeof(header));
+        return std::move(buffer_);
+    }
+
+private:
+    struct Pending {
+        koopa_raw_slice_item_kind_t kind;
+        const void* object;
+        std::uint64_t offset;
+    };
+
+    // 在末尾分配清零的空间，返回它的偏移
+    std::uint64_t reserve(std::size_t size, std::size_t align)
+    {
+        const auto offset = (buffer_.size() + align - 1) / align * align;
+        buffer_.resize(offset + size, '\0');
+        return offset;
+    }
+
+    template <typename T>
+    void put(std::uint64_t offset, T value)
+    {
+        std::memcpy(&buffer_[offset], &value, sizeof(value));
+    }
+
+    // 写入指向 target 的指针，并把这个字段加入重定位表
+    void putPointer(std::uint64_t field, std::uint64_t target)
+    {
+        if (target == NO_OBJECT) {
+            put<std::uint64_t>(field, 0);
+            return;
+        }
+        put<std::uint64_t>(field, IMAGE_BASE + target);
+        relocations_.push_back(field);
+    }
+
+    // 取得对象在映像中的位置，第一次引用时分配
+    std::uint64_t place(koopa_raw_slice_item_kind_t kind, const void* object)
+    {
+        if (object == nullptr) {
+            return NO_OBJECT;
+        }
+        const auto [it, inserted] = offsets_.try_emplace(object, 0);
+        if (inserted) {
+            switch (kind) {
+                case KOOPA_RSIK_TYPE:
+                    it->second = reserve(sizeof(koopa_raw_type_kind_t), alignof(koopa_raw_type_kind_t));
+                    break;
+                case KOOPA_RSIK_FUNCTION:
+                    it->second = reserve(sizeof(koopa_raw_function_data_t), alignof(koopa_raw_function_data_t));
+                    break;
+                case KOOPA_RSIK_BASIC_BLOCK:
+                    it->second = reserve(sizeof(koopa_raw_basic_block_data_t), alignof(koopa_raw_basic_block_data_t));
+                    break;
+                case KOOPA_RSIK_VALUE:
+                    it->second = reserve(sizeof(koopa_raw_value_data_t), alignof(koopa_raw_value_data_t));
+                    break;
+                default:
+                    throw std::runtime_error("Cannot serialize a Koopa slice of unknown item kind");
+            }
+            pending_.push_back({ kind, object, it->second });
+        }
+        return it->second;
+    }
+
+    void putName(std::uint64_t field, const char* name)
+    {
+        if (name == nullptr) {
+            putPointer(field, NO_OBJECT);
+            return;
+        }
+        const auto length = std::strlen(name) + 1;
+        const auto offset = reserve(length, 1);
+        std::memcpy(&buffer_[offset], name, length);
+        putPointer(field, offset);
+    }
+
+    void putSlice(std::uint64_t field, const koopa_raw_slice_t& slice)
+    {
+        std::uint64_t items = NO_OBJECT;
+        if (slice.len > 0) {
+            items = reserve(slice.len * sizeof(void*), alignof(void*));
+            for (std::uint32_t i = 0; i < slice.len; ++i) {
+                putPointer(items + i * sizeof(void*), place(slice.kind, slice.buffer[i]));
+            }
+        }
+        putPointer(field + offsetof(koopa_raw_slice_t, buffer), items);
+        put(field + offsetof(koopa_raw_slice_t, len), slice.len);
+        put(field + offsetof(koopa_raw_slice_t, kind), slice.kind);
+    }
+
+    void writeType(std::uint64_t offset, koopa_raw_type_t type)
+    {
+        put(offset + offsetof(koopa_raw_type_kind_t, tag), type->tag);
+        switch (type->tag) {
+            case KOOPA_RTT_ARRAY:
+                putPointer(offset + offsetof(koopa_raw_type_kind_t, data.array.base),
+                           place(KOOPA_RSIK_TYPE, type->data.array.base));
+                put(offset + offsetof(koopa_raw_type_kind_t, data.array.len), type->data.array.len);
+                break;
+            case KOOPA_RTT_POINTER:
+                putPointer(offset + offsetof(koopa_raw_type_kind_t, data.pointer.base),
+                           place(KOOPA_RSIK_TYPE, type->data.pointer.base));
+                break;
+            case KOOPA_RTT_FUNCTION:
+                putSlice(offset + offsetof(koopa_raw_type_kind_t, data.function.params), type->data.function.params);
+                putPointer(offset + offsetof(koopa_raw_type_kind_t, data.function.ret),
+                           place(KOOPA_RSIK_TYPE, type->data.function.ret));
+                break;
+            default:
+                break;
+        }
+    }
+
+    void writeFunction(std::uint64_t offset, koopa_raw_function_t func)
+    {
+        putPointer(offset + offsetof(koopa_raw_function_data_t, ty), place(KOOPA_RSIK_TYPE, func->ty));
+        putName(offset + offsetof(koopa_raw_function_data_t, name), func->name);
+        putSlice(offset + offsetof(koopa_raw_function_data_t, params), func->params);
+        putSlice(offset + offsetof(koopa_raw_function_data_t, bbs), func->bbs);
+    }
+
+    void writeBlock(std::uint64_t offset, koopa_raw_basic_block_t block)
+    {
+        putName(offset + offsetof(koopa_raw_basic_block_data_t, name), block->name);
+        putSlice(offset + offsetof(koopa_raw_basic_block_data_t, params), block->params);
+        putSlice(offset + offsetof(koopa_raw_basic_block_data_t, used_by), block->used_by);
+        putSlice(offset + offsetof(koopa_raw_basic_block_data_t, insts), block->insts);
+    }
+
+    void writeValue(std::uint64_t offset, koopa_raw_value_t value)
+    {
+        putPointer(offset + offsetof(koopa_raw_value_data_t, ty), place(KOOPA_RSIK_TYPE, value->ty));
+        putName(offset + offsetof(koopa_raw_value_data_t, name), value->name);
+        putSlice(offset + offsetof(koopa_raw_value_data_t, used_by), value->used_by);
+
+        const auto& kind = value->kind;
+        const auto base = offset + offsetof(koopa_raw_value_data_t, kind);
+        const auto data = base + offsetof(koopa_raw_value_kind_t, data);
+        const auto operand = [&](std::size_t field, koopa_raw_value_t target) {
+            putPointer(data + field, place(KOOPA_RSIK_VALUE, target));
+        };
+        const auto block = [&](std::size_t field, koopa_raw_basic_block_t target) {
+            putPointer(data + field, place(KOOPA_RSIK_BASIC_BLOCK, target));
+        };
+
+        put(base + offsetof(koopa_raw_value_kind_t, tag), kind.tag);
+        switch (kind.tag) {
+            case KOOPA_RVT_INTEGER:
+                put(data + offsetof(koopa_raw_integer_t, value), kind.data.integer.value);
+                break;
+            case KOOPA_RVT_AGGREGATE:
+                putSlice(data + offsetof(koopa_raw_aggregate_t, elems), kind.data.aggregate.elems);
+                break;
+            case KOOPA_RVT_FUNC_ARG_REF:
+                put(data + offsetof(koopa_raw_func_arg_ref_t, index), kind.data.func_arg_ref.index);
+                break;
+            case KOOPA_RVT_BLOCK_ARG_REF:
+                put(data + offsetof(koopa_raw_block_arg_ref_t, index), kind.data.block_arg_ref.index);
+                break;
+            case KOOPA_RVT_GLOBAL_ALLOC:
+                operand(offsetof(koopa_raw_global_alloc_t, init), kind.data.global_alloc.init);
+                break;
+            case KOOPA_RVT_LOAD:
+                operand(offsetof(koopa_raw_load_t, src), kind.data.load.src);
+                break;
+            case KOOPA_RVT_STORE:
+                operand(offsetof(koopa_raw_store_t, value), kind.data.store.value);
+                operand(offsetof(koopa_raw_store_t, dest), kind.data.store.dest);
+                break;
+            case KOOPA_RVT_GET_PTR:
+                operand(offsetof(koopa_raw_get_ptr_t, src), kind.data.get_ptr.src);
+                operand(offsetof(koopa_raw_get_ptr_t, index), kind.data.get_ptr.index);
+                break;
+            case KOOPA_RVT_GET_ELEM_PTR:
+                operand(offsetof(koopa_raw_get_elem_ptr_t, src), kind.data.get_elem_ptr.src);
+                operand(offsetof(koopa_raw_get_elem_ptr_t, index), kind.data.get_elem_ptr.index);
+                break;
+            case KOOPA_RVT_BINARY:
+                put(data + offsetof(koopa_raw_binary_t, op), kind.data.binary.op);
+                operand(offsetof(koopa_raw_binary_t, lhs), kind.data.binary.lhs);
+                operand(offsetof(koopa_raw_binary_t, rhs), kind.data.binary.rhs);
+                break;
+            case KOOPA_RVT_BRANCH:
+                operand(offsetof(koopa_raw_branch_t, cond), kind.data.branch.cond);
+                block(offsetof(koopa_raw_branch_t, true_bb), kind.data.branch.true_bb);
+                block(offsetof(koopa_raw_branch_t, false_bb), kind.data.branch.false_bb);
+                putSlice(data + offsetof(koopa_raw_branch_t, true_args), kind.data.branch.true_args);
+                putSlice(data + offsetof(koopa_raw_branch_t, false_args), kind.data.branch.false_args);
+                break;
+            case KOOPA_RVT_JUMP:
+                block(offsetof(koopa_raw_jump_t, target), kind.data.jump.target);
+                putSlice(data + offsetof(koopa_raw_jump_t, args), kind.data.jump.args);
+                break;
+            case KOOPA_RVT_CALL:
+                putPointer(data + offsetof(koopa_raw_call_t, callee), place(KOOPA_RSIK_FUNCTION, kind.data.call.callee));
+                putSlice(data + offsetof(koopa_raw_call_t, args), kind.data.call.args);
+                break;
+            case KOOPA_RVT_RETURN:
+                operand(offsetof(koopa_raw_return_t, value), kind.data.ret.value);
+                break;
+            default:
+                break;
+        }
+    }
+
+    std::string buffer_;
+    std::unordered_map<const void*, std::uint64_t> offsets_;
+    std::vector<Pending> pending_;
+    std::vector<std::uint64_t> relocations_;
+};
+
+// 检查装载后的映像中从程序可以到达的每个对象：指针指向对象区内对齐的位置，整个对象都在对象区内，
+// 切片的缓冲区放得下 len 个指针且元素种类正确，名字在对象区内结束，类型、值和二元运算的标签都是已知的。
+// 通过检查的映像可以被后端安全地遍历（IR 本身是否合法仍不检查）。
+class ImageChecker {
+public:
+    ImageChecker(const char* objects, std::uint64_t size) : objects_(objects), size_(size) {}
+
+    bool check(const koopa_raw_program_t& program)
+    {
+        if (!slice(program.values, KOOPA_RSIK_VALUE) || !slice(program.funcs, KOOPA_RSIK_FUNCTION)) {
+            return false;
+        }
+        while (!pending_.empty()) {
+            const auto [kind, object] = pending_.back();
+            pending_.pop_back();
+            bool ok = false;
+            switch (kind) {
+                case KOOPA_RSIK_TYPE:
+                    ok = checkType(static_cast<koopa_raw_type_t>(object));
+                    break;
+                case KOOPA_RSIK_FUNCTION:
+                    ok = checkFunction(static_cast<koopa_raw_function_t>(object));
+                    break;
+                case KOOPA_RSIK_BASIC_BLOCK:
+                    ok = checkBlock(static_cast<koopa_raw_basic_block_t>(object));
+                    break;
+                default:
+                    ok = checkValue(static_cast<koopa_raw_value_t>(object));
+                    break;
+            }
+            if (!ok) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+private:
+    // 对象区中 size 字节、按 align 对齐的一段内存的偏移，不在对象区内时返回 NO_OBJECT
+    std::uint64_t locate(const void* pointer, std::size_t size, std::size_t align) const
+    {
+        const auto offset = reinterpret_cast<std::uintptr_t>(pointer) - reinterpret_cast<std::uintptr_t>(objects_);
+        if (offset >= size_ || size_ - offset < size || offset % align != 0) {
+            return NO_OBJECT;
+        }
+        return offset;
+    }
+
+    // 检查 object 可以放下一个 kind 种类的对象，第一次遇到时加入待查列表
+    bool reference(koopa_raw_slice_item_kind_t kind, const void* object)
+    {
+        std::size_t size = 0;
+        switch (kind) {
+            case KOOPA_RSIK_TYPE:
+                size = sizeof(koopa_raw_type_kind_t);
+                break;
+            case KOOPA_RSIK_FUNCTION:
+                size = sizeof(koopa_raw_function_data_t);
+                break;
+            case KOOPA_RSIK_BASIC_BLOCK:
+                size = sizeof(koopa_raw_basic_block_data_t);
+                break;
+            case KOOPA_RSIK_VALUE:
+                size = sizeof(koopa_raw_value_data_t);
+                break;
+            default:
+                return false;
+        }
+        // 所有对象都按 8 字节对齐，低位用来区分同一地址上不同种类的对象
+        if (locate(object, size, alignof(void*)) == NO_OBJECT) {
+            return false;
+        }
+        if (visited_.insert(reinterpret_cast<std::uintptr_t>(object) | kind).second) {
+            pending_.push_back({ kind, object });
+        }
+        return true;
+    }
+
+    bool name(const char* name) const
+    {
+        if (name == nullptr) {
+            return true;
+        }
+        const auto offset = locate(name, 1, 1);
+        return offset != NO_OBJECT && std::memchr(name, '\0', size_ - offset) != nullptr;
+    }
+
+    bool slice(const koopa_raw_slice_t& slice, koopa_raw_slice_item_kind_t kind)
+    {
+        if (slice.kind != kind) {
+            return false;
+        }
+        if (slice.len == 0) {
+            return true;
+        }
+        const auto offset = locate(slice.buffer, sizeof(void*), alignof(void*));
+        if (offset == NO_OBJECT || (size_ - offset) / sizeof(void*) < slice.len) {
+            return false;
+        }
+        for (std::uint32_t i = 0; i < slice.len; ++i) {
+            if (!reference(kind, slice.buffer[i])) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool checkType(koopa_raw_type_t type)
+    {
+        switch (type->tag) {
+            case KOOPA_RTT_INT32:
+            case KOOPA_RTT_UNIT:
+                return true;
+            case KOOPA_RTT_ARRAY:
+                return reference(KOOPA_RSIK_TYPE, type->data.array.base);
+            case KOOPA_RTT_POINTER:
+                return reference(KOOPA_RSIK_TYPE, type->data.pointer.base);
+            case KOOPA_RTT_FUNCTION:
+                return slice(type->data.function.params, KOOPA_RSIK_TYPE)
+                    && reference(KOOPA_RSIK_TYPE, type->data.function.ret);
+            default:
+                return false;
+        }
+    }
+
+    bool checkFunction(koopa_raw_function_t func)
+    {
+        return reference(KOOPA_RSIK_TYPE, func->ty) && name(func->name) && slice(func->params, KOOPA_RSIK_VALUE)
+            && slice(func->bbs, KOOPA_RSIK_BASIC_BLOCK);
+    }
+
+    bool checkBlock(koopa_raw_basic_block_t block)
+    {
+        return name(block->name) && slice(block->params, KOOPA_RSIK_VALUE) && slice(block->used_by, KOOPA_RSIK_VALUE)
+            && slice(block->insts, KOOPA_RSIK_VALUE);
+    }
+
+    bool checkValue(koopa_raw_value_t value)
+    {
+        if (!reference(KOOPA_RSIK_TYPE, value->ty) || !name(value->name) || !slice(value->used_by, KOOPA_RSIK_VALUE)) {
+            return false;
+        }
+        const auto& kind = value->kind;
+        const auto operand = [this](koopa_raw_value_t target) { return reference(KOOPA_RSIK_VALUE, target); };
+        const auto block = [this](koopa_raw_basic_block_t target) { return reference(KOOPA_RSIK_BASIC_BLOCK, target); };
+        switch (kind.tag) {
+            case KOOPA_RVT_INTEGER:
+            case KOOPA_RVT_ZERO_INIT:
+            case KOOPA_RVT_UNDEF:
+            case KOOPA_RVT_FUNC_ARG_REF:
+            case KOOPA_RVT_BLOCK_ARG_REF:
+            case KOOPA_RVT_ALLOC:
+                return true;
+            case KOOPA_RVT_AGGREGATE:
+                return slice(kind.data.aggregate.elems, KOOPA_RSIK_VALUE);
+            case KOOPA_RVT_GLOBAL_ALLOC:
+                return operand(kind.data.global_alloc.init);
+            case KOOPA_RVT_LOAD:
+                return operand(kind.data.load.src);
+            case KOOPA_RVT_STORE:
+                return operand(kind.data.store.value) && operand(kind.data.store.dest);
+            case KOOPA_RVT_GET_PTR:
+                return operand(kind.data.get_ptr.src) && operand(kind.data.get_ptr.index);
+            case KOOPA_RVT_GET_ELEM_PTR:
+                return operand(kind.data.get_elem_ptr.src) && operand(kind.data.get_elem_ptr.index);
+            case KOOPA_RVT_BINARY:
+                return static_cast<std::uint32_t>(kind.data.binary.op) <= KOOPA_RBO_SAR
+                    && operand(kind.data.binary.lhs) && operand(kind.data.binary.rhs);
+            case KOOPA_RVT_BRANCH:
+                return operand(kind.data.branch.cond) && block(kind.data.branch.true_bb)
+                    && block(kind.data.branch.false_bb) && slice(kind.data.branch.true_args, KOOPA_RSIK_VALUE)
+                    && slice(kind.data.branch.false_args, KOOPA_RSIK_VALUE);
+            case KOOPA_RVT_JUMP:
+                return block(kind.data.jump.target) && slice(kind.data.jump.args, KOOPA_RSIK_VALUE);
+            case KOOPA_RVT_CALL:
+                return reference(KOOPA_RSIK_FUNCTION, kind.data.call.callee)
+                    && slice(kind.data.call.args, KOOPA_RSIK_VALUE);
+            case KOOPA_RVT_RETURN:
+                // ret 可以没有返回值
+                return kind.data.ret.value == nullptr || operand(kind.data.ret.value);
+            default:
+                return false;
+        }
+    }
+
+    struct Pending {
+        koopa_raw_slice_item_kind_t kind;
+        const void* object;
+    };
+
+    const char* objects_;
+    std::uint64_t size_;
+    std::unordered_set<std::uintptr_t> visited_;
+    std::vector<Pending> pending_;
+};
+
+} // namespace
+
+std::string serializeKoopa(const koopa_raw_program_t& program)
+{
+    return ImageWriter().write(program);
+}
+
+KoopaImage::KoopaImage(const char* path)
+{
+    const int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::runtime_error(stringFormat("Cannot open input file '%s'", path));
+    }
+    struct stat st {};
+    ImageHeader header {};
+    const bool ok = ::fstat(fd, &st) == 0 && ::pread(fd, &header, sizeof(header), 0) == sizeof(header);
+    if (!ok || header.magic != IMAGE_MAGIC || header.version != IMAGE_VERSION || header.layout != LAYOUT
+        || header.size != static_cast<std::uint64_t>(st.st_size) || header.relocations % sizeof(std::uint64_t) != 0
+        || header.relocations > header.size
+        || header.size - header.relocations != bitmapWords(header.relocations) * sizeof(std::uint64_t)
+        || header.program % alignof(koopa_raw_program_t) != 0 || header.relocations < sizeof(koopa_raw_program_t)
+        || header.program > header.relocations - sizeof(koopa_raw_program_t)) {
+        ::close(fd);
+        throw std::runtime_error(stringFormat("'%s' is not a valid Koopa image", path));
+    }
+
+    // 先尝试映射到假定的地址；写时复制的私有映射，只有需要重定位时才会复制页面
+    const std::size_t size = header.size;
+    void* data = ::mmap(reinterpret_cast<void*>(header.base), size, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_FIXED_NOREPLACE, fd, 0);
+    if (data == MAP_FAILED) {
+        data = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    }
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        throw std::runtime_error(stringFormat("Cannot map '%s': %s", path, std::strerror(errno)));
+    }
+    data_ = data;
+    size_ = size;
+
+    // 检查每个指针都指向映像内部，地址不同时顺便修正
+    auto* bytes = static_cast<char*>(data);
+    const auto delta = reinterpret_cast<std::uint64_t>(data) - header.base;
+    relocated_ = delta != 0;
+    const auto* bitmap = reinterpret_cast<const std::uint64_t*>(bytes + header.relocations);
+    auto* words = reinterpret_cast<std::uint64_t*>(bytes);
+    for (std::uint64_t i = 0; i < bitmapWords(header.relocations); ++i) {
+        for (auto bits = bitmap[i]; bits != 0; bits &= bits - 1) {
+            const auto word = i * 64 + __builtin_ctzll(bits);
+            if (word >= header.relocations / sizeof(std::uint64_t) || words[word] - header.base >= size) {
+                ::munmap(data_, size_);
+                throw std::runtime_error(stringFormat("'%s' is not a valid Koopa image", path));
+            }
+            if (relocated_) {
+                words[word] += delta;
+            }
+        }
+    }
+    ::mprotect(data_, size_, PROT_READ);
+    program_ = reinterpret_cast<const koopa_raw_program_t*>(bytes + header.program);
+    if (!ImageChecker(bytes, header.relocations).check(*program_)) {
+        ::munmap(data_, size_);
+        throw std::runtime_error(stringFormat("'%s' is not a valid Koopa image", path));
+    }
+}
+
+KoopaImage::~KoopaImage()
+{
+    ::munmap(data_, size_);
+}
+
+bool KoopaImage::isImageFile(const char* path)
+{
+    const int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    std::uint32_t magic = 0;
+    const bool ok = ::pread(fd, &magic, sizeof(magic), 0) == sizeof(magic);
+    ::close(fd);
+    return ok && magic == IMAGE_MAGIC;
+}
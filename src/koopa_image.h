@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#include "koopa.h"
+
+// Koopa IR 的二进制映像
+// 映像就是 libkoopa 的 koopa_raw_* 结构本身：程序、函数、基本块、指令、类型和名字
+// 按原样排列在一块连续的内存中，指针都写成“假定装载地址 + 偏移”，并附带一张重定位表。
+//
+// 装载时把文件 mmap 到假定的地址，成功时所有指针直接有效，后端不经过任何解析和拷贝
+// 就能遍历其中的 IR，页面与内核的页缓存共享；该地址已被占用时映射到别处，按重定位表修正指针。
+//
+// 映像的格式依赖于 koopa.h 中结构的内存布局，头部记录了版本号和布局签名，
+// 不匹配的映像会被拒绝。映像应当来自本编译器（如缓存或其他编译节点），
+// 装载时检查头部、重定位表，以及每个对象、切片、名字都完整地落在映像内、标签都是已知的，
+// 损坏的映像不会让后端越界访问；不检查 IR 本身是否合法。
+
+// 把程序写成二进制映像
+std::string serializeKoopa(const koopa_raw_program_t& program);
+
+// 装载一个二进制映像，映像在对象的生命周期内有效
+class KoopaImage {
+public:
+    // 打开并装载映像文件，无法打开或格式不对时抛出 std::runtime_error
+    explicit KoopaImage(const char* path);
+    ~KoopaImage();
+
+    KoopaImage(const KoopaImage&) = delete;
+    KoopaImage& operator=(const KoopaImage&) = delete;
+
+    const koopa_raw_program_t& program() const { return *program_; }
+    // 是否因为假定的地址被占用而修正过指针
+    bool relocated() const { return relocated_; }
+
+    // 文件是否以映像的魔数开头，用来区分映像和 Koopa 文本
+    static bool isImageFile(const char* path);
+
+private:
+    void* data_ = nullptr;
+    std::size_t size_ = 0;
+    const koopa_raw_program_t* program_ = nullptr;
+    bool relocated_ = false;
+};
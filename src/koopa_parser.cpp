@@ -1,12 +1,20 @@
 #include "koopa_parser.h"
 
 #include "koopa.h"
+#include "output_buffer.h"
 #include "string_format.h"
+#include "time_report.h"
 #include <cassert>
+#include <cstdint>
 #include <iostream>
+#include <iterator>
 #include <memory>
+#include <stdexcept>
 #include <string>
+#include <string_view>
+#include <tuple>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 // RAII wrapper for koopa_program_t
@@ -96,6 +104,72 @@ private:
     koopa_raw_program_builder_t builder_;
 };
 
+namespace {
+
+// 指令的操作数
+// 原来以字符串 "0"、"x0"、"tN"、"N(sp)" 表示，现在记录种类和编号，输出时再写成文本
+struct Operand {
+    enum Kind : std::uint8_t {
+        NONE, // 没有结果的指令
+        ZERO, // 整数 0，写作 "0"
+        X0, // 零寄存器，写作 "x0"
+        TEMP, // 临时寄存器 tN
+        STACK, // 栈上的值 N(sp)
+    };
+
+    Kind kind = NONE;
+    int n = 0;
+
+    bool operator==(Kind other) const { return kind == other; }
+    bool operator!=(Kind other) const { return kind != other; }
+};
+
+OutputBuffer& operator<<(OutputBuffer& out, const Operand& operand)
+{
+    switch (operand.kind) {
+    case Operand::ZERO:
+        return out << '0';
+    case Operand::X0:
+        return out << "x0";
+    case Operand::TEMP:
+        return out << 't' << operand.n;
+    case Operand::STACK:
+        return out << operand.n << "(sp)";
+    default:
+        return out;
+    }
+}
+
+// 去掉名字开头的 @ / %
+std::string_view extractIdentName(const char* name)
+{
+    if (name == nullptr) {
+        return {};
+    }
+    const std::string_view view(name);
+    if (view.empty() || (view[0] != '@' && view[0] != '%')) {
+        return view; // 如果没有 @ / % 前缀，直接返回
+    }
+    return view.substr(1); // 去掉 @ / % 前缀
+}
+
+// 后端不支持的 Koopa 值或指令，抛出异常，由调用方报告错误
+[[noreturn]] void unsupportedValue(koopa_raw_value_tag_t tag)
+{
+    static const char* const names[] = {
+        "integer", "zeroinit", "undef",  "aggregate", "func arg ref", "block arg ref", "alloc", "global alloc",
+        "load",    "store",    "getptr", "getelemptr", "binary",      "branch",        "jump",  "call",
+        "return",
+    };
+    const auto index = static_cast<std::size_t>(tag);
+    if (index < std::size(names)) {
+        throw std::runtime_error(stringFormat("unsupported Koopa value kind '%s'", names[index]));
+    }
+    throw std::runtime_error(stringFormat("unsupported Koopa value kind %d", static_cast<int>(tag)));
+}
+
+} // namespace
+
 // PImpl implementation
 class KoopaParser::Impl {
 private:
@@ -104,10 +178,13 @@ private:
     koopa_raw_program_t raw_program_ {};
     int temp_var_count_ = 0;
     int serial_num_ = 0; // 用于生成唯一的临时 ID
-    std::vector<std::string> generated_instructions_;
-    std::unordered_map<const void*, std::string> value_to_register_; // 值到寄存器的映射
+    OutputBuffer* out_ = nullptr; // 当前的输出
+    TimeReport* time_report_ = nullptr;
+    bool collect_stats_ = false;
+    std::vector<FunctionStats> stats_; // 每个函数的统计，collect_stats_ 时才记录
+    std::unordered_map<const void*, Operand> value_to_register_; // 值到寄存器的映射
     std::unordered_map<const void*, int> value_to_offset_; // 值到栈偏移的映射
-    std::unordered_map<std::string, int> var_to_offset_; // 变量名到函数栈内偏移量的映射
+    std::unordered_map<std::string_view, int> var_to_offset_; // 变量名到函数栈内偏移量的映射，名字指向 IR 中的字符串
     int current_stack_offset_ = 0; // 当前栈偏移
     int total_stack_size_ = 0; // 总栈空间大小
 
@@ -138,17 +215,66 @@ public:
         return old_count;
     }
 
-    auto& getGeneratedInstructions()
+    // 开始输出一行缩进的指令，调用方写完操作数后以 '\n' 结束
+    OutputBuffer& emit(std::string_view mnemonic)
+    {
+        if (collect_stats_) {
+            countInstruction(mnemonic);
+        }
+        return *out_ << "  " << mnemonic;
+    }
+
+    // 记录到当前函数和当前基本块（prologue 不属于任何基本块）
+    void countInstruction(std::string_view mnemonic)
+    {
+        auto& function = stats_.back();
+        auto* block = function.blocks.empty() ? nullptr : &function.blocks.back();
+        ++function.riscv_instructions;
+        if (block != nullptr) {
+            ++block->riscv_instructions;
+        }
+        if (mnemonic == "li") {
+            ++function.li;
+        } else if (mnemonic == "lw") {
+            ++function.loads;
+            if (block != nullptr) {
+                ++block->loads;
+            }
+        } else if (mnemonic == "sw") {
+            ++function.stores;
+            if (block != nullptr) {
+                ++block->stores;
+            }
+        }
+    }
+
+    void setCollectStats(bool collect)
+    {
+        collect_stats_ = collect;
+        stats_.clear();
+    }
+
+    std::vector<FunctionStats> takeStats()
+    {
+        return std::exchange(stats_, {});
+    }
+
+    void setOutput(OutputBuffer& out)
+    {
+        out_ = &out;
+    }
+
+    void setTimeReport(TimeReport* report)
     {
-        return generated_instructions_;
+        time_report_ = report;
     }
 
-    void addVarToOffset(const std::string& var_name, int offset)
+    void addVarToOffset(std::string_view var_name, int offset)
     {
         var_to_offset_[var_name] = offset;
     }
 
-    int getVarOffset(const std::string& var_name) {
+    int getVarOffset(std::string_view var_name) {
         // 如果变量名在映射中，直接返回
         auto it = var_to_offset_.find(var_name);
         if (it != var_to_offset_.end()) {
@@ -177,75 +303,83 @@ public:
 
     const koopa_raw_program_t* parseToRawProgram(const std::string& input)
     {
+        // 同一个 KoopaParser 可以解析多个程序，先释放上一次解析得到的 program
+        program_ = KoopaProgram();
+
         // 解析输入字符串为 program
-        koopa_error_code_t ret = koopa_parse_from_string(input.c_str(), program_.get());
-        assert(ret == KOOPA_EC_SUCCESS);
+        // 输入可能是手写的或者从其他地方取得的 IR，不合法时报告错误而不是直接终止
+        {
+            const TimeReport::Scope scope(time_report_, "koopa-parse");
+            koopa_error_code_t ret = koopa_parse_from_string(input.c_str(), program_.get());
+            if (ret != KOOPA_EC_SUCCESS) {
+                throw std::runtime_error(stringFormat("Invalid Koopa IR (libkoopa error code %d)", static_cast<int>(ret)));
+            }
+        }
 
         // 将 Koopa IR 程序转换为 raw program
+        const TimeReport::Scope scope(time_report_, "koopa-build-raw");
         raw_program_ = koopa_build_raw_program(builder_.get(), *program_.get());
 
         return &raw_program_;
     }
 
-    std::vector<std::string> Visit(const koopa_raw_program_t& program)
+    void Visit(const koopa_raw_program_t& program)
     {
         // 执行一些其他的必要操作
         // ...
 
-        getGeneratedInstructions().clear();
-        clearTempVarCounter();
+        VisitHeader(program);
+        VisitFunctions(program);
+    }
 
-        // 访问所有全局变量
-        const auto values = Visit(program.values);
-        // 访问所有函数（目前只有一个）
-        const auto func = Visit(program.funcs);
+    // 程序开头的段声明和全局符号声明
+    void VisitHeader(const koopa_raw_program_t& program)
+    {
+        clearTempVarCounter();
 
-        std::vector<std::string> commands = { "  .text" };
+        *out_ << "  .text\n";
 
         // Add global declaration for main function
-        commands.push_back("  .globl main");
-
-        for (const auto& iden : values) {
-            commands.push_back(stringFormat("  .globl %s", iden));
-        }
+        *out_ << "  .globl main\n";
 
-        for (const auto& command : func) {
-            commands.push_back(command);
+        // 还不支持全局变量
+        if (program.values.len > 0) {
+            unsupportedValue(reinterpret_cast<koopa_raw_value_t>(program.values.buffer[0])->kind.tag);
         }
+    }
 
-        return commands;
+    // 所有函数的代码，每个函数都从干净的状态开始生成，与其他函数无关
+    void VisitFunctions(const koopa_raw_program_t& program)
+    {
+        // 访问所有函数（目前只有一个）
+        Visit(program.funcs);
     }
 
     // 访问 raw slice
-    std::vector<std::string> Visit(const koopa_raw_slice_t& slice)
+    void Visit(const koopa_raw_slice_t& slice)
     {
-        std::vector<std::string> result;
         for (size_t i = 0; i < slice.len; ++i) {
             auto ptr = slice.buffer[i];
-            std::vector<std::string> item_result;
             // 根据 slice 的 kind 决定将 ptr 视作何种元素
-            // std::cout << "[DEBUG] Visiting slice item " << i
-            //           << " of kind " << slice.kind << std::endl;
             switch (slice.kind) {
             case KOOPA_RSIK_FUNCTION:
                 // 访问函数
-                item_result = Visit(reinterpret_cast<koopa_raw_function_t>(ptr));
+                Visit(reinterpret_cast<koopa_raw_function_t>(ptr));
                 break;
             case KOOPA_RSIK_BASIC_BLOCK:
                 // 访问基本块
-                item_result = Visit(reinterpret_cast<koopa_raw_basic_block_t>(ptr));
+                Visit(reinterpret_cast<koopa_raw_basic_block_t>(ptr));
                 break;
             case KOOPA_RSIK_VALUE:
                 // 访问指令
-                item_result = Visit(reinterpret_cast<koopa_raw_value_t>(ptr));
+                Visit(reinterpret_cast<koopa_raw_value_t>(ptr));
                 break;
             default:
-                // 我们暂时不会遇到其他内容, 于是不对其做任何处理
-                assert(false);
+                // 我们暂时不会遇到其他内容
+                throw std::runtime_error(
+                    stringFormat("unsupported Koopa slice kind %d", static_cast<int>(slice.kind)));
             }
-            result.insert(result.end(), item_result.begin(), item_result.end());
         }
-        return result;
     }
 
     // 工具函数，返回 x 与 alignment 对齐后的值
@@ -282,94 +416,91 @@ public:
     }
 
     // 访问函数
-    std::vector<std::string> Visit(const koopa_raw_function_t& func)
+    void Visit(const koopa_raw_function_t& func)
     {
         // 执行一些其他的必要操作
         // ...
 
-        // 清空之前的指令
-        getGeneratedInstructions().clear();
+        // 清空之前的状态
         clearTempVarCounter();
 
-        // 访问所有基本块
-        std::vector<std::string> result;
-
         // Extract function name (remove @ prefix if present)
-        std::string func_name = func->name;
+        std::string_view func_name = func->name;
         if (func_name[0] == '@') {
             func_name = func_name.substr(1);
         }
+        // 只支持没有参数的函数定义
+        if (func->bbs.len == 0) {
+            throw std::runtime_error(
+                stringFormat("unsupported Koopa function declaration '%s'", std::string(func_name).c_str()));
+        }
+        if (func->params.len > 0) {
+            throw std::runtime_error(
+                stringFormat("unsupported Koopa function parameters in '%s'", std::string(func_name).c_str()));
+        }
+        const TimeReport::Scope scope(time_report_, "codegen", func_name);
 
-        result.push_back(stringFormat("%s:", func_name));
+        *out_ << func_name << ":\n";
 
         // 计算 prologue 偏移量
         int prologue_offset = getPrologueOffset(func);
+        if (collect_stats_) {
+            auto& stats = stats_.emplace_back();
+            stats.name = func_name;
+            stats.basic_blocks = func->bbs.len;
+            stats.frame_size = prologue_offset;
+        }
         if (prologue_offset > 0) {
             if (prologue_offset <= 2047) {
-                result.push_back(stringFormat("  addi sp, sp, -%d", prologue_offset));
+                emit("addi") << " sp, sp, -" << prologue_offset << '\n';
             } else {
-                result.push_back(stringFormat("  li t0, -%d", prologue_offset));
-                result.push_back(stringFormat("  add sp, sp, t0"));
+                emit("li") << " t0, -" << prologue_offset << '\n';
+                emit("add") << " sp, sp, t0\n";
             }
         }
 
-        const auto bbs = Visit(func->bbs);
-
-        // auto generated = getGeneratedInstructions();
-        // auto generated_with_indent = std::vector<std::string>();
-        // for (const auto& instr : generated) {
-        //     generated_with_indent.push_back(stringFormat("  %s", instr));
-        // }
-        // result.insert(result.end(), generated_with_indent.begin(), generated_with_indent.end());
-
-        // for (const auto& bb : bbs) {
-        //     result.push_back(stringFormat("  %s", bb));
-        // }
-        // return result;
-
-        // 添加生成的指令到结果中
-        auto generated = getGeneratedInstructions();
-        for (const auto& instr : generated) {
-            result.push_back(stringFormat("  %s", instr));
-        }
-
-        return result;
+        // 访问所有基本块，指令直接写入输出
+        Visit(func->bbs);
     }
 
     // 访问基本块
-    std::vector<std::string> Visit(const koopa_raw_basic_block_t& bb)
+    void Visit(const koopa_raw_basic_block_t& bb)
     {
         // 执行一些其他的必要操作
         // ...
 
         // 生成基本块的标签
-        std::string bb_label = extractIdentName(bb->name);
-        getGeneratedInstructions().push_back(stringFormat("%s:", bb_label));
+        *out_ << "  " << extractIdentName(bb->name) << ":\n";
+        if (collect_stats_) {
+            auto& function = stats_.back();
+            function.koopa_instructions += bb->insts.len;
+            auto& block = function.blocks.emplace_back();
+            block.name = extractIdentName(bb->name);
+            block.koopa_instructions = bb->insts.len;
+        }
 
         // 访问所有指令
-        return Visit(bb->insts);
-        return {}; // 返回空向量，因为指令已经添加到 generated_instructions_ 中
+        Visit(bb->insts);
     }
 
     // 访问指令
-    std::vector<std::string> Visit(const koopa_raw_value_t& value)
+    Operand Visit(const koopa_raw_value_t& value)
     {
         // 检查是否已经处理过这个值
         auto iter = value_to_register_.find(value);
         if (iter != value_to_register_.end()) {
             // 如果值在栈上，加载到寄存器
-            if (iter->second.find("(sp)") != std::string::npos) {
+            if (iter->second == Operand::STACK) {
                 int reg_num = getNewTempVar();
-                getGeneratedInstructions().push_back(
-                    stringFormat("lw t%d, %s", reg_num, iter->second));
-                return { stringFormat("t%d", reg_num) };
+                emit("lw") << " t" << reg_num << ", " << iter->second << '\n';
+                return { Operand::TEMP, reg_num };
             }
-            return { iter->second };
+            return iter->second;
         }
 
         // 根据指令类型判断后续需要如何访问
         const auto& kind = value->kind;
-        std::vector<std::string> result;
+        Operand result;
 
         switch (kind.tag) {
         case KOOPA_RVT_RETURN:
@@ -390,8 +521,7 @@ public:
         case KOOPA_RVT_ALLOC:
             // 访问 alloc 指令 - alloc指令返回变量的栈地址
             if (value->name) {
-                int offset = getVarOffset(value->name);
-                result = { stringFormat("%d(sp)", offset) };
+                result = { Operand::STACK, getVarOffset(value->name) };
             }
             break;
         case KOOPA_RVT_BRANCH:
@@ -400,27 +530,27 @@ public:
         case KOOPA_RVT_JUMP:
             result = Visit(kind.data.jump);
             break;
-
-
         default:
-            assert(false);
+            unsupportedValue(kind.tag);
         }
 
         // 对于有返回值的指令，如果被多次使用，存储到栈中
         if (value->ty->tag != KOOPA_RTT_UNIT && kind.tag != KOOPA_RVT_RETURN && 
             kind.tag != KOOPA_RVT_STORE && kind.tag != KOOPA_RVT_ALLOC) {
             
-            if (!result.empty() && value->used_by.len > 1) {
+            if (result != Operand::NONE && value->used_by.len > 1) {
                 // 被多次使用，存储到栈
-                int offset = getValueOffset(value);
-                getGeneratedInstructions().push_back(
-                    stringFormat("sw %s, %d(sp)", result.at(0), offset));
-                value_to_register_[value] = stringFormat("%d(sp)", offset);
-                return { stringFormat("%d(sp)", offset) };
+                if (collect_stats_) {
+                    ++stats_.back().spilled_values;
+                }
+                const Operand slot { Operand::STACK, getValueOffset(value) };
+                emit("sw") << ' ' << result << ", " << slot << '\n';
+                value_to_register_[value] = slot;
+                return slot;
             } else {
                 // 只被使用一次，直接缓存寄存器
-                if (!result.empty()) {
-                    value_to_register_[value] = result[0];
+                if (result != Operand::NONE) {
+                    value_to_register_[value] = result;
                 }
             }
         }
@@ -428,327 +558,273 @@ public:
         return result;
     }
 
-    std::string extractIdentName(const std::string& name)
+    Operand Visit(const koopa_raw_branch_t& branch)
     {
-        // 提取标识符名称，去掉 @ 前缀
-        if (name.empty() || (name[0] != '@' && name[0] != '%')) {
-            return name; // 如果没有 @ / % 前缀，直接返回
+        auto condition = Visit(branch.cond);
+        if (condition == Operand::NONE) {
+            throw std::runtime_error("Branch instruction: condition is empty");
+        }
+        if (condition == Operand::ZERO) {
+            condition.kind = Operand::X0;
         }
-        return name.substr(1); // 去掉 @ / % 前缀
-    }
-
-    std::string extractIdentName(const char* name)
-    {
-        return extractIdentName(std::string(name));
-    }
-
-    std::vector<std::string> Visit(const koopa_raw_branch_t& branch)
-    {
-        const auto& condition = Visit(branch.cond);
-        const auto condition_name = condition.at(0) == "0" ? "x0" : condition.at(0);
 
         // 只生成条件跳转指令，不生成标签
         // 标签应该由函数级别的基本块访问器生成
 
-        getGeneratedInstructions().push_back(
-            stringFormat("bnez %s, %s", condition_name, extractIdentName(branch.true_bb->name)));
-        getGeneratedInstructions().push_back(
-            stringFormat("j %s", extractIdentName(branch.false_bb->name)));
-        
-        return {}; // 返回空向量，因为指令已经添加到 generated_instructions_ 中
+        emit("bnez") << ' ' << condition << ", " << extractIdentName(branch.true_bb->name) << '\n';
+        emit("j") << ' ' << extractIdentName(branch.false_bb->name) << '\n';
+
+        return {}; // 没有结果，指令已经写入输出
     }
 
-    std::vector<std::string> Visit(const koopa_raw_jump_t& target)
+    Operand Visit(const koopa_raw_jump_t& target)
     {
         // 访问 jump 指令 - 跳转到指定的基本块
         // 直接添加跳转指令
-        getGeneratedInstructions().push_back(
-            stringFormat("j %s", extractIdentName(target.target->name)));
-        return {}; // 返回空向量，因为指令已经添加到 generated_instructions_ 中
+        emit("j") << ' ' << extractIdentName(target.target->name) << '\n';
+        return {}; // 没有结果，指令已经写入输出
     }
 
-    std::vector<std::string> Visit(const koopa_raw_integer_t& integer)
+    Operand Visit(const koopa_raw_integer_t& integer)
     {
-        // 返回整数值的字符串表示
-        // return { std::to_string(integer.value) };
         // 假设所有用到的数字都需要存在寄存器里（以后再来优化）
 
         if (integer.value == 0) {
-            return { "0" };
+            return { Operand::ZERO };
         }
 
         // 其他数字分配寄存器
         int new_var = getNewTempVar();
-        getGeneratedInstructions().push_back(
-            stringFormat("li t%d, %d", new_var, integer.value));
-        return { stringFormat("t%d", new_var) };
+        emit("li") << " t" << new_var << ", " << integer.value << '\n';
+        return { Operand::TEMP, new_var };
     }
 
-    std::vector<std::string> Visit(const koopa_raw_return_t& ret)
+    Operand Visit(const koopa_raw_return_t& ret)
     {
         // 访问 return 指令的值
         if (ret.value) {
             auto visited = Visit(ret.value);
-            assert(visited.size() == 1);
+            if (visited == Operand::NONE) {
+                throw std::runtime_error("Return instruction: value is empty");
+            }
 
-            if (visited.at(0) == "0") {
+            if (visited == Operand::ZERO) {
                 // 如果返回值是 0，则直接使用 x0
-                getGeneratedInstructions().push_back("li a0, 0");
-            } else if (visited.at(0).find("t") != std::string::npos) {
+                emit("li") << " a0, 0\n";
+            } else if (visited == Operand::TEMP) {
                 // 否则将返回值加载到 a0 寄存器
-                getGeneratedInstructions().push_back(
-                    stringFormat("mv a0, %s", visited.at(0)));
-            } else if (visited.at(0).find("(sp)") != std::string::npos) {
+                emit("mv") << " a0, " << visited << '\n';
+            } else if (visited == Operand::STACK) {
                 // 如果是栈上的值，需要先加载
-                getGeneratedInstructions().push_back(
-                    stringFormat("lw a0, %s", visited.at(0)));
+                emit("lw") << " a0, " << visited << '\n';
             } else {
                 // 如果返回值是数字
-                getGeneratedInstructions().push_back(
-                    stringFormat("li a0, %s", visited.at(0)));
+                emit("li") << " a0, " << visited << '\n';
             }
             
             // 添加函数的 epilogue
             if (total_stack_size_ > 0) {
                 if (total_stack_size_ <= 2047) {
-                    getGeneratedInstructions().push_back(
-                        stringFormat("addi sp, sp, %d", total_stack_size_));
+                    emit("addi") << " sp, sp, " << total_stack_size_ << '\n';
                 } else {
-                    getGeneratedInstructions().push_back(
-                        stringFormat("li t0, %d", total_stack_size_));
-                    getGeneratedInstructions().push_back("add sp, sp, t0");
+                    emit("li") << " t0, " << total_stack_size_ << '\n';
+                    emit("add") << " sp, sp, t0\n";
                 }
             }
-            getGeneratedInstructions().push_back("ret");
-            return {}; // 返回空，因为已经添加到指令列表中
+            emit("ret") << '\n';
+            return {}; // 没有结果，指令已经写入输出
         }
-        getGeneratedInstructions().push_back("ret");
+        emit("ret") << '\n';
         return {};
     }
 
-    std::tuple<std::string, std::string> initBinaryArgs(const koopa_raw_binary_t& binary)
+    // 如果操作数是栈上的值，先加载到寄存器
+    Operand loadIfOnStack(Operand operand)
     {
-        // 访问二元运算指令的操作数
-        auto lhs_reg = Visit(binary.lhs);
-        auto rhs_reg = Visit(binary.rhs);
-        assert(lhs_reg.size() == 1 && rhs_reg.size() == 1);
-
-        std::string lhs_final = lhs_reg.at(0);
-        std::string rhs_final = rhs_reg.at(0);
-
-        // 如果操作数是栈上的值，需要先加载到寄存器
-        if (lhs_final.find("(sp)") != std::string::npos) {
+        if (operand == Operand::STACK) {
             int temp_reg = getNewTempVar();
-            getGeneratedInstructions().push_back(
-                stringFormat("lw t%d, %s", temp_reg, lhs_final));
-            lhs_final = stringFormat("t%d", temp_reg);
+            emit("lw") << " t" << temp_reg << ", " << operand << '\n';
+            return { Operand::TEMP, temp_reg };
         }
+        return operand;
+    }
 
-        if (rhs_final.find("(sp)") != std::string::npos) {
-            int temp_reg = getNewTempVar();
-            getGeneratedInstructions().push_back(
-                stringFormat("lw t%d, %s", temp_reg, rhs_final));
-            rhs_final = stringFormat("t%d", temp_reg);
+    std::tuple<Operand, Operand> initBinaryArgs(const koopa_raw_binary_t& binary)
+    {
+        // 访问二元运算指令的操作数
+        auto lhs_final = Visit(binary.lhs);
+        auto rhs_final = Visit(binary.rhs);
+        if (lhs_final == Operand::NONE || rhs_final == Operand::NONE) {
+            throw std::runtime_error("Binary instruction: operand is empty");
         }
 
+        // 如果操作数是栈上的值，需要先加载到寄存器
+        lhs_final = loadIfOnStack(lhs_final);
+        rhs_final = loadIfOnStack(rhs_final);
+
         // 处理0值
-        if (lhs_final == "0") {
-            lhs_final = "x0";
+        if (lhs_final == Operand::ZERO) {
+            lhs_final.kind = Operand::X0;
         }
-        if (rhs_final == "0") {
-            rhs_final = "x0";
+        if (rhs_final == Operand::ZERO) {
+            rhs_final.kind = Operand::X0;
         }
 
         return { lhs_final, rhs_final };
     }
 
-    std::vector<std::string> Visit(const koopa_raw_load_t& load)
+    Operand Visit(const koopa_raw_load_t& load)
     {
         // 访问 load 指令 - 从内存加载到寄存器
         auto src_addr = Visit(load.src);  // 获取源地址
-        if (src_addr.empty()) {
+        if (src_addr == Operand::NONE) {
             throw std::runtime_error("Load instruction: source address is empty");
         }
         
         // 分配新的寄存器
         int reg_num = getNewTempVar();
-        getGeneratedInstructions().push_back(
-            stringFormat("lw t%d, %s", reg_num, src_addr.at(0)));
-        return { stringFormat("t%d", reg_num) };
+        emit("lw") << " t" << reg_num << ", " << src_addr << '\n';
+        return { Operand::TEMP, reg_num };
     }
 
-    std::vector<std::string> Visit(const koopa_raw_store_t& store)
+    Operand Visit(const koopa_raw_store_t& store)
     {
         // 访问 store 指令
-        auto value_result = Visit(store.value);  // 先获取要存储的值
+        auto value_reg = Visit(store.value);  // 先获取要存储的值
         auto dest_addr = Visit(store.dest);      // 再获取目标地址
         
-        if (value_result.empty() || dest_addr.empty()) {
+        if (value_reg == Operand::NONE || dest_addr == Operand::NONE) {
             throw std::runtime_error("Store instruction: value or destination is empty");
         }
         
-        std::string value_reg = value_result.at(0);
-        
         // 如果值在栈上，需要先加载到寄存器
-        if (value_reg.find("(sp)") != std::string::npos) {
-            int temp_reg = getNewTempVar();
-            getGeneratedInstructions().push_back(
-                stringFormat("lw t%d, %s", temp_reg, value_reg));
-            value_reg = stringFormat("t%d", temp_reg);
-        }
+        value_reg = loadIfOnStack(value_reg);
         
         // 处理 0 值
-        if (value_reg == "0") {
-            value_reg = "x0";
+        if (value_reg == Operand::ZERO) {
+            value_reg.kind = Operand::X0;
         }
         
-        getGeneratedInstructions().push_back(
-            stringFormat("sw %s, %s", value_reg, dest_addr.at(0)));
+        emit("sw") << ' ' << value_reg << ", " << dest_addr << '\n';
         return {};  // store指令没有返回值
     }
 
-    std::vector<std::string> Visit(const koopa_raw_binary_t& binary)
+    Operand Visit(const koopa_raw_binary_t& binary)
     {
         // 访问二元运算指令
         auto [lhs, rhs] = initBinaryArgs(binary);
 
         // 优先重用左操作数的寄存器（如果它是临时寄存器）
         int new_var = getNewTempVar();
+        const Operand dest { Operand::TEMP, new_var };
         
         switch (binary.op) {
         case KOOPA_RBO_SUB:
-            if (lhs == "x0") {
+            if (lhs == Operand::X0) {
                 // 0 - rhs = -rhs
-                getGeneratedInstructions().push_back(
-                    stringFormat("sub t%d, x0, %s", new_var, rhs));
-            } else if (rhs == "x0") {
+                emit("sub") << ' ' << dest << ", x0, " << rhs << '\n';
+            } else if (rhs == Operand::X0) {
                 // lhs - 0 = lhs，可以直接返回左操作数
-                return { lhs };
+                return lhs;
             } else {
                 // 一般情况
-                getGeneratedInstructions().push_back(
-                    stringFormat("sub t%d, %s, %s", new_var, lhs, rhs));
+                emit("sub") << ' ' << dest << ", " << lhs << ", " << rhs << '\n';
             }
             break;
         
         case KOOPA_RBO_ADD:
             // 如果左侧或右侧是 0，直接使用另一个操作数
-            if (lhs == "x0") {
-                return { rhs };
-            } else if (rhs == "x0") {
-                return { lhs };
+            if (lhs == Operand::X0) {
+                return rhs;
+            } else if (rhs == Operand::X0) {
+                return lhs;
             }
             // 一般情况下的加法
-            getGeneratedInstructions().push_back(
-                stringFormat("add t%d, %s, %s", new_var, lhs, rhs));
+            emit("add") << ' ' << dest << ", " << lhs << ", " << rhs << '\n';
             break;
         
         case KOOPA_RBO_MUL:
             // 如果左侧或右侧是 0，直接返回 0
-            if (lhs == "x0" || rhs == "x0") {
-                return { "x0" };
-            }
-            // 如果右侧是 1，直接返回左侧
-            if (rhs.find("t") == std::string::npos && rhs != "x0") {
-                // 检查是否为立即数 1
-                try {
-                    if (std::stoi(rhs) == 1) {
-                        return { lhs };
-                    }
-                } catch (...) {
-                    // 不是数字，继续正常处理
-                }
+            // 操作数都已经在寄存器中，不会出现立即数 1
+            if (lhs == Operand::X0 || rhs == Operand::X0) {
+                return { Operand::X0 };
             }
             // 一般情况下的乘法
-            getGeneratedInstructions().push_back(
-                stringFormat("mul t%d, %s, %s", new_var, lhs, rhs));
+            emit("mul") << ' ' << dest << ", " << lhs << ", " << rhs << '\n';
             break;
 
         case KOOPA_RBO_DIV:
         case KOOPA_RBO_MOD:
             {
-                std::string op = (binary.op == KOOPA_RBO_DIV) ? "div" : "rem";
+                const std::string_view op = (binary.op == KOOPA_RBO_DIV) ? "div" : "rem";
                 // 如果左侧是 0，直接返回 0
-                if (lhs == "x0") {
-                    return { "x0" };
+                if (lhs == Operand::X0) {
+                    return { Operand::X0 };
                 }
                 // 如果右侧是 0，抛出异常或处理错误
-                if (rhs == "x0") {
+                if (rhs == Operand::X0) {
                     throw std::runtime_error("Division by zero error");
                 }
-                getGeneratedInstructions().push_back(
-                    stringFormat("%s t%d, %s, %s", op, new_var, lhs, rhs));
+                emit(op) << ' ' << dest << ", " << lhs << ", " << rhs << '\n';
             }
             break;
 
         case KOOPA_RBO_EQ:
-            if (rhs == "x0") {
+            if (rhs == Operand::X0) {
                 // 如果右侧是 0，使用 seqz 指令
-                getGeneratedInstructions().push_back(
-                    stringFormat("seqz t%d, %s", new_var, lhs));
+                emit("seqz") << ' ' << dest << ", " << lhs << '\n';
             } else {
                 // 一般情况下的相等比较
-                getGeneratedInstructions().push_back(
-                    stringFormat("xor t%d, %s, %s", new_var, lhs, rhs));
-                getGeneratedInstructions().push_back(
-                    stringFormat("seqz t%d, t%d", new_var, new_var));
+                emit("xor") << ' ' << dest << ", " << lhs << ", " << rhs << '\n';
+                emit("seqz") << ' ' << dest << ", " << dest << '\n';
             }
             break;
         
         case KOOPA_RBO_NOT_EQ:
-            if (rhs == "x0") {
+            if (rhs == Operand::X0) {
                 // 如果右侧是 0，使用 snez 指令
-                getGeneratedInstructions().push_back(
-                    stringFormat("snez t%d, %s", new_var, lhs));
+                emit("snez") << ' ' << dest << ", " << lhs << '\n';
             } else {
                 // 一般情况下的不等比较
-                getGeneratedInstructions().push_back(
-                    stringFormat("xor t%d, %s, %s", new_var, lhs, rhs));
-                getGeneratedInstructions().push_back(
-                    stringFormat("snez t%d, t%d", new_var, new_var));
+                emit("xor") << ' ' << dest << ", " << lhs << ", " << rhs << '\n';
+                emit("snez") << ' ' << dest << ", " << dest << '\n';
             }
             break;
 
         case KOOPA_RBO_LT:
-            getGeneratedInstructions().push_back(
-                stringFormat("slt t%d, %s, %s", new_var, lhs, rhs));
+            emit("slt") << ' ' << dest << ", " << lhs << ", " << rhs << '\n';
             break;
 
         case KOOPA_RBO_GT:
-            getGeneratedInstructions().push_back(
-                stringFormat("sgt t%d, %s, %s", new_var, lhs, rhs));
+            emit("sgt") << ' ' << dest << ", " << lhs << ", " << rhs << '\n';
             break;
 
         case KOOPA_RBO_LE:
             // a <= b 等价于 !(a > b)
-            getGeneratedInstructions().push_back(
-                stringFormat("sgt t%d, %s, %s", new_var, lhs, rhs));
-            getGeneratedInstructions().push_back(
-                stringFormat("seqz t%d, t%d", new_var, new_var));
+            emit("sgt") << ' ' << dest << ", " << lhs << ", " << rhs << '\n';
+            emit("seqz") << ' ' << dest << ", " << dest << '\n';
             break;
 
         case KOOPA_RBO_GE:
             // a >= b 等价于 !(a < b)
-            getGeneratedInstructions().push_back(
-                stringFormat("slt t%d, %s, %s", new_var, lhs, rhs));
-            getGeneratedInstructions().push_back(
-                stringFormat("seqz t%d, t%d", new_var, new_var));
+            emit("slt") << ' ' << dest << ", " << lhs << ", " << rhs << '\n';
+            emit("seqz") << ' ' << dest << ", " << dest << '\n';
             break;
         
         case KOOPA_RBO_AND:
-            getGeneratedInstructions().push_back(
-                stringFormat("and t%d, %s, %s", new_var, lhs, rhs));
+            emit("and") << ' ' << dest << ", " << lhs << ", " << rhs << '\n';
             break;
 
         case KOOPA_RBO_OR:
-            getGeneratedInstructions().push_back(
-                stringFormat("or t%d, %s, %s", new_var, lhs, rhs));
+            emit("or") << ' ' << dest << ", " << lhs << ", " << rhs << '\n';
             break;
 
         default:
-            assert(false); // 未处理的操作符
+            // 未处理的操作符
+            throw std::runtime_error(
+                stringFormat("unsupported Koopa binary operator %d", static_cast<int>(binary.op)));
         }
-        return { stringFormat("t%d", new_var) };
+        return dest;
     }
 };
 
@@ -770,12 +846,49 @@ std::string KoopaParser::compileToAssembly(const std::string& input)
     auto raw_program = pImpl->parseToRawProgram(input);
     assert(raw_program != nullptr);
 
-    auto commands = pImpl->Visit(*raw_program);
+    return compileToAssembly(*raw_program);
+}
 
-    std::string assembly;
-    for (const auto& command : commands) {
-        assembly += command + "\n";
-    }
+void KoopaParser::setTimeReport(TimeReport* report)
+{
+    pImpl->setTimeReport(report);
+}
+
+void KoopaParser::setCollectStats(bool collect)
+{
+    pImpl->setCollectStats(collect);
+}
+
+std::vector<FunctionStats> KoopaParser::takeStats()
+{
+    return pImpl->takeStats();
+}
+
+std::string KoopaParser::compileToAssembly(const koopa_raw_program_t& raw_program)
+{
+    OutputBuffer out;
+    compileToAssembly(raw_program, out);
+    return out.take();
+}
 
-    return assembly;
+void KoopaParser::compileToAssembly(const koopa_raw_program_t& raw_program, OutputBuffer& out)
+{
+    pImpl->setOutput(out);
+    pImpl->Visit(raw_program);
+}
+
+std::string KoopaParser::compileHeaderToAssembly(const koopa_raw_program_t& raw_program)
+{
+    OutputBuffer out;
+    pImpl->setOutput(out);
+    pImpl->VisitHeader(raw_program);
+    return out.take();
+}
+
+std::string KoopaParser::compileFunctionsToAssembly(const koopa_raw_program_t& raw_program)
+{
+    OutputBuffer out;
+    pImpl->setOutput(out);
+    pImpl->VisitFunctions(raw_program);
+    return out.take();
 }
@@ -2,9 +2,14 @@
 
 #include <string>
 #include <memory>
+#include <vector>
 
+#include "codegen_stats.h"
 #include "koopa.h"
 
+class OutputBuffer;
+class TimeReport;
+
 // Forward declarations
 // struct koopa_raw_program_t;
 
@@ -21,8 +26,27 @@ public:
     KoopaParser(KoopaParser&&) = default;
     KoopaParser& operator=(KoopaParser&&) = default;
     
+    // 解析 Koopa 文本，无法解析时抛出 std::runtime_error
     const koopa_raw_program_t* parseToRawProgram(const std::string& input);
+    // 解析 Koopa 文本并生成汇编
     std::string compileToAssembly(const std::string& input);
+    // 直接从内存中的 Koopa IR（如 KoopaBuilder 构造的程序）生成汇编
+    // 每次调用都从干净的状态开始，同一个 KoopaParser 可以依次处理多个程序
+    std::string compileToAssembly(const koopa_raw_program_t& raw_program);
+    // 把汇编直接写入 out，不在内存中保留完整的输出
+    void compileToAssembly(const koopa_raw_program_t& raw_program, OutputBuffer& out);
+    // compileToAssembly() 的两个部分：程序开头的段和全局符号声明、所有函数的代码
+    // 每个函数的代码只取决于函数本身，可以分别生成后按原来的顺序拼接
+    std::string compileHeaderToAssembly(const koopa_raw_program_t& raw_program);
+    std::string compileFunctionsToAssembly(const koopa_raw_program_t& raw_program);
+
+    // 记录解析 Koopa 文本和逐个函数生成汇编的耗时，nullptr 表示不计时
+    void setTimeReport(TimeReport* report);
+
+    // 开始或停止记录每个函数生成的代码的统计，并丢弃尚未取走的统计
+    void setCollectStats(bool collect);
+    // 取走自上次调用以来生成的每个函数的统计
+    std::vector<FunctionStats> takeStats();
 
 private:
     class Impl;
@@ -1,79 +1,587 @@
-#include <cassert>
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
 #include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <iterator>
 #include <memory>
 #include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
 
 #include "ast.h"
-#include "koopa_parser.h"
-#include "symbol_table.h"
+#include "codegen_stats.h"
+#include "compile_cache.h"
+#include "compile_server.h"
+#include "compiler_context.h"
+#include "file_watcher.h"
+#include "memory_report.h"
+#include "output_buffer.h"
+#include "string_format.h"
+#include "thread_pool.h"
+#include "time_report.h"
 
 using namespace std;
 
-// 声明 lexer 的输入, 以及 parser 函数
-// 为什么不引用 sysy.tab.hpp 呢? 因为首先里面没有 yyin 的定义
-// 其次, 因为这个文件不是我们自己写的, 而是被 Bison 生成出来的
-// 你的代码编辑器/IDE 很可能找不到这个文件, 然后会给你报错 (虽然编译不会出错)
-// 看起来会很烦人, 于是干脆采用这种看起来 dirty 但实际很有效的手段
-extern FILE* yyin;
-extern int yyparse(unique_ptr<BaseAST>& ast);
+namespace {
+
+// 批量编译中的一项
+struct BatchJob {
+    string input;
+    string output;
+};
+
+bool writeFile(const char* path, const string& content)
+{
+    FILE* out = fopen(path, "wb");
+    if (out == nullptr) {
+        return false;
+    }
+    const bool ok = fwrite(content.data(), 1, content.size(), out) == content.size();
+    return fclose(out) == 0 && ok;
+}
+
+// 删除出错时写了一半的输出文件；输出是设备或管道（如 /dev/stdout）时不删除
+void removePartialOutput(const char* path)
+{
+    error_code ec;
+    if (filesystem::is_regular_file(path, ec)) {
+        filesystem::remove(path, ec);
+    }
+}
+
+bool readFile(const char* path, string& content)
+{
+    ifstream file(path, ios::binary);
+    if (!file) {
+        return false;
+    }
+    content.assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+    return !file.bad();
+}
+
+// 把 "input:output" 拆成一项，按最后一个冒号拆分
+bool parseJob(const string& spec, BatchJob& job)
+{
+    const auto colon = spec.rfind(':');
+    if (colon == string::npos || colon == 0 || colon + 1 == spec.size()) {
+        return false;
+    }
+    job.input = spec.substr(0, colon);
+    job.output = spec.substr(colon + 1);
+    return true;
+}
+
+// 读取清单文件：每行一个 "input:output"，忽略空行和以 # 开头的行
+bool readManifest(const string& path, vector<BatchJob>& jobs)
+{
+    ifstream manifest(path);
+    if (!manifest) {
+        cerr << "Cannot open manifest: " << path << endl;
+        return false;
+    }
+
+    string line;
+    int line_number = 0;
+    while (getline(manifest, line)) {
+        ++line_number;
+        const auto begin = line.find_first_not_of(" \t\r");
+        if (begin == string::npos || line[begin] == '#') {
+            continue;
+        }
+        const auto end = line.find_last_not_of(" \t\r");
+        BatchJob job;
+        if (!parseJob(line.substr(begin, end - begin + 1), job)) {
+            cerr << path << ":" << line_number << ": expected input:output" << endl;
+            return false;
+        }
+        jobs.push_back(move(job));
+    }
+    return true;
+}
+
+// 解析 -jN 中的线程数，只接受 1 到 MAX_THREADS 之间的十进制数
+constexpr unsigned MAX_THREADS = 256;
+
+bool parseThreadCount(const string& option, unsigned& thread_count)
+{
+    if (option.rfind("-j", 0) != 0) {
+        return false;
+    }
+    const auto first = option.data() + 2;
+    const auto last = option.data() + option.size();
+    unsigned value = 0;
+    const auto [end, error] = from_chars(first, last, value);
+    if (error != errc() || end != last || value < 1 || value > MAX_THREADS) {
+        return false;
+    }
+    thread_count = value;
+    return true;
+}
+
+int printUsage()
+{
+    cerr << "usage: compiler (-koopa | -riscv | -koopa-image | -riscv-from-koopa) INPUT -o OUTPUT [options...]" << endl
+         << "       compiler MODE (-batch | -watch) (MANIFEST | INPUT:OUTPUT)... [options...]" << endl
+         << "       compiler -server SOCKET [-jN]" << endl
+         << "       compiler -cache-stats DIRECTORY" << endl;
+    return 1;
+}
+
+// 输出缓存目录中累计的统计
+int printCacheStats(const string& directory)
+{
+    const auto stats = CompileCache::readStats(directory);
+    if (!stats) {
+        cerr << "No compile cache at " << directory << endl;
+        return 1;
+    }
+    const auto lookups = stats->hits + stats->misses;
+    cout << "cache directory: " << directory << endl;
+    cout << "hits:            " << stats->hits << endl;
+    cout << "misses:          " << stats->misses << endl;
+    cout << "hit rate:        " << (lookups == 0 ? 0.0 : 100.0 * stats->hits / lookups) << "%" << endl;
+    cout << "size:            " << stats->bytes << " bytes" << endl;
+    return 0;
+}
+
+// 编译一个输入文件；from_koopa 时输入是 Koopa IR，只经过后端生成 RISC-V 汇编
+string compileInput(CompilerContext& context, const char* path, CompileMode mode, bool from_koopa)
+{
+    return from_koopa ? context.compileKoopaFile(path) : context.compileFile(path, mode);
+}
+
+// -ftime-report / -ftime-trace / -fmem-report / -stats 请求的报告
+struct Reports {
+    bool print_time = false;
+    string trace_path;
+    bool print_memory = false;
+    string memory_json_path;
+    string stats_path;
+    unique_ptr<TimeReport> time; // 内存报告中每个阶段的堆分配也来自这里
+    unique_ptr<MemoryReport> memory;
+    unique_ptr<CodegenStats> codegen;
+
+    bool requested() const
+    {
+        return print_time || !trace_path.empty() || print_memory || !memory_json_path.empty() || !stats_path.empty();
+    }
+
+    void create()
+    {
+        if (print_time || !trace_path.empty() || print_memory || !memory_json_path.empty()) {
+            time = make_unique<TimeReport>();
+        }
+        if (print_memory || !memory_json_path.empty()) {
+            memory = make_unique<MemoryReport>();
+        }
+        // 每个阶段的堆分配记在耗时报告的事件中，只在需要时统计
+        MemoryReport::enableHeapCounting(time != nullptr);
+        if (!stats_path.empty()) {
+            codegen = make_unique<CodegenStats>();
+        }
+    }
+
+    void attach(CompilerContext& context) const
+    {
+        context.setTimeReport(time.get());
+        context.setMemoryReport(memory.get());
+        context.setCollectCodegenStats(codegen != nullptr);
+    }
+
+    // 取走 context 最近一次编译的代码生成统计，编译成功时记在 unit 名下
+    void collect(CompilerContext& context, const string& unit, bool succeeded) const
+    {
+        if (codegen) {
+            auto functions = context.takeCodegenStats();
+            if (succeeded) {
+                codegen->add(unit, move(functions));
+            }
+        }
+    }
+
+    // 输出报告，返回 status 以便直接 return
+    int finish(int status) const
+    {
+        if (print_time) {
+            time->print(cerr);
+        }
+        if (!trace_path.empty() && !time->writeChromeTrace(trace_path)) {
+            cerr << "Cannot write trace file: " << trace_path << endl;
+            status = 1;
+        }
+        if (print_memory) {
+            memory->print(cerr, time.get());
+        }
+        if (!memory_json_path.empty() && !memory->writeJson(memory_json_path, time.get())) {
+            cerr << "Cannot write memory report: " << memory_json_path << endl;
+            status = 1;
+        }
+        if (codegen && !codegen->writeJson(stats_path)) {
+            cerr << "Cannot write stats file: " << stats_path << endl;
+            status = 1;
+        }
+        return status;
+    }
+};
+
+// 在同一个进程中用线程池编译所有文件
+// 每个工作线程有自己的 CompilerContext，Arena、驻留表和后端在该线程编译的文件之间复用；
+// 大文件排在前面先编译，缩短整体完成时间。某个文件失败时只报告错误，继续编译其余的文件。
+// 每个文件的输出与调度无关，结果按输入的顺序报告。
+int runBatch(const vector<BatchJob>& jobs, CompileMode mode, bool from_koopa, LexerKind lexer_kind,
+             unsigned thread_count, CompileCache* cache, const Reports& reports)
+{
+    vector<uintmax_t> sizes(jobs.size());
+    vector<size_t> order(jobs.size());
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        error_code ec;
+        sizes[i] = filesystem::file_size(jobs[i].input, ec);
+        if (ec) {
+            sizes[i] = 0;
+        }
+        order[i] = i;
+    }
+    stable_sort(order.begin(), order.end(), [&](size_t lhs, size_t rhs) { return sizes[lhs] > sizes[rhs]; });
+
+    ThreadPool pool(thread_count);
+    vector<unique_ptr<CompilerContext>> contexts(pool.threadCount());
+    vector<string> errors(jobs.size()); // 空字符串表示成功
+    pool.run(order, [&](unsigned worker, size_t index) {
+        auto& context = contexts[worker];
+        if (!context) {
+            context = make_unique<CompilerContext>(lexer_kind);
+            context->setCache(cache);
+            reports.attach(*context);
+        }
+        const auto& job = jobs[index];
+        try {
+            const auto code = compileInput(*context, job.input.c_str(), mode, from_koopa);
+            reports.collect(*context, job.input, true);
+            const TimeReport::Scope scope(reports.time.get(), "write");
+            if (!writeFile(job.output.c_str(), code)) {
+                throw runtime_error("cannot write output file '" + job.output + "'");
+            }
+        } catch (const exception& e) {
+            errors[index] = e.what();
+            reports.collect(*context, job.input, false);
+        }
+    });
+
+    size_t failed = 0;
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        if (errors[i].empty()) {
+            cout << "ok    " << jobs[i].input << " -> " << jobs[i].output << endl;
+        } else {
+            ++failed;
+            cout << "FAIL  " << jobs[i].input << ": " << errors[i] << endl;
+        }
+    }
+    cout << jobs.size() << " files, " << jobs.size() - failed << " succeeded, " << failed << " failed" << endl;
+    if (cache != nullptr) {
+        cout << "cache: " << cache->hits() << " hits, " << cache->misses() << " misses" << endl;
+    }
+    return failed == 0 ? 0 : 1;
+}
+
+// 监视所有输入文件，每次修改后重新编译到对应的输出文件，直到进程被终止
+// 整个过程只用一个 CompilerContext，Arena、驻留表、后端和缓存在多次编译之间一直保持热的状态，
+// 配合 -cache 时没有改动的函数直接使用缓存中的代码。每次编译报告从收到修改到写完输出的延迟。
+int runWatch(const vector<BatchJob>& jobs, CompileMode mode, bool from_koopa, LexerKind lexer_kind,
+             CompileCache* cache)
+{
+    FileWatcher watcher;
+    for (const auto& job : jobs) {
+        watcher.add(job.input);
+    }
+
+    // 每次修改通常只改动一部分函数，按函数缓存
+    CompilerContext context(lexer_kind);
+    context.setCache(cache, CacheLayer::FUNCTION);
+    const auto recompile = [&](const BatchJob& job, chrono::steady_clock::time_point start) {
+        try {
+            const auto code = compileInput(context, job.input.c_str(), mode, from_koopa);
+            if (!writeFile(job.output.c_str(), code)) {
+                throw runtime_error("cannot write output file '" + job.output + "'");
+            }
+            const chrono::duration<double, milli> latency = chrono::steady_clock::now() - start;
+            cout << "ok    " << job.input << " -> " << job.output << stringFormat(" (%.2f ms)", latency.count()) << endl;
+        } catch (const exception& e) {
+            cout << "FAIL  " << job.input << ": " << e.what() << endl;
+        }
+    };
+
+    // 先完整编译一遍，之后只重新编译修改过的文件
+    for (const auto& job : jobs) {
+        recompile(job, chrono::steady_clock::now());
+    }
+    cout << "Watching " << jobs.size() << " files" << endl;
+    while (true) {
+        const auto changed = watcher.wait();
+        const auto start = chrono::steady_clock::now();
+        for (const auto index : changed) {
+            recompile(jobs[index], start);
+        }
+    }
+}
+
+} // namespace
 
 int main(int argc, const char* argv[])
 {
     // 解析命令行参数. 测试脚本/评测平台要求你的编译器能接收如下参数:
-    // compiler 模式 输入文件 -o 输出文件
-    assert(argc == 5);
+    // compiler 模式 输入文件 -o 输出文件 [选项...]
+    // 模式为 -koopa、-riscv、-koopa-image (Koopa IR 的二进制映像),
+    // 或者 -riscv-from-koopa (输入是 Koopa IR 文本或映像, 只运行后端)
+    // 批量编译时使用:
+    // compiler 模式 -batch (清单文件 | 输入文件:输出文件)... [选项...]
+    // 监视输入文件, 修改后自动重新编译:
+    // compiler 模式 -watch (清单文件 | 输入文件:输出文件)... [选项...]
+    // 启动常驻的编译服务器:
+    // compiler -server 套接字路径 [-jN]
+    // 查看编译缓存的统计:
+    // compiler -cache-stats 缓存目录
+    if (argc < 3) {
+        return printUsage();
+    }
     auto mode = argv[1];
-    auto input = argv[2];
-    auto output = argv[4];
-
-    // 初始化全局符号表
-    SymbolTable global_symbol_table;
-    BaseAST::global_symbol_table = &global_symbol_table;
-
-    // 打开输入文件, 并且指定 lexer 在解析的时候读取这个文件
-    yyin = fopen(input, "r");
-    assert(yyin);
-
-    // 调用 parser 函数, parser 函数会进一步调用 lexer 解析输入文件的
-    unique_ptr<BaseAST> ast;
-    auto ret = yyparse(ast);
-    assert(!ret);
-
-    // 输出解析得到的 AST, 其实就是个字符串
-    //   cout << *ast << endl;
-    // dump AST
-    ast->Dump();
-    cout << endl;
-    
-    auto koopa_code = ast->toKoopa();
-    cout << koopa_code;
-    cout << endl;
+    if (string(mode) == "-cache-stats") {
+        return printCacheStats(argv[2]);
+    }
+    if (string(mode) == "-server") {
+        unsigned thread_count = 0;
+        for (int i = 3; i < argc; ++i) {
+            auto option = string(argv[i]);
+            if (!parseThreadCount(option, thread_count)) {
+                cerr << "Unknown option: " << option << endl;
+                return printUsage();
+            }
+        }
+        return runCompileServer(argv[2], thread_count);
+    }
+    const bool batch = string(argv[2]) == "-batch";
+    const bool watch = string(argv[2]) == "-watch";
+    if (!batch && !watch && (argc < 5 || string(argv[3]) != "-o")) {
+        return printUsage();
+    }
 
-    // 写入输出文件
-    FILE* out = fopen(output, "w");
-    assert(out);
-    
-    assert(!koopa_code.empty());
+    // 额外的选项:
+    //   -lexer=flex|mmap  选择词法分析器 (默认 flex), 便于对比两者的性能
+    //   -jN               批量编译使用的线程数 (默认为机器的硬件线程数)
+    //   -cache=DIR        使用 DIR 中的编译缓存, 也可以通过环境变量 SYSY_COMPILER_CACHE 设置
+    //   -cache-size=MB    缓存大小的上限 (默认 256), 也可以通过环境变量 SYSY_COMPILER_CACHE_SIZE 设置
+    //   -v                在标准输出上打印 AST 和目标代码, 便于调试
+    //   -ftime-report     在标准错误上输出各阶段和各函数的耗时 (墙上时间和 CPU 时间)
+    //   -ftime-trace=FILE 把各阶段的耗时写成 Chrome trace event 格式的 JSON
+    //   -fmem-report      在标准错误上输出各阶段的堆分配、各类 AST 节点和 IR 对象占用的内存以及峰值 RSS
+    //   -fmem-report-json=FILE  同上, 写成 JSON
+    //   -stats=FILE       把每个函数生成的代码的统计 (指令数、栈帧大小、溢出到栈上的值等) 写成 JSON, 只用于 RISC-V
+    string lexer_kind = "flex";
+    bool verbose = false;
+    Reports reports;
+    unsigned thread_count = 0;
+    bool threads_given = false;
+    const char* cache_env = getenv("SYSY_COMPILER_CACHE");
+    string cache_dir = cache_env != nullptr ? cache_env : "";
+    const char* cache_size_env = getenv("SYSY_COMPILER_CACHE_SIZE");
+    string cache_size = cache_size_env != nullptr ? cache_size_env : "";
+    vector<BatchJob> jobs;
+    for (int i = batch || watch ? 3 : 5; i < argc; ++i) {
+        auto option = string(argv[i]);
+        if (option.rfind("-lexer=", 0) == 0) {
+            lexer_kind = option.substr(7);
+        } else if (parseThreadCount(option, thread_count)) {
+            threads_given = true;
+        } else if (option.rfind("-cache=", 0) == 0) {
+            cache_dir = option.substr(7);
+        } else if (option.rfind("-cache-size=", 0) == 0) {
+            cache_size = option.substr(12);
+        } else if (option == "-v") {
+            verbose = true;
+        } else if (option == "-ftime-report") {
+            reports.print_time = true;
+        } else if (option.rfind("-ftime-trace=", 0) == 0 && option.size() > 13) {
+            reports.trace_path = option.substr(13);
+        } else if (option == "-fmem-report") {
+            reports.print_memory = true;
+        } else if (option.rfind("-fmem-report-json=", 0) == 0 && option.size() > 18) {
+            reports.memory_json_path = option.substr(18);
+        } else if (option.rfind("-stats=", 0) == 0 && option.size() > 7) {
+            reports.stats_path = option.substr(7);
+        } else if ((batch || watch) && option[0] != '-') {
+            // 含有冒号的参数是一对输入输出文件, 否则是清单文件
+            BatchJob job;
+            if (option.find(':') != string::npos && parseJob(option, job)) {
+                jobs.push_back(move(job));
+            } else if (!readManifest(option, jobs)) {
+                return 1;
+            }
+        } else {
+            cerr << "Unknown option: " << option << endl;
+            return printUsage();
+        }
+    }
+    if (lexer_kind != "flex" && lexer_kind != "mmap") {
+        cerr << "Unknown lexer: " << lexer_kind << endl;
+        return 1;
+    }
+    // 监视模式不会结束, 没有输出报告的时机; 修改一个文件只重新编译这个文件, 只用一个线程
+    if (watch && (reports.requested() || threads_given)) {
+        cerr << "-watch does not support -jN, -ftime-report, -ftime-trace, -fmem-report or -stats" << endl;
+        return 1;
+    }
+    if (!cache_size.empty() && (cache_size.find_first_not_of("0123456789") != string::npos || cache_size.size() > 9)) {
+        cerr << "Invalid cache size: " << cache_size << endl;
+        return 1;
+    }
+    unique_ptr<CompileCache> cache;
+    if (!cache_dir.empty()) {
+        const auto max_size = cache_size.empty() ? CompileCache::DEFAULT_MAX_SIZE : stoull(cache_size) << 20;
+        cache = make_unique<CompileCache>(cache_dir, max_size);
+    }
 
     auto mode_str = string(mode);
-    cout << "Mode: " << mode_str << endl;
+    CompileMode compile_mode;
+    const bool from_koopa = mode_str == "-riscv-from-koopa";
     if (mode_str == "-koopa") {
-        fprintf(out, "%s", koopa_code.c_str());
-    } else if (mode_str == "-riscv") {
-        auto koopa_parser = make_unique<KoopaParser>();
-        // const auto* raw_program = koopa_parser->parseToRawProgram(koopa_code);
-        // assert(raw_program);
-        auto assembly = koopa_parser->compileToAssembly(koopa_code);
-
-        cout << assembly << endl;
-        fprintf(out, "%s", assembly.c_str());
+        compile_mode = CompileMode::KOOPA;
+    } else if (mode_str == "-riscv" || from_koopa) {
+        compile_mode = CompileMode::RISCV;
+    } else if (mode_str == "-koopa-image") {
+        compile_mode = CompileMode::KOOPA_IMAGE;
     } else {
         cerr << "Unknown mode: " << mode_str << endl;
-        fclose(out);
         return 1;
     }
-    fclose(out);
+    const auto compile_lexer = lexer_kind == "mmap" ? LexerKind::MMAP : LexerKind::FLEX;
+    if (!reports.stats_path.empty()) {
+        if (compile_mode != CompileMode::RISCV) {
+            cerr << "-stats requires -riscv or -riscv-from-koopa" << endl;
+            return 1;
+        }
+        // 命中缓存时不生成代码, 也就没有统计
+        cache.reset();
+    }
+    reports.create();
 
-    return 0;
-}
\ No newline at end of file
+    if (batch) {
+        const auto status = runBatch(jobs, compile_mode, from_koopa, compile_lexer, thread_count, cache.get(), reports);
+        return reports.finish(status);
+    }
+    if (watch) {
+        try {
+            return runWatch(jobs, compile_mode, from_koopa, compile_lexer, cache.get());
+        } catch (const exception& e) {
+            cerr << "error: " << e.what() << endl;
+            return 1;
+        }
+    }
+
+    auto input = argv[2];
+    auto output = argv[4];
+
+    // 设置了 SYSY_COMPILER_SERVER 时把编译请求交给常驻的服务器, 连接不上时在本进程内编译
+    // 服务器只接受 SysY 源代码, 请求中只有模式和词法分析器; 使用缓存、-v (需要输出 AST)、
+    // 计时、内存报告或统计时在本进程内编译, 这些选项不会被悄悄忽略
+    const char* server = getenv(COMPILE_SERVER_ENV);
+    const bool use_server = server != nullptr && *server != '\0' && !from_koopa && !cache && !verbose && !reports.time
+        && !reports.memory && !reports.codegen;
+    string source;
+    if (use_server && readFile(input, source)) {
+        if (auto reply = requestCompile(server, source, compile_mode, compile_lexer)) {
+            if (!reply->ok) {
+                cerr << "error: " << reply->output << endl;
+                return 1;
+            }
+            if (!writeFile(output, reply->output)) {
+                cerr << "Cannot write output file: " << output << endl;
+                return 1;
+            }
+            return 0;
+        }
+    }
+
+    // 编译所需的全部状态 (驻留表、AST、符号表、IR) 都由 context 持有
+    CompilerContext context(compile_lexer);
+    reports.attach(context);
+    string code;
+    try {
+        if (!verbose && !cache && !from_koopa) {
+            // 默认的路径: 解析成功后打开输出文件, 目标代码边生成边写入, 不在内存中保留完整的输出
+            // 生成或写入失败时删除输出文件, 不留下不完整的结果
+            context.parseFile(input);
+            FILE* file = fopen(output, "wb");
+            if (file == nullptr) {
+                cerr << "Cannot write output file: " << output << endl;
+                return 1;
+            }
+            bool ok;
+            try {
+                OutputBuffer out(file);
+                context.generate(compile_mode, out);
+                reports.collect(context, input, true);
+                const TimeReport::Scope scope(reports.time.get(), "write");
+                ok = out.flush();
+            } catch (...) {
+                fclose(file);
+                removePartialOutput(output);
+                throw;
+            }
+            if (fclose(file) != 0 || !ok) {
+                removePartialOutput(output);
+                cerr << "Cannot write output file: " << output << endl;
+                return reports.finish(1);
+            }
+            return reports.finish(0);
+        }
+
+        if (cache || from_koopa) {
+            // 使用缓存时命中就不再解析, 只运行后端时没有 AST, 这两种情况都不输出 AST
+            context.setCache(cache.get());
+            code = compileInput(context, input, compile_mode, from_koopa);
+        } else {
+            // 解析输入文件并完成名字解析
+            auto& ast = context.parseFile(input);
+
+            // 输出解析得到的 AST, 其实就是个字符串
+            //   cout << *ast << endl;
+            // dump AST
+            if (verbose) {
+                ast.Dump();
+                cout << endl;
+            }
+
+            code = context.generate(compile_mode);
+        }
+    } catch (const exception& e) {
+        cerr << "error: " << e.what() << endl;
+        return reports.finish(1);
+    }
+    reports.collect(context, input, true);
+
+    // 写入输出文件
+    if (verbose) {
+        cout << "Mode: " << mode_str << endl;
+        // 二进制映像不输出到终端
+        if (compile_mode != CompileMode::KOOPA_IMAGE) {
+            cout << code << endl;
+        }
+    }
+    bool written;
+    {
+        const TimeReport::Scope scope(reports.time.get(), "write");
+        written = writeFile(output, code);
+    }
+    if (!written) {
+        cerr << "Cannot write output file: " << output << endl;
+        return reports.finish(1);
+    }
+
+    return reports.finish(0);
+}
@@ -0,0 +1,145 @@
+#include "memory_report.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include <cxxabi.h>
+#include <sys/resource.h>
+
+#include "string_format.h"
+#include "time_report.h"
+
+namespace {
+
+// 本线程的堆分配，只有链接了 heap_counter.cpp 并开启统计的程序才会累加
+thread_local MemoryReport::Counter thread_heap;
+
+std::string demangle(const char* name)
+{
+    int status = 0;
+    char* demangled = abi::__cxa_demangle(name, nullptr, nullptr, &status);
+    if (status != 0 || demangled == nullptr) {
+        return name;
+    }
+    std::string result = demangled;
+    std::free(demangled);
+    return result;
+}
+
+// 按字节数从大到小排序，字节数最多的种类排在前面
+std::vector<std::pair<std::string, MemoryReport::Counter>> sortByBytes(const std::map<std::string, MemoryReport::Counter>& totals)
+{
+    std::vector<std::pair<std::string, MemoryReport::Counter>> result(totals.begin(), totals.end());
+    std::stable_sort(result.begin(), result.end(),
+                     [](const auto& lhs, const auto& rhs) { return lhs.second.bytes > rhs.second.bytes; });
+    return result;
+}
+
+} // namespace
+
+void MemoryReport::recordHeapAllocation(std::size_t bytes) noexcept
+{
+    ++thread_heap.count;
+    thread_heap.bytes += bytes;
+}
+
+MemoryReport::Counter MemoryReport::threadHeap() noexcept
+{
+    return thread_heap;
+}
+
+std::uint64_t MemoryReport::peakRss()
+{
+    rusage usage {};
+    if (::getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+    return static_cast<std::uint64_t>(usage.ru_maxrss) * 1024; // Linux 上单位为 KiB
+}
+
+void MemoryReport::mergeInto(std::map<std::string, Counter>& totals, ObjectCounts& counts, bool demangle_names)
+{
+    for (const auto& [kind, counter] : counts.counters_) {
+        auto& total = totals[demangle_names ? demangle(kind) : std::string(kind)];
+        total.count += counter.first;
+        total.bytes += counter.second;
+    }
+    counts.clear();
+}
+
+void MemoryReport::merge(ObjectCounts& ast, ObjectCounts& ir)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    // AST 的种类名是 type_info::name()，IR 的种类名是字符串字面量
+    mergeInto(ast_, ast, true);
+    mergeInto(ir_, ir, false);
+}
+
+void MemoryReport::print(std::ostream& out, const TimeReport* phases) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto row = [&](const std::string& name, const Counter& counter) {
+        out << stringFormat("  %-28s %12llu %14llu\n", name, static_cast<unsigned long long>(counter.count),
+                            static_cast<unsigned long long>(counter.bytes));
+    };
+
+    out << stringFormat("Memory report (peak RSS %.1f MiB)\n", peakRss() / 1048576.0);
+    if (phases != nullptr) {
+        out << stringFormat("  %-28s %12s %14s\n", "phase", "allocations", "heap bytes");
+        for (const auto& phase : phases->phaseTotals()) {
+            row(std::string(phase.depth * 2, ' ') + phase.name, { phase.allocations, phase.allocated });
+        }
+    }
+    const auto table = [&](const char* title, const std::map<std::string, Counter>& totals) {
+        if (totals.empty()) {
+            return;
+        }
+        Counter sum;
+        out << stringFormat("  %-28s %12s %14s\n", title, "objects", "bytes");
+        for (const auto& [name, counter] : sortByBytes(totals)) {
+            row(name, counter);
+            sum.count += counter.count;
+            sum.bytes += counter.bytes;
+        }
+        row("total", sum);
+    };
+    table("AST node", ast_);
+    table("IR object", ir_);
+}
+
+bool MemoryReport::writeJson(const std::string& path, const TimeReport* phases) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    FILE* file = std::fopen(path.c_str(), "w");
+    if (file == nullptr) {
+        return false;
+    }
+
+    // 名字都是阶段名、C++ 类名和 IR 种类名，不含需要转义的字符
+    std::fprintf(file, "{\"peak_rss_bytes\":%llu,\n\"phases\":[", static_cast<unsigned long long>(peakRss()));
+    if (phases != nullptr) {
+        bool first = true;
+        for (const auto& phase : phases->phaseTotals()) {
+            std::fprintf(file, "%s\n{\"name\":\"%s\",\"depth\":%u,\"count\":%llu,\"allocations\":%llu,\"bytes\":%llu}",
+                         first ? "" : ",", phase.name.c_str(), phase.depth, static_cast<unsigned long long>(phase.count),
+                         static_cast<unsigned long long>(phase.allocations),
+                         static_cast<unsigned long long>(phase.allocated));
+            first = false;
+        }
+    }
+    const auto table = [&](const char* key, const std::map<std::string, Counter>& totals) {
+        std::fprintf(file, "],\n\"%s\":[", key);
+        bool first = true;
+        for (const auto& [name, counter] : sortByBytes(totals)) {
+            std::fprintf(file, "%s\n{\"kind\":\"%s\",\"count\":%llu,\"bytes\":%llu}", first ? "" : ",", name.c_str(),
+                         static_cast<unsigned long long>(counter.count), static_cast<unsigned long long>(counter.bytes));
+            first = false;
+        }
+    };
+    table("ast", ast_);
+    table("ir", ir_);
+    std::fputs("]}\n", file);
+    return std::fclose(file) == 0;
+}
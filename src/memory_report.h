@@ -0,0 +1,79 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+class TimeReport;
+
+// 一个 CompilerContext 分配的对象，按种类统计个数和字节数，只在一个线程中使用，不加锁
+// 种类名必须是静态的字符串（字符串字面量或 type_info::name()），按指针区分
+class ObjectCounts {
+public:
+    void add(const char* kind, std::size_t bytes)
+    {
+        auto& counter = counters_[kind];
+        ++counter.first;
+        counter.second += bytes;
+    }
+
+    bool empty() const { return counters_.empty(); }
+    void clear() { counters_.clear(); }
+
+private:
+    friend class MemoryReport;
+    std::unordered_map<const char*, std::pair<std::uint64_t, std::uint64_t>> counters_; // 个数，字节数
+};
+
+// 编译占用的内存
+// 三部分数据：
+// - 每个阶段的堆分配次数和字节数：由 TimeReport::Scope 在阶段开始和结束时读取本线程的堆计数器得到，
+//   计数器由替换的全局 operator new 调用 recordHeapAllocation() 累加（见 heap_counter.cpp，
+//   只有链接了它并调用 enableHeapCounting(true) 的程序才有这部分数据）；
+// - 按 AST 节点类型（AddExpAST、BlockItemAST 等）和 IR 对象种类（load、binary、basic block 等）
+//   统计的对象个数和字节数：Arena 和 KoopaBuilder 分配对象时记录到 ObjectCounts 中，
+//   每次编译结束后由 CompilerContext 并入报告；
+// - 进程的峰值 RSS。
+// 报告可以输出为表格，也可以输出为 JSON 便于跟踪趋势。
+class MemoryReport {
+public:
+    struct Counter {
+        std::uint64_t count = 0;
+        std::uint64_t bytes = 0;
+    };
+
+    // 开始或停止统计堆分配，默认不统计
+    static void enableHeapCounting(bool enabled) noexcept { heap_counting_.store(enabled, std::memory_order_relaxed); }
+    static bool heapCountingEnabled() noexcept { return heap_counting_.load(std::memory_order_relaxed); }
+    // 由 operator new 调用，累加本线程的堆分配次数和字节数
+    static void recordHeapAllocation(std::size_t bytes) noexcept;
+    // 本线程到目前为止的堆分配
+    static Counter threadHeap() noexcept;
+
+    // 把一次编译的对象统计并入报告，并清空 ast 和 ir；多个线程可以同时调用
+    void merge(ObjectCounts& ast, ObjectCounts& ir);
+
+    // 阶段的数据取自 phases，phases 为 nullptr 时只输出对象统计和峰值 RSS
+    void print(std::ostream& out, const TimeReport* phases) const;
+    // 同上，输出为 JSON，无法写入时返回 false
+    bool writeJson(const std::string& path, const TimeReport* phases) const;
+
+    // 进程的峰值 RSS，单位为字节
+    static std::uint64_t peakRss();
+
+private:
+    // 把 ObjectCounts 中的种类名转换为可读的名字后累加
+    static void mergeInto(std::map<std::string, Counter>& totals, ObjectCounts& counts, bool demangle);
+
+    static inline std::atomic<bool> heap_counting_ { false };
+
+    mutable std::mutex mutex_; // 保护以下状态
+    std::map<std::string, Counter> ast_;
+    std::map<std::string, Counter> ir_;
+};
@@ -0,0 +1,346 @@
+#include "mmap_lexer.h"
+
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// 需要 Bison 生成的 token 定义
+#include "sysy.tab.hpp"
+
+namespace {
+
+inline bool isWhitespace(char ch)
+{
+    return ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r';
+}
+
+inline bool isIdentStart(char ch)
+{
+    return (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') || ch == '_';
+}
+
+inline bool isIdentChar(char ch)
+{
+    return isIdentStart(ch) || (ch >= '0' && ch <= '9');
+}
+
+// 跳过连续的空白字符，返回第一个非空白字符的位置
+const char* skipWhitespace(const char* ptr, const char* end)
+{
+#if defined(__SSE2__)
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i carriage = _mm_set1_epi8('\r');
+    while (end - ptr >= 16) {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr));
+        const __m128i is_space = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, space), _mm_cmpeq_epi8(chunk, tab)),
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, newline), _mm_cmpeq_epi8(chunk, carriage)));
+        const auto mask = static_cast<unsigned>(_mm_movemask_epi8(is_space));
+        if (mask != 0xFFFF) {
+            return ptr + __builtin_ctz(~mask);
+        }
+        ptr += 16;
+    }
+#endif
+    while (ptr < end && isWhitespace(*ptr)) {
+        ++ptr;
+    }
+    return ptr;
+}
+
+// 查找字符 target 第一次出现的位置，找不到时返回 end
+const char* findChar(const char* ptr, const char* end, char target)
+{
+#if defined(__SSE2__)
+    const __m128i needle = _mm_set1_epi8(target);
+    while (end - ptr >= 16) {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr));
+        const auto mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle)));
+        if (mask != 0) {
+            return ptr + __builtin_ctz(mask);
+        }
+        ptr += 16;
+    }
+#endif
+    while (ptr < end && *ptr != target) {
+        ++ptr;
+    }
+    return ptr;
+}
+
+// 关键字的完美哈希：(长度 * 2 + 首字符 + 尾字符 * 3) mod 16 对 8 个关键字互不冲突
+struct Keyword {
+    const char* text;
+    std::size_t length;
+    int token;
+};
+
+constexpr unsigned keywordHash(const char* text, std::size_t length)
+{
+    return (static_cast<unsigned>(length) * 2 + static_cast<unsigned char>(text[0])
+               + static_cast<unsigned char>(text[length - 1]) * 3)
+        & 15;
+}
+
+struct KeywordTable {
+    Keyword slots[16] {};
+
+    constexpr KeywordTable()
+    {
+        const Keyword keywords[] = {
+            { "int", 3, BTYPE },
+            { "return", 6, RETURN },
+            { "const", 5, CONST },
+            { "if", 2, IF },
+            { "else", 4, ELSE },
+            { "while", 5, WHILE },
+            { "break", 5, BREAK },
+            { "continue", 8, CONTINUE },
+        };
+        for (const auto& keyword : keywords) {
+            slots[keywordHash(keyword.text, keyword.length)] = keyword;
+        }
+    }
+};
+
+constexpr KeywordTable KEYWORDS;
+
+int lookupKeyword(const char* text, std::size_t length)
+{
+    const auto& slot = KEYWORDS.slots[keywordHash(text, length)];
+    if (slot.text != nullptr && slot.length == length && std::memcmp(slot.text, text, length) == 0) {
+        return slot.token;
+    }
+    return 0;
+}
+
+inline int hexDigit(char ch)
+{
+    if (ch >= '0' && ch <= '9') return ch - '0';
+    if (ch >= 'a' && ch <= 'f') return ch - 'a' + 10;
+    if (ch >= 'A' && ch <= 'F') return ch - 'A' + 10;
+    return -1;
+}
+
+} // namespace
+
+MmapLexer::MmapLexer(StringInterner& interner)
+    : interner_(interner)
+{
+}
+
+MmapLexer::~MmapLexer()
+{
+    close();
+}
+
+bool MmapLexer::open(const char* path)
+{
+    close();
+
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st {};
+    if (fstat(fd, &st) != 0) {
+        ::close(fd);
+        return false;
+    }
+
+    const auto size = static_cast<std::size_t>(st.st_size);
+    if (size == 0) {
+        // 空文件无法 mmap，直接当作空输入
+        ::close(fd);
+        openBuffer("", 0);
+        return true;
+    }
+
+    void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        return false;
+    }
+    madvise(mapping, size, MADV_SEQUENTIAL);
+
+    mapping_ = mapping;
+    mapping_size_ = size;
+    openBuffer(static_cast<const char*>(mapping), size);
+    return true;
+}
+
+void MmapLexer::openBuffer(const char* data, std::size_t size)
+{
+    cursor_ = data;
+    end_ = data + size;
+}
+
+void MmapLexer::close()
+{
+    if (mapping_ != nullptr) {
+        munmap(mapping_, mapping_size_);
+        mapping_ = nullptr;
+        mapping_size_ = 0;
+    }
+    cursor_ = end_ = nullptr;
+}
+
+void MmapLexer::skipWhitespaceAndComments()
+{
+    while (true) {
+        cursor_ = skipWhitespace(cursor_, end_);
+        if (end_ - cursor_ < 2 || cursor_[0] != '/') {
+            return;
+        }
+
+        if (cursor_[1] == '/') {
+            // 行注释，跳到行尾
+            cursor_ = findChar(cursor_ + 2, end_, '\n');
+        } else if (cursor_[1] == '*') {
+            // 块注释，查找下一个 "*/"
+            const char* ptr = cursor_ + 2;
+            while (true) {
+                ptr = findChar(ptr, end_, '*');
+                if (ptr >= end_ - 1) {
+                    ptr = end_;
+                    break;
+                }
+                if (ptr[1] == '/') {
+                    ptr += 2;
+                    break;
+                }
+                ++ptr;
+            }
+            cursor_ = ptr;
+        } else {
+            return;
+        }
+    }
+}
+
+int MmapLexer::lex(YYSTYPE& lval)
+{
+    skipWhitespaceAndComments();
+    if (cursor_ >= end_) {
+        return 0;
+    }
+
+    const char* start = cursor_;
+    const char ch = *cursor_;
+
+    // 标识符和关键字
+    if (isIdentStart(ch)) {
+        ++cursor_;
+        while (cursor_ < end_ && isIdentChar(*cursor_)) {
+            ++cursor_;
+        }
+        const auto length = static_cast<std::size_t>(cursor_ - start);
+        if (int keyword = lookupKeyword(start, length)) {
+            return keyword;
+        }
+        lval.ident_val = interner_.intern(std::string_view(start, length));
+        return IDENT;
+    }
+
+    // 整数字面量，与 sysy.l 中的 strtol(..., 0) 一致：超出 long 的范围时饱和为 LONG_MAX，再转换为 int
+    if (ch >= '0' && ch <= '9') {
+        constexpr auto LIMIT = static_cast<std::uint64_t>(std::numeric_limits<long>::max());
+        std::uint64_t value = 0;
+        const auto append = [&value](unsigned base, unsigned digit) {
+            value = value > (LIMIT - digit) / base ? LIMIT : value * base + digit;
+        };
+        if (ch == '0' && end_ - cursor_ > 2 && (cursor_[1] == 'x' || cursor_[1] == 'X') && hexDigit(cursor_[2]) >= 0) {
+            cursor_ += 2;
+            for (int digit; cursor_ < end_ && (digit = hexDigit(*cursor_)) >= 0; ++cursor_) {
+                append(16, static_cast<unsigned>(digit));
+            }
+        } else if (ch == '0') {
+            ++cursor_;
+            for (; cursor_ < end_ && *cursor_ >= '0' && *cursor_ <= '7'; ++cursor_) {
+                append(8, static_cast<unsigned>(*cursor_ - '0'));
+            }
+        } else {
+            for (; cursor_ < end_ && *cursor_ >= '0' && *cursor_ <= '9'; ++cursor_) {
+                append(10, static_cast<unsigned>(*cursor_ - '0'));
+            }
+        }
+        lval.int_val = static_cast<int>(static_cast<long>(value));
+        return INT_CONST;
+    }
+
+    ++cursor_;
+    const char next = cursor_ < end_ ? *cursor_ : '\0';
+    switch (ch) {
+    case '+':
+        lval.binary_op_val = BINARY_OP_ADD;
+        return ADD_OP;
+    case '-':
+        lval.binary_op_val = BINARY_OP_SUB;
+        return ADD_OP;
+    case '!':
+        if (next == '=') {
+            ++cursor_;
+            lval.binary_op_val = BINARY_OP_NE;
+            return EQ_OP;
+        }
+        return '!';
+    case '*':
+        lval.binary_op_val = BINARY_OP_MUL;
+        return MUL_OP;
+    case '/':
+        lval.binary_op_val = BINARY_OP_DIV;
+        return MUL_OP;
+    case '%':
+        lval.binary_op_val = BINARY_OP_MOD;
+        return MUL_OP;
+    case '<':
+        if (next == '=') {
+            ++cursor_;
+            lval.binary_op_val = BINARY_OP_LE;
+        } else {
+            lval.binary_op_val = BINARY_OP_LT;
+        }
+        return REL_OP;
+    case '>':
+        if (next == '=') {
+            ++cursor_;
+            lval.binary_op_val = BINARY_OP_GE;
+        } else {
+            lval.binary_op_val = BINARY_OP_GT;
+        }
+        return REL_OP;
+    case '=':
+        if (next == '=') {
+            ++cursor_;
+            lval.binary_op_val = BINARY_OP_EQ;
+            return EQ_OP;
+        }
+        return '=';
+    case '&':
+        if (next == '&') {
+            ++cursor_;
+            return LAND_OP;
+        }
+        return ch;
+    case '|':
+        if (next == '|') {
+            ++cursor_;
+            return LOR_OP;
+        }
+        return ch;
+    default:
+        // 括号、分号等单字符 token 直接返回字符本身
+        return static_cast<unsigned char>(ch);
+    }
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+
+#include "string_interner.h"
+
+union YYSTYPE;
+
+// 手写的 SysY 词法分析器，与 sysy.l 生成的 flex 扫描器产生完全相同的 token 流
+// （块注释可以跨行，在第一个 */ 处结束，没有结束时延续到输入末尾；整数字面量与 strtol 一样饱和；
+// 无法识别的字节按 unsigned char 返回，见 tests/sources/lexer）
+// 输入文件通过 mmap 映射进内存，空白和注释使用 SIMD 批量跳过，关键字使用完美哈希识别。
+class MmapLexer {
+public:
+    explicit MmapLexer(StringInterner& interner);
+    ~MmapLexer();
+
+    MmapLexer(const MmapLexer&) = delete;
+    MmapLexer& operator=(const MmapLexer&) = delete;
+
+    // 映射输入文件，失败时返回 false
+    bool open(const char* path);
+    // 直接扫描一段内存（不拷贝），调用方需保证其生命周期
+    void openBuffer(const char* data, std::size_t size);
+    void close();
+
+    // 返回下一个 token，并把 token 的值写入 lval；输入结束时返回 0
+    int lex(YYSTYPE& lval);
+
+private:
+    void skipWhitespaceAndComments();
+
+    StringInterner& interner_;
+    const char* cursor_ = nullptr;
+    const char* end_ = nullptr;
+    void* mapping_ = nullptr;
+    std::size_t mapping_size_ = 0;
+};
@@ -0,0 +1,24 @@
+#include "output_buffer.h"
+
+OutputBuffer::OutputBuffer(std::FILE* file)
+    : file_(file)
+{
+    buffer_.reserve(SPILL_SIZE * 2);
+}
+
+OutputBuffer::~OutputBuffer()
+{
+    flush();
+}
+
+bool OutputBuffer::flush()
+{
+    if (file_ != nullptr && !buffer_.empty()) {
+        if (std::fwrite(buffer_.data(), 1, buffer_.size(), file_) != buffer_.size()) {
+            failed_ = true;
+        }
+        // 保留已经申请的容量
+        buffer_.clear();
+    }
+    return !failed_;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <charconv>
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+// 代码生成使用的输出缓冲区
+// 助记符、寄存器名和整数直接追加到一块可增长的缓冲区中，整数用 std::to_chars 格式化，
+// 不为每条指令创建临时字符串。
+// 关联了文件时，缓冲区积累到一定大小就写入文件，输出边生成边写出，内存占用与输出大小无关；
+// 没有关联文件时输出全部留在内存中，用 take() 取出。
+class OutputBuffer {
+public:
+    OutputBuffer() = default;
+    // 流式写入 file，file 由调用方打开和关闭
+    explicit OutputBuffer(std::FILE* file);
+    // 把剩余的内容写入文件
+    ~OutputBuffer();
+
+    OutputBuffer(const OutputBuffer&) = delete;
+    OutputBuffer& operator=(const OutputBuffer&) = delete;
+
+    OutputBuffer& operator<<(std::string_view text)
+    {
+        buffer_.append(text.data(), text.size());
+        return spill();
+    }
+
+    OutputBuffer& operator<<(char ch)
+    {
+        buffer_.push_back(ch);
+        return spill();
+    }
+
+    template <typename T, std::enable_if_t<std::is_integral_v<T> && !std::is_same_v<T, char> && !std::is_same_v<T, bool>, int> = 0>
+    OutputBuffer& operator<<(T value)
+    {
+        char digits[24];
+        const auto result = std::to_chars(digits, digits + sizeof(digits), value);
+        buffer_.append(digits, result.ptr);
+        return spill();
+    }
+
+    // 把缓冲区中的内容写入文件，返回到目前为止是否全部写入成功
+    bool flush();
+
+    // 取出内存中的全部输出，只用于没有关联文件的缓冲区
+    std::string take() { return std::move(buffer_); }
+
+private:
+    // 关联了文件时每次写入的大小
+    static constexpr std::size_t SPILL_SIZE = 64 * 1024;
+
+    OutputBuffer& spill()
+    {
+        if (file_ != nullptr && buffer_.size() >= SPILL_SIZE) {
+            flush();
+        }
+        return *this;
+    }
+
+    std::string buffer_;
+    std::FILE* file_ = nullptr;
+    bool failed_ = false;
+};
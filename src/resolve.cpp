@@ -0,0 +1,198 @@
+/*
+实现名字解析
+在解析完成后遍历一次 AST：维护作用域、把每个标识符绑定到符号表中的记录、折叠常量的值。
+IR 生成阶段直接读取这些绑定，不再查符号表。
+遍历顺序与 IR 生成的顺序一致，保证变量的编号与之前相同。
+*/
+
+#include "ast.h"
+#include "string_format.h"
+
+void CompUnitAST::resolve(SymbolTable& symbol_table)
+{
+    if (func_def) {
+        func_def->resolve(symbol_table);
+    }
+}
+
+void FuncDefAST::resolve(SymbolTable& symbol_table)
+{
+    block->resolve(symbol_table);
+}
+
+void BlockAST::resolve(SymbolTable& symbol_table)
+{
+    // 为块创建新的作用域
+    symbol_table.enterScope();
+
+    for (const auto& item : block_items) {
+        item->resolve(symbol_table);
+    }
+
+    // 退出作用域
+    symbol_table.exitScope();
+}
+
+void BlockItemAST::resolve(SymbolTable& symbol_table)
+{
+    std::visit([&](const auto& item_ptr) {
+        item_ptr->resolve(symbol_table);
+    }, item);
+}
+
+void StmtAST::resolve(SymbolTable& symbol_table)
+{
+    std::visit([&](const auto& stmt_ptr) {
+        using StmtType = std::decay_t<decltype(stmt_ptr)>;
+        if constexpr (!std::is_same_v<StmtType, AstPtr<BreakStmtAST>> && !std::is_same_v<StmtType, AstPtr<ContinueStmtAST>>) {
+            stmt_ptr->resolve(symbol_table);
+        }
+    }, statement);
+}
+
+void LValEqExpStmtAST::resolve(SymbolTable& symbol_table)
+{
+    if (!lval || !expression) {
+        throw std::runtime_error("LValEqExpStmtAST: lval or expression is null");
+    }
+
+    lval->resolve(symbol_table);
+    if (lval->symbol == nullptr || lval->symbol->symbol_type != SymbolType::VAR) {
+        throw std::runtime_error(stringFormat("Variable '%s' not defined", lval->ident.c_str()));
+    }
+    expression->resolve(symbol_table);
+}
+
+void ReturnExpStmtAST::resolve(SymbolTable& symbol_table)
+{
+    if (expression.has_value()) {
+        expression->get()->resolve(symbol_table);
+    }
+}
+
+void OptionalExpStmtAST::resolve(SymbolTable& symbol_table)
+{
+    if (expression.has_value()) {
+        expression->get()->resolve(symbol_table);
+    }
+}
+
+void BlockStmtAST::resolve(SymbolTable& symbol_table)
+{
+    block->resolve(symbol_table);
+}
+
+void IfElseStmtAST::resolve(SymbolTable& symbol_table)
+{
+    condition->resolve(symbol_table);
+
+    symbol_table.enterScope();
+    then_stmt->resolve(symbol_table);
+    symbol_table.exitScope();
+
+    if (else_stmt.has_value()) {
+        symbol_table.enterScope();
+        else_stmt.value()->resolve(symbol_table);
+        symbol_table.exitScope();
+    }
+}
+
+void WhileStmtAST::resolve(SymbolTable& symbol_table)
+{
+    symbol_table.enterScope();
+    condition->resolve(symbol_table);
+    body->resolve(symbol_table);
+    symbol_table.exitScope();
+}
+
+void DeclAST::resolve(SymbolTable& symbol_table)
+{
+    std::visit([&](const auto& decl_ptr) {
+        decl_ptr->resolve(symbol_table);
+    }, declaration);
+}
+
+void ConstDeclAST::resolve(SymbolTable& symbol_table)
+{
+    for (const auto& const_def : const_defs) {
+        const_def->resolve(symbol_table);
+    }
+}
+
+std::optional<int> ConstDefAST::resolve(SymbolTable& symbol_table)
+{
+    // 求值常量初始化表达式
+    const_init_val->const_exp->resolve(symbol_table);
+    auto init_value = const_init_val->const_exp->evaluateConstant();
+    if (!init_value.has_value()) {
+        // 常量初始化表达式必须是编译时常量
+        return std::nullopt;
+    }
+
+    // 添加到符号表 - 使用原始标识符
+    SymbolTableItem item(SymbolType::CONST, "int", ident, init_value.value(), true);
+    symbol = symbol_table.addSymbol(item);
+    if (symbol == nullptr) {
+        // 符号重定义
+        return std::nullopt;
+    }
+
+    return init_value;
+}
+
+void VarDeclAST::resolve(SymbolTable& symbol_table)
+{
+    const auto& type_name = btype == BT_INT ? "i32" : "/* unknown */";
+    for (const auto& var_def : var_defs) {
+        var_def->resolve(symbol_table, type_name);
+    }
+}
+
+void VarDefAST::resolve(SymbolTable& symbol_table, std::string_view type_name)
+{
+    // 先添加符号（这会自动分配唯一的scope_identifier），再解析初始化表达式
+    auto new_symbol = SymbolTableItem(SymbolType::VAR, type_name, ident, std::nullopt);
+    auto* added_symbol = symbol_table.addSymbol(new_symbol);
+    if (added_symbol == nullptr) {
+        throw std::runtime_error(stringFormat("Variable '%s' already defined", ident.c_str()));
+    }
+    added_symbol->koopa_name = stringFormat("@%s_%d", ident.c_str(), added_symbol->scope_identifier.value());
+    symbol = added_symbol;
+
+    if (const_init_val.has_value()) {
+        const_init_val.value()->const_exp->resolve(symbol_table);
+    }
+}
+
+void ConstExpAST::resolve(SymbolTable& symbol_table)
+{
+    expression->resolve(symbol_table);
+}
+
+void LValAST::resolve(SymbolTable& symbol_table)
+{
+    symbol = symbol_table.getSymbol(ident);
+}
+
+void ExpAST::resolve(SymbolTable& symbol_table)
+{
+    // 表达式内部不会引入新的声明，访问顺序无关紧要，用显式栈遍历以免深层递归
+    std::vector<ExpAST*> stack { this };
+    while (!stack.empty()) {
+        auto* node = stack.back();
+        stack.pop_back();
+
+        // 绑定可能改变，之前缓存的常量求值结果作废
+        node->const_state = CONST_UNKNOWN;
+
+        if (node->kind == EXP_LVAL) {
+            node->lval->resolve(symbol_table);
+        }
+        if (node->rhs) {
+            stack.push_back(node->rhs.get());
+        }
+        if (node->lhs) {
+            stack.push_back(node->lhs.get());
+        }
+    }
+}
@@ -1,7 +1,8 @@
 #pragma once
 
-#include <memory>
+#include <cstddef>
 #include <string>
+#include <string_view>
 #include <stdexcept>
 #include <type_traits>
 #include <cstdio>
@@ -22,21 +23,48 @@ auto convert(T&& t)
 /**
  * printf like formatting for C++ with std::string
  * Original source: https://stackoverflow.com/a/26221725/11722
+ *
+ * 先格式化到栈上的缓冲区，放得下时只调用一次 snprintf，
+ * 只有结果超过缓冲区时才按实际长度再格式化一次。
+ * 生成的目标代码直接写入 OutputBuffer（见 output_buffer.h），控制流的基本块按编号查找
+ * （见 KoopaBuilder::getBlock），都不经过这个函数；这里用于每个变量声明一次的 Koopa 名字、
+ * 错误信息和报告。
  */
 template <typename... Args>
-std::string stringFormatInternal(const std::string& format, Args&&... args)
+std::string stringFormatInternal(const char* format, Args... args)
 {
-    const auto size = std::snprintf(nullptr, 0, format.c_str(), std::forward<Args>(args)...) + 1;
-    if (size <= 0) {
+    char buffer[256];
+    const auto size = std::snprintf(buffer, sizeof(buffer), format, args...);
+    if (size < 0) {
         throw std::runtime_error("Error during formatting.");
     }
-    std::unique_ptr<char[]> buf(new char[size]);
-    std::snprintf(buf.get(), size, format.c_str(), args...);
-    return std::string(buf.get(), buf.get() + size - 1);
+    if (static_cast<std::size_t>(size) < sizeof(buffer)) {
+        return std::string(buffer, size);
+    }
+    std::string result(size, '\0');
+    std::snprintf(result.data(), size + 1, format, args...);
+    return result;
 }
 
 template <typename... Args>
-std::string stringFormat(std::string fmt, Args&&... args)
+std::string stringFormat(const char* fmt, Args&&... args)
 {
     return stringFormatInternal(fmt, convert(std::forward<Args>(args))...);
-}
\ No newline at end of file
+}
+
+// 把字符串转义为 JSON 字符串的内容（不含两边的引号）
+inline std::string escapeJson(std::string_view text)
+{
+    std::string result;
+    for (const char ch : text) {
+        if (ch == '"' || ch == '\\') {
+            result += '\\';
+            result += ch;
+        } else if (static_cast<unsigned char>(ch) < 0x20) {
+            result += stringFormat("\\u%04x", ch);
+        } else {
+            result += ch;
+        }
+    }
+    return result;
+}
@@ -0,0 +1,93 @@
+#include "string_interner.h"
+
+#include <algorithm>
+#include <cstring>
+
+StringInterner::StringInterner()
+{
+    slots_.assign(256, EMPTY_SLOT);
+}
+
+std::uint64_t StringInterner::hash(std::string_view text)
+{
+    // FNV-1a
+    std::uint64_t value = 1469598103934665603ULL;
+    for (char ch : text) {
+        value ^= static_cast<unsigned char>(ch);
+        value *= 1099511628211ULL;
+    }
+    return value;
+}
+
+InternedString StringInterner::intern(std::string_view text)
+{
+    const auto text_hash = hash(text);
+    const auto mask = slots_.size() - 1;
+
+    auto slot = static_cast<std::size_t>(text_hash) & mask;
+    while (slots_[slot] != EMPTY_SLOT) {
+        const auto& entry = entries_[slots_[slot]];
+        if (hashes_[slots_[slot]] == text_hash && entry.view() == text) {
+            return entry;
+        }
+        slot = (slot + 1) & mask;
+    }
+
+    InternedString entry {
+        store(text),
+        static_cast<std::uint32_t>(text.size()),
+        static_cast<std::uint32_t>(entries_.size()),
+    };
+    slots_[slot] = entry.id;
+    entries_.push_back(entry);
+    hashes_.push_back(text_hash);
+
+    // 装载因子超过 1/2 时扩容
+    if (entries_.size() * 2 > slots_.size()) {
+        rehash(slots_.size() * 2);
+    }
+    return entry;
+}
+
+const char* StringInterner::store(std::string_view text)
+{
+    const auto needed = text.size() + 1;
+    while (current_chunk_ < chunks_.size() && chunk_used_ + needed > chunk_sizes_[current_chunk_]) {
+        ++current_chunk_;
+        chunk_used_ = 0;
+    }
+    if (current_chunk_ == chunks_.size()) {
+        const auto size = std::max(CHUNK_SIZE, needed);
+        chunks_.push_back(std::make_unique<char[]>(size));
+        chunk_sizes_.push_back(size);
+        chunk_used_ = 0;
+    }
+
+    char* dest = chunks_[current_chunk_].get() + chunk_used_;
+    std::memcpy(dest, text.data(), text.size());
+    dest[text.size()] = '\0';
+    chunk_used_ += needed;
+    return dest;
+}
+
+void StringInterner::rehash(std::size_t new_capacity)
+{
+    slots_.assign(new_capacity, EMPTY_SLOT);
+    const auto mask = new_capacity - 1;
+    for (std::uint32_t i = 0; i < entries_.size(); ++i) {
+        auto slot = static_cast<std::size_t>(hashes_[i]) & mask;
+        while (slots_[slot] != EMPTY_SLOT) {
+            slot = (slot + 1) & mask;
+        }
+        slots_[slot] = i;
+    }
+}
+
+void StringInterner::reset()
+{
+    entries_.clear();
+    hashes_.clear();
+    std::fill(slots_.begin(), slots_.end(), EMPTY_SLOT);
+    current_chunk_ = 0;
+    chunk_used_ = 0;
+}
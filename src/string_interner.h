@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string_view>
+#include <vector>
+
+// 驻留后的字符串
+// data 指向 StringInterner 内部以 '\0' 结尾的存储，在一个编译单元内保持不变；
+// 同一个 StringInterner 中内容相同的字符串拥有相同的 id，可以直接按 id 比较和索引。
+// 这里刻意保持为平凡类型，以便直接放进 Bison 的 %union 中。
+struct InternedString {
+    const char* data;
+    std::uint32_t length;
+    std::uint32_t id;
+
+    std::string_view view() const { return std::string_view(data, length); }
+    const char* c_str() const { return data; }
+
+    bool operator==(const InternedString& other) const { return data == other.data; }
+    bool operator!=(const InternedString& other) const { return data != other.data; }
+};
+
+inline std::ostream& operator<<(std::ostream& os, const InternedString& str)
+{
+    return os << str.view();
+}
+
+// 字符串驻留表，每个编译单元一份
+// 对已经出现过的字符串，intern() 只做一次哈希查找，不会分配任何内存
+class StringInterner {
+public:
+    StringInterner();
+
+    StringInterner(const StringInterner&) = delete;
+    StringInterner& operator=(const StringInterner&) = delete;
+
+    InternedString intern(std::string_view text);
+
+    // 按 id 取回驻留的字符串
+    const InternedString& get(std::uint32_t id) const { return entries_[id]; }
+
+    // 已驻留的字符串个数，同时也是下一个可用的 id
+    std::size_t size() const { return entries_.size(); }
+
+    // 清空驻留表，保留已申请的内存以便下一个编译单元复用
+    void reset();
+
+private:
+    static constexpr std::size_t CHUNK_SIZE = 4096;
+    static constexpr std::uint32_t EMPTY_SLOT = UINT32_MAX;
+
+    static std::uint64_t hash(std::string_view text);
+    const char* store(std::string_view text);
+    void rehash(std::size_t new_capacity);
+
+    std::vector<InternedString> entries_;
+    std::vector<std::uint64_t> hashes_; // 与 entries_ 一一对应，扩容时免去重新计算
+    std::vector<std::uint32_t> slots_; // 开放寻址表，存放 entries_ 的下标
+    std::vector<std::unique_ptr<char[]>> chunks_;
+    std::vector<std::size_t> chunk_sizes_;
+    std::size_t current_chunk_ = 0;
+    std::size_t chunk_used_ = 0;
+};
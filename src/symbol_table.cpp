@@ -1,60 +1,59 @@
 #include "symbol_table.h"
 
-// 定义静态成员变量
-int SymbolTable::global_variable_counter = 0;
-
 void SymbolTable::enterScope() {
-    scopes.emplace(); // 添加新的作用域
-    current_scope_level++;
+    scope_marks.push_back(undo_log.size()); // 记录新作用域的起点
 }
 
 void SymbolTable::exitScope() {
-    if (!scopes.empty()) {
-        scopes.pop(); // 移除当前作用域
-        current_scope_level--;
+    if (scope_marks.empty()) {
+        return;
+    }
+
+    // 按声明的逆序撤销本作用域的绑定，恢复被遮蔽的外层声明
+    const auto mark = scope_marks.back();
+    while (undo_log.size() > mark) {
+        const auto& binding = bindings[undo_log.back()];
+        visible[binding.item.identifier.id] = binding.shadowed;
+        undo_log.pop_back();
     }
+    scope_marks.pop_back();
 }
 
-bool SymbolTable::addSymbol(SymbolTableItem& item) {
-    if (scopes.empty()) {
-        return false; // 没有作用域
+SymbolTableItem* SymbolTable::addSymbol(SymbolTableItem& item) {
+    if (scope_marks.empty()) {
+        return nullptr; // 没有作用域
     }
-    
-    auto& current_scope = scopes.top();
 
     // 设置唯一的作用域标识符
     item.scope_identifier = getNextGlobalVariableId();
-    
+
     // 检查当前作用域是否已存在该标识符
-    if (current_scope.find(item.identifier) != current_scope.end()) {
-        return false; // 重复定义
+    if (existsInCurrentScope(item.identifier)) {
+        return nullptr; // 重复定义
     }
-    
-    current_scope[item.identifier] = item;
-    return true;
+
+    const auto id = item.identifier.id;
+    if (id >= visible.size()) {
+        visible.resize(id + 1, NO_BINDING);
+    }
+
+    const auto index = static_cast<std::uint32_t>(bindings.size());
+    bindings.push_back(Binding { item, visible[id], getCurrentScopeLevel() });
+    visible[id] = index;
+    undo_log.push_back(index);
+    return &bindings.back().item;
 }
 
-std::optional<SymbolTableItem> SymbolTable::getSymbol(const std::string& identifier) const {
-    // 从当前作用域开始向外层查找
-    std::stack<std::unordered_map<std::string, SymbolTableItem>> temp_stack = scopes;
-    
-    while (!temp_stack.empty()) {
-        const auto& current_scope = temp_stack.top();
-        auto it = current_scope.find(identifier);
-        if (it != current_scope.end()) { 
-            return it->second;
-        }
-        temp_stack.pop();
+const SymbolTableItem* SymbolTable::getSymbol(InternedString identifier) const {
+    if (identifier.id >= visible.size() || visible[identifier.id] == NO_BINDING) {
+        return nullptr; // 未找到
     }
-    
-    return std::nullopt; // 未找到
+    return &bindings[visible[identifier.id]].item;
 }
 
-bool SymbolTable::existsInCurrentScope(const std::string& identifier) const {
-    if (scopes.empty()) {
+bool SymbolTable::existsInCurrentScope(InternedString identifier) const {
+    if (identifier.id >= visible.size() || visible[identifier.id] == NO_BINDING) {
         return false;
     }
-    
-    const auto& current_scope = scopes.top();
-    return current_scope.find(identifier) != current_scope.end();
-}
\ No newline at end of file
+    return bindings[visible[identifier.id]].scope_level == getCurrentScopeLevel();
+}
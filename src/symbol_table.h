@@ -1,11 +1,15 @@
 #pragma once
 
+#include <cstdint>
+#include <deque>
 #include <optional>
 #include <string>
-#include <variant>
+#include <string_view>
 #include <vector>
-#include <stack>
-#include <unordered_map>
+
+#include "string_interner.h"
+
+struct koopa_raw_value_data; // koopa.h
 
 enum class SymbolType {
     CONST,      // 常量
@@ -16,37 +20,46 @@ enum class SymbolType {
 class SymbolTableItem {
 public:
     SymbolType symbol_type; // 符号类型
-    std::string type; // 数据类型 (int, void等)
-    std::string identifier; // 标识符
+    std::string_view type; // 数据类型 (int, void等)
+    InternedString identifier; // 标识符，指向驻留字符串，在整个编译单元内有效
     std::optional<int> value; // 可选的值，用于常量
     std::optional<int> scope_identifier; // 作用域标识符，用于区分同名变量，构造时不初始化
+    std::string koopa_name; // 变量在 Koopa IR 中的名字（如 @x_3），名字解析时生成一次
+    const koopa_raw_value_data* koopa_value = nullptr; // 变量的 alloc 指令，IR 生成时填写
     bool is_const; // 是否为常量
 
-    // 默认构造函数
-    SymbolTableItem() 
-        : symbol_type(SymbolType::VAR), type(""), identifier(""), value(std::nullopt), is_const(false) {}
-
-    SymbolTableItem(SymbolType sym_type, const std::string& data_type, const std::string& identifier, 
+    SymbolTableItem(SymbolType sym_type, std::string_view data_type, InternedString identifier,
                    std::optional<int> value = std::nullopt, bool is_const = false)
         : symbol_type(sym_type), type(data_type), identifier(identifier), value(value), is_const(is_const) {}
-    
+
     auto operator==(const SymbolTableItem& other) const {
-        return symbol_type == other.symbol_type && type == other.type && 
+        return symbol_type == other.symbol_type && type == other.type &&
                identifier == other.identifier && value == other.value && is_const == other.is_const;
     }
-    
+
     auto operator!=(const SymbolTableItem& other) const{
         return !(*this == other);
     }
 };
 
 // 支持作用域的符号表
+// 每个驻留字符串 id 对应一条绑定链，链头就是当前可见的声明，查找只需一次数组下标访问；
+// 进入作用域时记录撤销日志的长度，退出时只回滚本作用域内新增的声明。
 class SymbolTable {
 private:
-    // 使用栈来管理嵌套的作用域，每个作用域是一个哈希表
-    std::stack<std::unordered_map<std::string, SymbolTableItem>> scopes;
-    int current_scope_level = 0; // 当前作用域级别
-    static int global_variable_counter; // 全局变量计数器，确保每个变量都有唯一的后缀
+    static constexpr std::uint32_t NO_BINDING = UINT32_MAX;
+
+    struct Binding {
+        SymbolTableItem item;
+        std::uint32_t shadowed; // 被遮蔽的同名外层绑定，没有时为 NO_BINDING
+        int scope_level; // 声明所在的作用域层数
+    };
+
+    std::deque<Binding> bindings; // 所有声明过的符号，退出作用域后仍然保留，地址保持不变
+    std::vector<std::uint32_t> visible; // 以标识符 id 为下标，指向当前可见的绑定
+    std::vector<std::uint32_t> undo_log; // 当前所有活跃的绑定，按声明顺序排列
+    std::vector<std::size_t> scope_marks; // 每个作用域开始时 undo_log 的长度
+    int global_variable_counter = 0; // 变量计数器，确保同一编译单元中每个变量都有唯一的后缀
 
 public:
     SymbolTable() {
@@ -56,30 +69,31 @@ public:
 
     // 进入新的作用域
     void enterScope();
-    
+
     // 退出当前作用域
     void exitScope();
-    
-    // 在当前作用域添加符号
-    bool addSymbol(SymbolTableItem& item);
-    
-    // 查找符号（从当前作用域向外查找）
-    std::optional<SymbolTableItem> getSymbol(const std::string& identifier) const;
+
+    // 在当前作用域添加符号，返回符号表中保存的记录，重复定义时返回 nullptr
+    SymbolTableItem* addSymbol(SymbolTableItem& item);
+
+    // 查找符号（从当前作用域向外查找），找不到时返回 nullptr
+    // 返回的指针在符号表的整个生命周期内有效，退出作用域也不会使其失效
+    const SymbolTableItem* getSymbol(InternedString identifier) const;
 
     // 获取当前作用域的编号
     int getCurrentScopeLevel() const {
-        return static_cast<int>(scopes.size());
+        return static_cast<int>(scope_marks.size());
     }
-    
+
     // 获取下一个全局变量计数器值
     int getNextGlobalVariableId() {
         return ++global_variable_counter;
     }
-    
+
     // 检查当前作用域是否已存在该标识符
-    bool existsInCurrentScope(const std::string& identifier) const;
+    bool existsInCurrentScope(InternedString identifier) const;
 
     // 兼容旧接口
     void addItem(SymbolTableItem& item) { addSymbol(item); }
-    std::optional<SymbolTableItem> getItem(const std::string& identifier) const { return getSymbol(identifier); }
-};
\ No newline at end of file
+    const SymbolTableItem* getItem(InternedString identifier) const { return getSymbol(identifier); }
+};
@@ -2,6 +2,8 @@
   #include <memory>
   #include <string>
   #include "ast.h"
+
+  class CompilerContext;
 }
 
 %{
@@ -10,38 +12,64 @@
 #include <memory>
 #include <string>
 #include "ast.h"
-
-// 声明 lexer 函数和错误处理函数
-int yylex();
-void yyerror(std::unique_ptr<BaseAST> &ast, const char *s);
+#include "compiler_context.h"
 
 using namespace std;
 
+// 规则的位置从第一个符号的开头到最后一个符号的结尾, 空规则取前一个符号的结尾
+#define YYLLOC_DEFAULT(Current, Rhs, N)                 \
+  do {                                                  \
+    if (N) {                                            \
+      (Current).first = YYRHSLOC(Rhs, 1).first;         \
+      (Current).last = YYRHSLOC(Rhs, N).last;           \
+    } else {                                            \
+      (Current).first = (Current).last = YYRHSLOC(Rhs, 0).last; \
+    }                                                   \
+  } while (0)
+
+// Bison 默认的栈深度上限是 10000, 上万层括号的表达式会导致 "memory exhausted"
+// 解析栈按需倍增, 这里只是放宽上限
+#define YYMAXDEPTH 10000000
+
 %}
 
+// 可重入的 parser: yylval 等状态都是 yyparse 的局部变量, 不再是全局变量
+%define api.pure full
+
+// 位置记录的是 token 的序号而不是行列号, 用来确定每个函数定义对应哪一段 token
+%locations
+%define api.location.type {TokenSpan}
+
 // 定义 parser 函数和错误处理函数的附加参数
-%parse-param { std::unique_ptr<BaseAST> &ast }
+%parse-param { AstPtr<BaseAST> &ast }
+// 所有 AST 节点都分配在 arena 中, 由它统一释放
+%parse-param { Arena &arena }
+// 编译上下文, 同时传给 lexer, 用来找到这次编译使用的扫描器
+%param { CompilerContext &context }
 
 // yylval 的定义
 %union {
-  std::string *str_val;
+  InternedString ident_val;
   int int_val;
-  char char_val;
+  BinaryOp binary_op_val;
   BaseAST* ast_val;
-  std::vector<std::unique_ptr<BaseAST>>* ast_vec_val;
+  std::vector<AstPtr<BaseAST>>* ast_vec_val;
+}
+
+%code {
+// 声明 lexer 函数和错误处理函数
+// yylex 定义在 sysy.l 中, 会根据 context 的选择使用 flex 扫描器或 mmap 扫描器
+int yylex(YYSTYPE *lval, YYLTYPE *lloc, CompilerContext &context);
+void yyerror(YYLTYPE *lloc, AstPtr<BaseAST> &ast, Arena &arena, CompilerContext &context, const char *s);
 }
 
 // lexer 返回的所有 token 种类的声明
 %token INT BTYPE RETURN CONST IF ELSE WHILE BREAK CONTINUE
-%token <str_val> IDENT
+%token <ident_val> IDENT
 %token <int_val> INT_CONST
-%token <char_val> UNARY_OP
-%token <char_val> MUL_OP
-%token <char_val> ADD_OP
-%token <str_val> REL_OP
-%token <str_val> EQ_OP
-%token <str_val> LAND_OP
-%token <str_val> LOR_OP
+%token <binary_op_val> MUL_OP ADD_OP REL_OP EQ_OP
+%token LAND_OP
+%token LOR_OP
 %token '(' LEFT_PAREN
 %token ')' RIGHT_PAREN
 
@@ -49,20 +77,31 @@ using namespace std;
 // 越往下定义的优先级越高
 %nonassoc THEN // 为 "if-then" 规则创建一个较低的优先级
 %nonassoc ELSE // 为 "else" 关键字赋予一个更高的优先级
+// 表达式运算符的优先级, 与 SysY 文法中 LOrExp ... UnaryExp 的层次一一对应
+%left LOR_OP
+%left LAND_OP
+%left EQ_OP
+%left REL_OP
+%left ADD_OP
+%left MUL_OP
+%right UNARY '!'
 
 // 非终结符的类型定义
 %type <ast_val> FuncDef FuncType Block BlockItem Stmt Number
-%type <ast_val> Exp UnaryExp PrimaryExp CompUnit MulExp AddExp RelExp EqExp LAndExp LOrExp
+%type <ast_val> Exp CompUnit
 %type <ast_val> Decl ConstDecl ConstDef ConstInitVal LVal ConstExp VarDecl VarDef
 %type <ast_vec_val> ConstDefList BlockItemList VarDefList
+// 出现语法错误时 parser 会丢弃栈上的符号, 列表是 new 出来的, 需要在这里释放
+// AST 节点都在 arena 中, 不需要处理
+%destructor { delete $$; } <ast_vec_val>
 
 %%
 
 // 开始符号, CompUnit ::= FuncDef
 CompUnit
   : FuncDef {
-    auto comp_unit = std::make_unique<CompUnitAST>(
-        std::unique_ptr<FuncDefAST>(static_cast<FuncDefAST*>($1))
+    auto comp_unit = arena.make<CompUnitAST>(
+        AstPtr<FuncDefAST>(static_cast<FuncDefAST*>($1))
     );
     ast = std::move(comp_unit);
   }
@@ -71,12 +110,12 @@ CompUnit
 // FuncDef ::= FuncType IDENT '(' ')' Block
 FuncDef
   : FuncType IDENT '(' ')' Block {
-    auto func_def = std::make_unique<FuncDefAST>(
-        std::unique_ptr<FuncTypeAST>(static_cast<FuncTypeAST*>($1)),
-        std::string(*$2),
-        std::unique_ptr<BlockAST>(static_cast<BlockAST*>($5))
+    auto func_def = arena.make<FuncDefAST>(
+        AstPtr<FuncTypeAST>(static_cast<FuncTypeAST*>($1)),
+        $2,
+        AstPtr<BlockAST>(static_cast<BlockAST*>($5))
     );
-    delete $2;  // 清理 IDENT 的内存
+    func_def->tokens = @$;
     $$ = func_def.release();
   }
   ;
@@ -84,7 +123,7 @@ FuncDef
 // FuncType ::= "int"
 FuncType
   : BTYPE {
-    auto func_type = std::make_unique<FuncTypeAST>(string("int"));
+    auto func_type = arena.make<FuncTypeAST>(string("int"));
     $$ = func_type.release();
   }
   ;
@@ -93,15 +132,15 @@ FuncType
 BlockItem
   : Decl {
     // BlockItem ::= Decl;
-    auto block_item = std::make_unique<BlockItemAST>(
-        std::unique_ptr<DeclAST>(static_cast<DeclAST*>($1))
+    auto block_item = arena.make<BlockItemAST>(
+        AstPtr<DeclAST>(static_cast<DeclAST*>($1))
     );
     $$ = block_item.release();
   }
   | Stmt {
     // BlockItem ::= Stmt;
-    auto block_item = std::make_unique<BlockItemAST>( 
-        std::unique_ptr<StmtAST>(static_cast<StmtAST*>($1))
+    auto block_item = arena.make<BlockItemAST>( 
+        AstPtr<StmtAST>(static_cast<StmtAST*>($1))
     );
     $$ = block_item.release();
   }
@@ -111,14 +150,14 @@ BlockItem
 BlockItemList
   : BlockItem {
     // BlockItemList ::= BlockItem;
-    auto block_item_list = new std::vector<std::unique_ptr<BaseAST>>();
-    block_item_list->push_back(std::unique_ptr<BaseAST>(static_cast<BaseAST*>($1)));
+    auto block_item_list = new std::vector<AstPtr<BaseAST>>();
+    block_item_list->push_back(AstPtr<BaseAST>(static_cast<BaseAST*>($1)));
     $$ = block_item_list;
   }
   | BlockItemList BlockItem {
     // BlockItemList ::= BlockItemList BlockItem;
     auto block_item_list = $1;
-    block_item_list->push_back(std::unique_ptr<BaseAST>(static_cast<BaseAST*>($2)));
+    block_item_list->push_back(AstPtr<BaseAST>(static_cast<BaseAST*>($2)));
     $$ = block_item_list;  // 返回更新后的列表
   }
   ;
@@ -127,19 +166,19 @@ BlockItemList
 Block
   : '{' '}' {
     // Block ::= "{" "}"; - 空块
-    auto block = std::make_unique<BlockAST>();
+    auto block = arena.make<BlockAST>();
     $$ = block.release();
   }
   | '{' BlockItemList '}' {
     // Block ::= "{" BlockItemList "}";
     // 需要将 BaseAST* 转换为 BlockItemAST*
-    std::vector<std::unique_ptr<BlockItemAST>> block_items;
+    std::vector<AstPtr<BlockItemAST>> block_items;
     auto base_list = $2;
     for (auto& item : *base_list) {
-      block_items.push_back(std::unique_ptr<BlockItemAST>(static_cast<BlockItemAST*>(item.release())));
+      block_items.push_back(AstPtr<BlockItemAST>(static_cast<BlockItemAST*>(item.release())));
     }
     delete base_list;
-    auto block = std::make_unique<BlockAST>(std::move(block_items));
+    auto block = arena.make<BlockAST>(std::move(block_items));
     $$ = block.release();
   }
   ;
@@ -154,11 +193,11 @@ Stmt
   : LVal '=' Exp ';'
   {
     // Stmt ::= LVal "=" Exp ";"
-    auto lval_eq_exp_stmt = std::make_unique<LValEqExpStmtAST>(
-      std::unique_ptr<LValAST>(static_cast<LValAST*>($1)),
-      std::unique_ptr<ExpAST>(static_cast<ExpAST*>($3))
+    auto lval_eq_exp_stmt = arena.make<LValEqExpStmtAST>(
+      AstPtr<LValAST>(static_cast<LValAST*>($1)),
+      AstPtr<ExpAST>(static_cast<ExpAST*>($3))
     );
-    auto stmt = std::make_unique<StmtAST>(
+    auto stmt = arena.make<StmtAST>(
       std::move(lval_eq_exp_stmt)
     );
     $$ = stmt.release();
@@ -166,10 +205,10 @@ Stmt
   | RETURN Exp ';'
   {
     // Stmt ::= "return" Exp ";"
-    auto return_exp_stmt = std::make_unique<ReturnExpStmtAST>(
-      std::optional(std::unique_ptr<ExpAST>(static_cast<ExpAST*>($2)))
+    auto return_exp_stmt = arena.make<ReturnExpStmtAST>(
+      std::optional(AstPtr<ExpAST>(static_cast<ExpAST*>($2)))
     );
-    auto stmt = std::make_unique<StmtAST>(
+    auto stmt = arena.make<StmtAST>(
       std::move(return_exp_stmt)
     );
     $$ = stmt.release();
@@ -177,10 +216,10 @@ Stmt
   | RETURN ';'
   {
     // Stmt ::= "return" ";"
-    auto return_exp_stmt = std::make_unique<ReturnExpStmtAST>(
+    auto return_exp_stmt = arena.make<ReturnExpStmtAST>(
       std::nullopt  // 没有表达式
     );
-    auto stmt = std::make_unique<StmtAST>(
+    auto stmt = arena.make<StmtAST>(
       std::move(return_exp_stmt)
     );
     $$ = stmt.release();
@@ -188,10 +227,10 @@ Stmt
   | Block
   {
     // Stmt ::= Block;
-    auto block_stmt = std::make_unique<BlockStmtAST>(
-      std::unique_ptr<BlockAST>(static_cast<BlockAST*>($1))
+    auto block_stmt = arena.make<BlockStmtAST>(
+      AstPtr<BlockAST>(static_cast<BlockAST*>($1))
     );
-    auto stmt = std::make_unique<StmtAST>(
+    auto stmt = arena.make<StmtAST>(
       std::move(block_stmt)
     );
     $$ = stmt.release();
@@ -199,10 +238,10 @@ Stmt
   | Exp ';'
   {
     // Stmt ::= Exp ";"
-    auto exp_stmt = std::make_unique<OptionalExpStmtAST>(
-      std::unique_ptr<ExpAST>(static_cast<ExpAST*>($1))
+    auto exp_stmt = arena.make<OptionalExpStmtAST>(
+      AstPtr<ExpAST>(static_cast<ExpAST*>($1))
     );
-    auto stmt = std::make_unique<StmtAST>(
+    auto stmt = arena.make<StmtAST>(
       std::move(exp_stmt)
     );
     $$ = stmt.release();
@@ -210,8 +249,8 @@ Stmt
   | ';'
   {
     // Stmt ::= ";"
-    auto empty_stmt = std::make_unique<OptionalExpStmtAST>();
-    auto stmt = std::make_unique<StmtAST>(
+    auto empty_stmt = arena.make<OptionalExpStmtAST>();
+    auto stmt = arena.make<StmtAST>(
       std::move(empty_stmt)
     );
     $$ = stmt.release();
@@ -219,12 +258,12 @@ Stmt
   | IF '(' Exp ')' Stmt %prec THEN  // 最低优先级
   {
     // Stmt ::= IF '(' Exp ')' Stmt;
-    auto if_else_stmt = std::make_unique<IfElseStmtAST>(
-      std::unique_ptr<ExpAST>(static_cast<ExpAST*>($3)),
-      std::unique_ptr<StmtAST>(static_cast<StmtAST*>($5)),
+    auto if_else_stmt = arena.make<IfElseStmtAST>(
+      AstPtr<ExpAST>(static_cast<ExpAST*>($3)),
+      AstPtr<StmtAST>(static_cast<StmtAST*>($5)),
       std::nullopt  // 没有 else 分支
     );
-    auto stmt = std::make_unique<StmtAST>(
+    auto stmt = arena.make<StmtAST>(
       std::move(if_else_stmt)
     );
     $$ = stmt.release();
@@ -232,12 +271,12 @@ Stmt
   | IF '(' Exp ')' Stmt ELSE Stmt
   {
     // Stmt ::= IF '(' Exp ')' Stmt ELSE Stmt;
-    auto if_else_stmt = std::make_unique<IfElseStmtAST>(
-      std::unique_ptr<ExpAST>(static_cast<ExpAST*>($3)),
-      std::unique_ptr<StmtAST>(static_cast<StmtAST*>($5)),
-      std::unique_ptr<StmtAST>(static_cast<StmtAST*>($7))
+    auto if_else_stmt = arena.make<IfElseStmtAST>(
+      AstPtr<ExpAST>(static_cast<ExpAST*>($3)),
+      AstPtr<StmtAST>(static_cast<StmtAST*>($5)),
+      AstPtr<StmtAST>(static_cast<StmtAST*>($7))
     );
-    auto stmt = std::make_unique<StmtAST>(
+    auto stmt = arena.make<StmtAST>(
       std::move(if_else_stmt)
     );
     $$ = stmt.release();
@@ -245,11 +284,11 @@ Stmt
   | WHILE '(' Exp ')' Stmt
   {
     // Stmt ::= WHILE '(' Exp ')' Stmt;
-    auto while_stmt = std::make_unique<WhileStmtAST>(
-      std::unique_ptr<ExpAST>(static_cast<ExpAST*>($3)),
-      std::unique_ptr<StmtAST>(static_cast<StmtAST*>($5))
+    auto while_stmt = arena.make<WhileStmtAST>(
+      AstPtr<ExpAST>(static_cast<ExpAST*>($3)),
+      AstPtr<StmtAST>(static_cast<StmtAST*>($5))
     );
-    auto stmt = std::make_unique<StmtAST>(
+    auto stmt = arena.make<StmtAST>(
       std::move(while_stmt)
     );
     $$ = stmt.release();
@@ -257,8 +296,8 @@ Stmt
   | BREAK ';'
   {
     // Stmt ::= BREAK ";"
-    auto break_stmt = std::make_unique<BreakStmtAST>();
-    auto stmt = std::make_unique<StmtAST>(
+    auto break_stmt = arena.make<BreakStmtAST>();
+    auto stmt = arena.make<StmtAST>(
       std::move(break_stmt)
     );
     $$ = stmt.release();
@@ -266,8 +305,8 @@ Stmt
   | CONTINUE ';'
   {
     // Stmt ::= CONTINUE ";"
-    auto continue_stmt = std::make_unique<ContinueStmtAST>();
-    auto stmt = std::make_unique<StmtAST>(
+    auto continue_stmt = arena.make<ContinueStmtAST>();
+    auto stmt = arena.make<StmtAST>(
       std::move(continue_stmt)
     );
     $$ = stmt.release();
@@ -277,278 +316,105 @@ Stmt
 // Number ::= INT_CONST
 Number
   : INT_CONST {
-    auto number = std::make_unique<NumberAST>($1);
+    auto number = arena.make<ExpAST>($1);
     $$ = number.release();
   }
   ;
 
-// Exp ::= LOrExp
-Exp : LOrExp
-  {
-    auto exp = std::make_unique<ExpAST>(
-      std::unique_ptr<LOrExpAST>(static_cast<LOrExpAST*>($1))
-    );
-    $$ = exp.release();
-  }
-  ;
-
-UnaryExp : PrimaryExp
-  {
-    // UnaryExp ::= PrimaryExp
-    auto unary_exp = std::make_unique<UnaryExpAST>(
-      std::unique_ptr<PrimaryExpAST>(static_cast<PrimaryExpAST*>($1))
-    );
-    $$ = unary_exp.release();
-  }
-  | UNARY_OP UnaryExp
-  {
-    // UnaryExp ::= UnaryOp UnaryExp;
-    UnaryOp op;
-    switch ($1) {
-      case '+': op = UNARY_OP_POSITIVE; break;
-      case '-': op = UNARY_OP_NEGATIVE; break;
-      case '!': op = UNARY_OP_NOT; break;
-      default: op = UNARY_OP_POSITIVE; break;
-    }
-
-    auto unary_exp_op_and_exp = std::make_unique<UnaryExpOpAndExpAST>(
-      op,
-      std::unique_ptr<UnaryExpAST>(static_cast<UnaryExpAST*>($2))
-    );
-    
-    auto unary_exp = std::make_unique<UnaryExpAST>(std::move(unary_exp_op_and_exp));
-    $$ = unary_exp.release();
-  }
-  ;
-
-
-PrimaryExp : '(' Exp ')'
-  {
-    // PrimaryExp ::= "(" Exp ")"
-    auto primary_exp = std::make_unique<PrimaryExpAST>(
-      std::unique_ptr<ExpAST>(static_cast<ExpAST*>($2))
-    );
-    $$ = primary_exp.release();
-  }
-  | Number
-  {
-    // PrimaryExp ::= Number; (Number ::= INT_CONST)
-    NumberAST* number_ptr = static_cast<NumberAST*>($1);
-    auto primary_exp = std::make_unique<PrimaryExpAST>(
-      NumberAST(number_ptr->value)  // 创建 NumberAST 对象的副本
-    );
-    delete number_ptr;  // 清理原来的对象
-    $$ = primary_exp.release();
-  }
+// Exp ::= Number | LVal | "(" Exp ")" | UnaryOp Exp | Exp BinaryOp Exp
+// 各层表达式 (UnaryExp, MulExp, AddExp, RelExp, EqExp, LAndExp, LOrExp) 合并为一条产生式,
+// 优先级和结合性由文件开头的 %left / %right 声明给出, 每个子表达式只生成一个 ExpAST 节点
+Exp
+  : Number
   | LVal
   {
-    // PrimaryExp ::= LVal; (LVal ::= IDENT)
-    auto lval_ptr = static_cast<LValAST*>($1);
-    auto primary_exp = std::make_unique<PrimaryExpAST>(
-      std::unique_ptr<LValAST>(new LValAST(lval_ptr->ident))  // 创建 LValAST 对象的副本
+    auto exp = arena.make<ExpAST>(
+      AstPtr<LValAST>(static_cast<LValAST*>($1))
     );
-    delete lval_ptr;  // 清理原来的对象
-    $$ = primary_exp.release();
-  }
-  ;
-
-// MulExp ::= UnaryExp | MulExp ("*" | "/" | "%") UnaryExp;
-MulExp: UnaryExp
-  {
-    // MulExp ::= UnaryExp
-    auto mul_exp = std::make_unique<MulExpAST>(
-      std::unique_ptr<UnaryExpAST>(static_cast<UnaryExpAST*>($1))
-    );
-    $$ = mul_exp.release();
+    $$ = exp.release();
   }
-  | MulExp MUL_OP UnaryExp
+  | '(' Exp ')'
   {
-    // MulExp ::= MulExp ("*" | "/" | "%") UnaryExp;
-    MulOp op;
-    switch ($2) {
-      case '*': op = MUL_OP_MUL; break;
-      case '/': op = MUL_OP_DIV; break;
-      case '%': op = MUL_OP_MOD; break;
-      default: op = MUL_OP_MUL; break;
-    }
-
-    auto mul_exp_op_and_exp = std::make_unique<MulExpOpAndExpAST>(
-      op,
-      std::unique_ptr<MulExpAST>(static_cast<MulExpAST*>($1)),
-      std::unique_ptr<UnaryExpAST>(static_cast<UnaryExpAST*>($3))
-    );
-    
-    auto mul_exp = std::make_unique<MulExpAST>(std::move(mul_exp_op_and_exp));
-    $$ = mul_exp.release();
+    // 括号只影响解析顺序, 不需要额外的节点
+    $$ = $2;
   }
-  ;
-
-// AddExp ::= MulExp | AddExp ("+" | "-") MulExp;
-AddExp: MulExp
+  | ADD_OP Exp %prec UNARY
   {
-    // AddExp ::= MulExp
-    auto add_exp = std::make_unique<AddExpAST>(
-      std::unique_ptr<MulExpAST>(static_cast<MulExpAST*>($1))
+    auto exp = arena.make<ExpAST>(
+      $1 == BINARY_OP_SUB ? UNARY_OP_NEGATIVE : UNARY_OP_POSITIVE,
+      AstPtr<ExpAST>(static_cast<ExpAST*>($2))
     );
-    $$ = add_exp.release();
+    $$ = exp.release();
   }
-  | AddExp ADD_OP MulExp
+  | '!' Exp %prec UNARY
   {
-    // AddExp ::= AddExp ("+" | "-") MulExp;
-    AddOp op;
-    switch ($2) {
-      case '+': op = ADD_OP_ADD; break;
-      case '-': op = ADD_OP_SUB; break;
-      default: op = ADD_OP_ADD; break;
-    }
-
-    auto add_exp_op_and_exp = std::make_unique<AddExpOpAndMulExpAST>(
-      op,
-      std::unique_ptr<AddExpAST>(static_cast<AddExpAST*>($1)),
-      std::unique_ptr<MulExpAST>(static_cast<MulExpAST*>($3))
-    );
-    
-    auto add_exp = std::make_unique<AddExpAST>(std::move(add_exp_op_and_exp));
-    $$ = add_exp.release();
-  }
-  | AddExp UNARY_OP MulExp // 疑似加减号会被识别为 UNARY_OP
-    {
-    // AddExp ::= AddExp ("+" | "-") MulExp;
-    AddOp op;
-    switch ($2) {
-      case '+': op = ADD_OP_ADD; break;
-      case '-': op = ADD_OP_SUB; break;
-      default: op = ADD_OP_ADD; break;
-    }
-
-    auto add_exp_op_and_exp = std::make_unique<AddExpOpAndMulExpAST>(
-      op,
-      std::unique_ptr<AddExpAST>(static_cast<AddExpAST*>($1)),
-      std::unique_ptr<MulExpAST>(static_cast<MulExpAST*>($3))
-    );
-    
-    auto add_exp = std::make_unique<AddExpAST>(std::move(add_exp_op_and_exp));
-    $$ = add_exp.release();
-  }
-  ;
-
-// RelExp ::= AddExp | RelExp ("<" | ">" | "<=" | ">=") AddExp;
-RelExp: AddExp
-  {
-    // RelExp ::= AddExp
-    auto rel_exp = std::make_unique<RelExpAST>(
-      std::unique_ptr<AddExpAST>(static_cast<AddExpAST*>($1))
-    );
-    $$ = rel_exp.release();
-  }
-  | RelExp REL_OP AddExp
-  {
-    // RelExp ::= RelExp ("<" | ">" | "<=" | ">=") AddExp;
-    RelOp op;
-    if (*$2 == "<") {
-      op = REL_OP_LT;
-    } else if (*$2 == ">") {
-      op = REL_OP_GT;
-    } else if (*$2 == "<=") {
-      op = REL_OP_LE;
-    } else if (*$2 == ">=") {
-      op = REL_OP_GE;
-    } else {
-      op = REL_OP_LT; // 默认情况
-    }
-
-    auto rel_exp_op_and_exp = std::make_unique<RelExpOpAndAddExpAST>(
-      op,
-      std::unique_ptr<RelExpAST>(static_cast<RelExpAST*>($1)),
-      std::unique_ptr<AddExpAST>(static_cast<AddExpAST*>($3))
+    auto exp = arena.make<ExpAST>(
+      UNARY_OP_NOT,
+      AstPtr<ExpAST>(static_cast<ExpAST*>($2))
     );
-    
-    auto rel_exp = std::make_unique<RelExpAST>(std::move(rel_exp_op_and_exp));
-    $$ = rel_exp.release();
+    $$ = exp.release();
   }
-  ;
-
-// EqExp ::= RelExp | EqExp ("==" | "!=") RelExp;
-EqExp: RelExp
+  | Exp MUL_OP Exp
   {
-    // EqExp ::= RelExp
-    auto eq_exp = std::make_unique<EqExpAST>(
-      std::unique_ptr<RelExpAST>(static_cast<RelExpAST*>($1))
+    auto exp = arena.make<ExpAST>(
+      $2,
+      AstPtr<ExpAST>(static_cast<ExpAST*>($1)),
+      AstPtr<ExpAST>(static_cast<ExpAST*>($3))
     );
-    $$ = eq_exp.release();
+    $$ = exp.release();
   }
-  | EqExp EQ_OP RelExp
+  | Exp ADD_OP Exp
   {
-    // EqExp ::= EqExp ("==" | "!=") RelExp;
-    EqOp op;
-    if (*$2 == "==") {
-      op = EQ_OP_EQ;
-    } else if (*$2 == "!=") {
-      op = EQ_OP_NE;
-    } else {
-      op = EQ_OP_EQ; // 默认情况
-    }
-
-    auto eq_exp_op_and_exp = std::make_unique<EqExpOpAndRelExpAST>(
-      op,
-      std::unique_ptr<EqExpAST>(static_cast<EqExpAST*>($1)),
-      std::unique_ptr<RelExpAST>(static_cast<RelExpAST*>($3))
+    auto exp = arena.make<ExpAST>(
+      $2,
+      AstPtr<ExpAST>(static_cast<ExpAST*>($1)),
+      AstPtr<ExpAST>(static_cast<ExpAST*>($3))
     );
-    
-    auto eq_exp = std::make_unique<EqExpAST>(std::move(eq_exp_op_and_exp));
-    $$ = eq_exp.release();
+    $$ = exp.release();
   }
-  ;
-
-// LAndExp ::= EqExp | LAndExp "&&" EqExp;
-LAndExp: EqExp
+  | Exp REL_OP Exp
   {
-    // LAndExp ::= EqExp
-    auto land_exp = std::make_unique<LAndExpAST>(
-      std::unique_ptr<EqExpAST>(static_cast<EqExpAST*>($1))
+    auto exp = arena.make<ExpAST>(
+      $2,
+      AstPtr<ExpAST>(static_cast<ExpAST*>($1)),
+      AstPtr<ExpAST>(static_cast<ExpAST*>($3))
     );
-    $$ = land_exp.release();
+    $$ = exp.release();
   }
-  | LAndExp LAND_OP EqExp
+  | Exp EQ_OP Exp
   {
-    // LAndExp ::= LAndExp "&&" EqExp;
-    auto land_exp_op_and_exp = std::make_unique<LAndExpOpAndEqExpAST>(
-      std::unique_ptr<LAndExpAST>(static_cast<LAndExpAST*>($1)),
-      std::unique_ptr<EqExpAST>(static_cast<EqExpAST*>($3))
+    auto exp = arena.make<ExpAST>(
+      $2,
+      AstPtr<ExpAST>(static_cast<ExpAST*>($1)),
+      AstPtr<ExpAST>(static_cast<ExpAST*>($3))
     );
-    
-    auto land_exp = std::make_unique<LAndExpAST>(std::move(land_exp_op_and_exp));
-    $$ = land_exp.release();
+    $$ = exp.release();
   }
-  ;
-
-// LOrExp ::= LAndExp | LOrExp "||" LAndExp;
-LOrExp: LAndExp
+  | Exp LAND_OP Exp
   {
-    // LOrExp ::= LAndExp
-    auto lor_exp = std::make_unique<LOrExpAST>(
-      std::unique_ptr<LAndExpAST>(static_cast<LAndExpAST*>($1))
+    auto exp = arena.make<ExpAST>(
+      BINARY_OP_LAND,
+      AstPtr<ExpAST>(static_cast<ExpAST*>($1)),
+      AstPtr<ExpAST>(static_cast<ExpAST*>($3))
     );
-    $$ = lor_exp.release();
+    $$ = exp.release();
   }
-  | LOrExp LOR_OP LAndExp
+  | Exp LOR_OP Exp
   {
-    // LOrExp ::= LOrExp "||" LAndExp;
-    auto lor_exp_op_and_exp = std::make_unique<LOrExpOpAndLAndExpAST>(
-      std::unique_ptr<LOrExpAST>(static_cast<LOrExpAST*>($1)),
-      std::unique_ptr<LAndExpAST>(static_cast<LAndExpAST*>($3))
+    auto exp = arena.make<ExpAST>(
+      BINARY_OP_LOR,
+      AstPtr<ExpAST>(static_cast<ExpAST*>($1)),
+      AstPtr<ExpAST>(static_cast<ExpAST*>($3))
     );
-    
-    auto lor_exp = std::make_unique<LOrExpAST>(std::move(lor_exp_op_and_exp));
-    $$ = lor_exp.release();
+    $$ = exp.release();
   }
   ;
 
 // ConstInitVal ::= ConstExp;
 ConstInitVal: ConstExp
   {
-    auto const_init_val = std::make_unique<ConstInitValAST>(
-      std::unique_ptr<ConstExpAST>(static_cast<ConstExpAST*>($1))
+    auto const_init_val = arena.make<ConstInitValAST>(
+      AstPtr<ConstExpAST>(static_cast<ConstExpAST*>($1))
     );
     $$ = const_init_val.release();
   }
@@ -557,8 +423,8 @@ ConstInitVal: ConstExp
 // ConstExp ::= Exp;
 ConstExp: Exp
   {
-    auto const_exp = std::make_unique<ConstExpAST>(
-      std::unique_ptr<ExpAST>(static_cast<ExpAST*>($1))
+    auto const_exp = arena.make<ConstExpAST>(
+      AstPtr<ExpAST>(static_cast<ExpAST*>($1))
     );
     $$ = const_exp.release();
   }
@@ -567,11 +433,10 @@ ConstExp: Exp
 // ConstDef ::= IDENT "=" ConstInitVal;
 ConstDef: IDENT '=' ConstInitVal
   {
-    auto const_def = std::make_unique<ConstDefAST>(
-      std::string(*$1),
-      std::unique_ptr<ConstInitValAST>(static_cast<ConstInitValAST*>($3))
+    auto const_def = arena.make<ConstDefAST>(
+      $1,
+      AstPtr<ConstInitValAST>(static_cast<ConstInitValAST*>($3))
     );
-    delete $1;  // 清理 IDENT 的内存
     $$ = const_def.release();
   }
   ;
@@ -580,15 +445,15 @@ ConstDef: IDENT '=' ConstInitVal
 ConstDefList: ConstDef
   {
     // ConstDefList ::= ConstDef;
-    auto const_def_list = new std::vector<std::unique_ptr<BaseAST>>();
-    const_def_list->push_back(std::unique_ptr<BaseAST>(static_cast<BaseAST*>($1)));
+    auto const_def_list = new std::vector<AstPtr<BaseAST>>();
+    const_def_list->push_back(AstPtr<BaseAST>(static_cast<BaseAST*>($1)));
     $$ = const_def_list;
   }
   | ConstDefList ',' ConstDef
   {
     // ConstDefList ::= ConstDefList ConstDef;
     auto const_def_list = $1;
-    const_def_list->push_back(std::unique_ptr<BaseAST>(static_cast<BaseAST*>($3)));
+    const_def_list->push_back(AstPtr<BaseAST>(static_cast<BaseAST*>($3)));
     $$ = const_def_list;  // 返回更新后的列表
   }
 
@@ -599,13 +464,13 @@ ConstDecl
   {
     // ConstDecl ::= "const" BType ConstDefList ";";
     // 需要将 BaseAST* 转换为 ConstDefAST*
-    std::vector<std::unique_ptr<ConstDefAST>> const_defs;
+    std::vector<AstPtr<ConstDefAST>> const_defs;
     auto base_list = $3;
     for (auto& item : *base_list) {
-      const_defs.push_back(std::unique_ptr<ConstDefAST>(static_cast<ConstDefAST*>(item.release())));
+      const_defs.push_back(AstPtr<ConstDefAST>(static_cast<ConstDefAST*>(item.release())));
     }
     delete base_list;
-    auto const_decl = std::make_unique<ConstDeclAST>(
+    auto const_decl = arena.make<ConstDeclAST>(
       BT_INT,  // BType 暂时只能为 "int"
       std::move(const_defs)  // 移动 ConstDefList
     );
@@ -619,16 +484,16 @@ Decl
   : ConstDecl
   {
     // Decl ::= ConstDecl;
-    auto decl = std::make_unique<DeclAST>(
-      std::unique_ptr<ConstDeclAST>(static_cast<ConstDeclAST*>($1))
+    auto decl = arena.make<DeclAST>(
+      AstPtr<ConstDeclAST>(static_cast<ConstDeclAST*>($1))
     );
     $$ = decl.release();
   }
   | VarDecl
   {
     // Decl ::= VarDecl;
-    auto decl = std::make_unique<DeclAST>(
-      std::unique_ptr<VarDeclAST>(static_cast<VarDeclAST*>($1))
+    auto decl = arena.make<DeclAST>(
+      AstPtr<VarDeclAST>(static_cast<VarDeclAST*>($1))
     );
     $$ = decl.release();
   }
@@ -638,8 +503,7 @@ Decl
 LVal
   : IDENT
   {
-    auto lval = std::make_unique<LValAST>(std::string(*$1));
-    delete $1;  // 清理 IDENT 的内存
+    auto lval = arena.make<LValAST>($1);
     $$ = lval.release();
   }
   ;
@@ -649,18 +513,16 @@ VarDef
   : IDENT
   {
     // VarDef ::= IDENT;
-    auto var_def = std::make_unique<VarDefAST>(std::string(*$1));
-    delete $1;  // 清理 IDENT 的内存
+    auto var_def = arena.make<VarDefAST>($1);
     $$ = var_def.release();
   }
   | IDENT '=' ConstInitVal
   {
     // VarDef ::= IDENT "=" ConstInitVal;
-    auto var_def = std::make_unique<VarDefAST>(
-      std::string(*$1),
-      std::unique_ptr<ConstInitValAST>(static_cast<ConstInitValAST*>($3))
+    auto var_def = arena.make<VarDefAST>(
+      $1,
+      AstPtr<ConstInitValAST>(static_cast<ConstInitValAST*>($3))
     );
-    delete $1;  // 清理 IDENT 的内存
     $$ = var_def.release();
   }
   ;
@@ -669,15 +531,15 @@ VarDefList
   : VarDef
   {
     // VarDefList ::= VarDef;
-    auto var_def_list = new std::vector<std::unique_ptr<BaseAST>>();
-    var_def_list->push_back(std::unique_ptr<BaseAST>(static_cast<BaseAST*>($1)));
+    auto var_def_list = new std::vector<AstPtr<BaseAST>>();
+    var_def_list->push_back(AstPtr<BaseAST>(static_cast<BaseAST*>($1)));
     $$ = var_def_list;
   }
   | VarDefList ',' VarDef
   {
     // VarDefList ::= VarDefList ',' VarDef;
     auto var_def_list = $1;
-    var_def_list->push_back(std::unique_ptr<BaseAST>(static_cast<BaseAST*>($3)));
+    var_def_list->push_back(AstPtr<BaseAST>(static_cast<BaseAST*>($3)));
     $$ = var_def_list;  // 返回更新后的列表
   }
   ;
@@ -688,13 +550,13 @@ VarDecl
   {
     // VarDecl ::= BType VarDefList ";";
     // 需要将 BaseAST* 转换为 VarDefAST*
-    std::vector<std::unique_ptr<VarDefAST>> var_defs;
+    std::vector<AstPtr<VarDefAST>> var_defs;
     auto base_list = $2;
     for (auto& item : *base_list) {
-      var_defs.push_back(std::unique_ptr<VarDefAST>(static_cast<VarDefAST*>(item.release())));
+      var_defs.push_back(AstPtr<VarDefAST>(static_cast<VarDefAST*>(item.release())));
     }
     delete base_list;
-    auto var_decl = std::make_unique<VarDeclAST>(
+    auto var_decl = arena.make<VarDeclAST>(
       BT_INT,  // BType 暂时只能为 "int"
       std::move(var_defs)  // 移动 VarDefList
     );
@@ -709,6 +571,7 @@ VarDecl
 
 // 定义错误处理函数, 其中第二个参数是错误信息
 // parser 如果发生错误 (例如输入的程序出现了语法错误), 就会调用这个函数
-void yyerror(std::unique_ptr<BaseAST> &ast, const char *s) {
-  cerr << "error: " << s << endl;
+// 错误信息交给 context 记录, 由 CompilerContext::parse 以异常的形式报告给调用者
+void yyerror(YYLTYPE *lloc, AstPtr<BaseAST> &ast, Arena &arena, CompilerContext &context, const char *s) {
+  context.reportSyntaxError(s);
 }
\ No newline at end of file
@@ -0,0 +1,129 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <utility>
+
+ThreadPool::ThreadPool(unsigned thread_count)
+{
+    if (thread_count == 0) {
+        thread_count = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    queues_.reserve(thread_count);
+    for (unsigned i = 0; i < thread_count; ++i) {
+        queues_.push_back(std::make_unique<Queue>());
+    }
+    workers_.reserve(thread_count);
+    for (unsigned i = 0; i < thread_count; ++i) {
+        workers_.emplace_back([this, i] { workerLoop(i); });
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    work_ready_.notify_all();
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+}
+
+void ThreadPool::run(const std::vector<std::size_t>& order, const Task& task)
+{
+    if (order.empty()) {
+        return;
+    }
+
+    // 轮流分配：order 中相邻的任务落在不同的线程上
+    for (std::size_t i = 0; i < order.size(); ++i) {
+        auto& queue = *queues_[i % queues_.size()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back(order[i]);
+    }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    task_ = &task;
+    pending_ = order.size();
+    error_ = nullptr;
+    ++generation_;
+    work_ready_.notify_all();
+    // 还要等所有线程回到等待状态，否则下一次 run() 的任务可能被仍在循环中的线程
+    // 用这一次的 task 执行
+    work_done_.wait(lock, [this] { return pending_ == 0 && active_ == 0; });
+    task_ = nullptr;
+
+    if (error_) {
+        std::rethrow_exception(std::exchange(error_, nullptr));
+    }
+}
+
+bool ThreadPool::takeTask(unsigned worker, std::size_t& index)
+{
+    {
+        auto& own = *queues_[worker];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            index = own.tasks.front();
+            own.tasks.pop_front();
+            return true;
+        }
+    }
+
+    const auto count = queues_.size();
+    for (std::size_t offset = 1; offset < count; ++offset) {
+        auto& victim = *queues_[(worker + offset) % count];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            index = victim.tasks.back();
+            victim.tasks.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::workerLoop(unsigned worker)
+{
+    std::size_t seen_generation = 0;
+    while (true) {
+        const Task* task;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            work_ready_.wait(lock, [&] { return stopping_ || generation_ != seen_generation; });
+            if (stopping_) {
+                return;
+            }
+            seen_generation = generation_;
+            if (task_ == nullptr) {
+                // 醒得太晚，上一次 run() 已经结束
+                continue;
+            }
+            task = task_;
+            ++active_;
+        }
+
+        std::size_t index;
+        while (takeTask(worker, index)) {
+            std::exception_ptr error;
+            try {
+                (*task)(worker, index);
+            } catch (...) {
+                error = std::current_exception();
+            }
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (error && !error_) {
+                error_ = error;
+            }
+            --pending_;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (--active_ == 0 && pending_ == 0) {
+            work_done_.notify_all();
+        }
+    }
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// 工作窃取线程池
+// 每个工作线程有自己的任务队列，从队头取任务；自己的队列空了以后从其他线程的队尾窃取。
+// run() 按给定的顺序把任务轮流分给各个线程，调用方把耗时长的任务排在前面，
+// 这样每个线程先做大任务，最后互相窃取的都是小任务，整体完成时间最短。
+class ThreadPool {
+public:
+    // 线程的编号从 0 开始，调用方可以按编号为每个线程准备独立的状态
+    using Task = std::function<void(unsigned worker, std::size_t index)>;
+
+    // thread_count 为 0 时使用机器的硬件线程数
+    explicit ThreadPool(unsigned thread_count = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    unsigned threadCount() const { return static_cast<unsigned>(workers_.size()); }
+
+    // 对 order 中的每个下标执行一次 task，阻塞直到全部完成
+    // 任务抛出的第一个异常会在所有任务结束后重新抛出
+    void run(const std::vector<std::size_t>& order, const Task& task);
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<std::size_t> tasks;
+    };
+
+    void workerLoop(unsigned worker);
+    // 取下一个任务：先取自己队列的队头，再从其他队列的队尾窃取
+    bool takeTask(unsigned worker, std::size_t& index);
+
+    std::vector<std::thread> workers_;
+    std::vector<std::unique_ptr<Queue>> queues_;
+
+    std::mutex mutex_; // 保护以下状态
+    std::condition_variable work_ready_;
+    std::condition_variable work_done_;
+    const Task* task_ = nullptr;
+    std::size_t generation_ = 0; // 每次 run() 加一，唤醒工作线程
+    std::size_t pending_ = 0; // 本次 run() 还没有完成的任务数
+    unsigned active_ = 0; // 正在处理本次 run() 的任务的线程数
+    std::exception_ptr error_;
+    bool stopping_ = false;
+};
@@ -0,0 +1,200 @@
+#include "time_report.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#include <time.h>
+
+#include "memory_report.h"
+#include "string_format.h"
+
+namespace {
+
+// 当前线程的编号，从 0 开始按第一次记录的顺序分配
+unsigned threadId()
+{
+    static std::atomic<unsigned> next_id { 0 };
+    thread_local const unsigned id = next_id++;
+    return id;
+}
+
+// 当前线程中尚未结束的 Scope 的个数
+thread_local unsigned scope_depth = 0;
+
+std::uint64_t threadCpuNow()
+{
+    timespec ts {};
+    ::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return static_cast<std::uint64_t>(ts.tv_sec) * 1000000000ULL + static_cast<std::uint64_t>(ts.tv_nsec);
+}
+
+TimeReport::PhaseTotal& findTotal(std::vector<TimeReport::PhaseTotal>& totals, const std::string& name, unsigned depth)
+{
+    for (auto& total : totals) {
+        if (total.name == name) {
+            return total;
+        }
+    }
+    totals.push_back({ name, depth });
+    return totals.back();
+}
+
+} // namespace
+
+TimeReport::Scope::Scope(TimeReport* report, const char* phase, std::string_view function)
+    : report_(report)
+    , phase_(phase)
+{
+    if (report_ != nullptr) {
+        function_ = function;
+        ++scope_depth;
+        const auto heap = MemoryReport::threadHeap();
+        allocations_start_ = heap.count;
+        allocated_start_ = heap.bytes;
+        cpu_start_ = threadCpuNow();
+        wall_start_ = now();
+    }
+}
+
+TimeReport::Scope::~Scope()
+{
+    if (report_ != nullptr) {
+        const auto wall_end = now();
+        const auto cpu_end = threadCpuNow();
+        const auto heap = MemoryReport::threadHeap();
+        --scope_depth;
+        report_->record({ phase_, std::move(function_), wall_start_ - report_->origin_, wall_end - wall_start_,
+                          cpu_end - cpu_start_, heap.count - allocations_start_, heap.bytes - allocated_start_,
+                          threadId(), scope_depth });
+    }
+}
+
+TimeReport::TimeReport()
+    : origin_(now())
+{
+}
+
+std::uint64_t TimeReport::now()
+{
+    return static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+void TimeReport::record(Event event)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    events_.push_back(std::move(event));
+}
+
+void TimeReport::accumulate(const char* phase, std::uint64_t wall_ns)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& [name, total] : accumulated_) {
+        if (std::strcmp(name, phase) == 0) {
+            total += wall_ns;
+            return;
+        }
+    }
+    accumulated_.emplace_back(phase, wall_ns);
+}
+
+std::vector<TimeReport::PhaseTotal> TimeReport::summarize(bool by_function) const
+{
+    // 事件在结束时记录，内层先于外层，按开始时间排序后再汇总
+    std::vector<const Event*> ordered;
+    for (const auto& event : events_) {
+        ordered.push_back(&event);
+    }
+    std::stable_sort(ordered.begin(), ordered.end(), [](const Event* lhs, const Event* rhs) {
+        return lhs->start < rhs->start || (lhs->start == rhs->start && lhs->depth < rhs->depth);
+    });
+
+    std::vector<PhaseTotal> totals;
+    for (const auto* event : ordered) {
+        if (by_function && event->function.empty()) {
+            continue;
+        }
+        auto& total = by_function ? findTotal(totals, event->function + " / " + event->phase, 0)
+                                  : findTotal(totals, event->phase, event->depth);
+        total.wall += event->wall;
+        total.cpu += event->cpu;
+        total.allocations += event->allocations;
+        total.allocated += event->allocated;
+        ++total.count;
+    }
+    return totals;
+}
+
+std::vector<TimeReport::PhaseTotal> TimeReport::phaseTotals() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return summarize(false);
+}
+
+void TimeReport::print(std::ostream& out) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    // 缩进表示嵌套；最外层事件的总和作为 100%
+    const auto phases = summarize(false);
+    const auto functions = summarize(true);
+    std::uint64_t total_wall = 0;
+    std::uint64_t total_cpu = 0;
+    for (const auto& phase : phases) {
+        if (phase.depth == 0) {
+            total_wall += phase.wall;
+            total_cpu += phase.cpu;
+        }
+    }
+
+    const auto row = [&](const std::string& name, std::uint64_t wall, std::uint64_t cpu, std::uint64_t count) {
+        out << stringFormat("  %-28s %10.3f %10.3f %6.1f%% %8llu\n", name, wall / 1e6, cpu / 1e6,
+                            total_wall == 0 ? 0.0 : 100.0 * wall / total_wall, static_cast<unsigned long long>(count));
+    };
+
+    out << "Time report (ms)\n";
+    out << stringFormat("  %-28s %10s %10s %7s %8s\n", "phase", "wall", "cpu", "wall%", "count");
+    for (const auto& phase : phases) {
+        row(std::string(phase.depth * 2, ' ') + phase.name, phase.wall, phase.cpu, phase.count);
+    }
+    for (const auto& [name, wall] : accumulated_) {
+        out << stringFormat("  %-28s %10.3f %10s %6.1f%%\n", std::string(name) + " (within parse)", wall / 1e6, "-",
+                            total_wall == 0 ? 0.0 : 100.0 * wall / total_wall);
+    }
+    row("total", total_wall, total_cpu, 0);
+
+    if (!functions.empty()) {
+        out << "Per function (ms)\n";
+        for (const auto& function : functions) {
+            row(function.name, function.wall, function.cpu, function.count);
+        }
+    }
+}
+
+bool TimeReport::writeChromeTrace(const std::string& path) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    FILE* file = std::fopen(path.c_str(), "w");
+    if (file == nullptr) {
+        return false;
+    }
+
+    // "X" 为完整事件，时间单位为微秒；同一线程中的事件按时间自动嵌套
+    std::fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", file);
+    bool first = true;
+    for (const auto& event : events_) {
+        const auto name = event.function.empty() ? std::string(event.phase) : event.phase + (" " + event.function);
+        std::fprintf(file,
+                     "%s{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u,"
+                     "\"args\":{\"cpu_ms\":%.3f,\"allocations\":%llu,\"allocated_bytes\":%llu}}",
+                     first ? "" : ",\n", escapeJson(name).c_str(), event.phase, event.start / 1e3, event.wall / 1e3,
+                     event.thread, event.cpu / 1e6, static_cast<unsigned long long>(event.allocations),
+                     static_cast<unsigned long long>(event.allocated));
+        first = false;
+    }
+    std::fputs("\n]}\n", file);
+    return std::fclose(file) == 0;
+}
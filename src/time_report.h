@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// 编译各阶段的耗时
+// 在需要计时的代码外面放一个 TimeReport::Scope，结束时记录一个事件：阶段名、所属的函数（可以没有）、
+// 开始时间、墙上时间、本线程的 CPU 时间和本线程的堆分配（见 memory_report.h）。
+// 没有启用计时（report 为 nullptr）时 Scope 什么也不做。
+// 事件可以汇总成 -ftime-report 风格的表格，也可以导出为 Chrome trace event 格式的 JSON，
+// 在 chrome://tracing 或 Perfetto 中查看。多个线程可以同时记录到同一个报告中。
+class TimeReport {
+public:
+    class Scope {
+    public:
+        // phase 必须是字符串字面量，报告只保存指针
+        // 以函数为单位的阶段（如 IR 生成、代码生成）给出函数名，报告中另外按函数汇总
+        Scope(TimeReport* report, const char* phase, std::string_view function = {});
+        ~Scope();
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        TimeReport* report_;
+        const char* phase_;
+        std::string function_;
+        std::uint64_t wall_start_ = 0;
+        std::uint64_t cpu_start_ = 0;
+        std::uint64_t allocations_start_ = 0;
+        std::uint64_t allocated_start_ = 0;
+    };
+
+    // 一个阶段所有事件的总和，时间单位为纳秒
+    struct PhaseTotal {
+        std::string name;
+        unsigned depth; // 第一次出现时外层事件的个数
+        std::uint64_t wall = 0;
+        std::uint64_t cpu = 0;
+        std::uint64_t count = 0;
+        std::uint64_t allocations = 0;
+        std::uint64_t allocated = 0; // 堆分配的字节数
+    };
+
+    TimeReport();
+
+    // 累加一段分散在其他阶段之中、不单独记录事件的时间（如解析时按需调用的词法分析），只有墙上时间
+    void accumulate(const char* phase, std::uint64_t wall_ns);
+
+    // 按阶段第一次出现的顺序汇总
+    std::vector<PhaseTotal> phaseTotals() const;
+
+    // 输出每个阶段和每个函数的墙上时间和 CPU 时间
+    void print(std::ostream& out) const;
+    // 写出 Chrome trace event 格式的 JSON，无法写入时返回 false
+    bool writeChromeTrace(const std::string& path) const;
+
+    // 单调时钟的当前时间，单位为纳秒
+    static std::uint64_t now();
+
+private:
+    struct Event {
+        const char* phase;
+        std::string function;
+        std::uint64_t start; // 相对于报告创建的时间
+        std::uint64_t wall;
+        std::uint64_t cpu;
+        std::uint64_t allocations;
+        std::uint64_t allocated;
+        unsigned thread;
+        unsigned depth; // 同一线程中外层事件的个数
+    };
+
+    void record(Event event);
+    // 调用者持有 mutex_；by_function 时按“函数 / 阶段”汇总有函数名的事件
+    std::vector<PhaseTotal> summarize(bool by_function) const;
+
+    const std::uint64_t origin_;
+    mutable std::mutex mutex_; // 保护以下状态
+    std::vector<Event> events_;
+    std::vector<std::pair<const char*, std::uint64_t>> accumulated_;
+};
@@ -0,0 +1,38 @@
+# 获取脚本所在目录
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+
+# 后端不支持的 Koopa IR (全局变量、函数调用、参数、函数声明、getelemptr、移位) 必须报告错误后退出,
+# 不能崩溃, 也不能留下输出文件
+status=0
+for file in "$SCRIPT_DIR"/*; do
+    if [ -f "$file" ]; then
+        # 获取文件名（不包含路径）
+        filename="$(basename "$file")"
+
+        # 检查文件是否以.koopa结尾
+        if [[ "$filename" != *.koopa ]]; then
+            continue
+        fi
+
+        # 输出文件名
+        echo -e "\033[1;32m正在处理测试点: $filename\033[0m"
+        cat "$file"
+        echo
+
+        # 运行编译命令
+        echo -e "\033[1;34m运行编译命令...\033[0m"
+        out=$SCRIPT_DIR/../../build/$filename.S
+        rm -f $out
+        build/compiler -riscv-from-koopa "$file" -o $out 2> $out.err
+        compile_status=$?
+        cat $out.err
+        if [ $compile_status -eq 1 ] && grep -q "unsupported Koopa" $out.err && [ ! -e $out ]; then
+            echo -e "\033[1;33m$filename 测试完成\033[0m"
+        else
+            echo -e "\033[1;31m$filename: 没有报告不支持的 Koopa IR\033[0m"
+            status=1
+        fi
+        echo "----------------------------------------"
+    fi
+done
+exit $status
@@ -0,0 +1,39 @@
+# 获取脚本所在目录
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+
+# 两种词法分析器必须产生相同的 token 流: 分别用 flex 和 mmap 扫描器编译每个测试点,
+# 比较退出码、生成的 Koopa IR 和错误信息 (包括不合法的输入)
+status=0
+for file in "$SCRIPT_DIR"/*; do
+    if [ -f "$file" ]; then
+        # 获取文件名（不包含路径）
+        filename="$(basename "$file")"
+
+        # 检查文件是否以.c结尾
+        if [[ "$filename" != *.c ]]; then
+            continue
+        fi
+
+        # 输出文件名
+        echo -e "\033[1;32m正在处理测试点: $filename\033[0m"
+        cat "$file"
+        echo
+
+        # 运行编译命令
+        echo -e "\033[1;34m运行编译命令...\033[0m"
+        out=$SCRIPT_DIR/../../build/$filename
+        build/compiler -koopa "$file" -o $out.flex.koopa -lexer=flex 2> $out.flex.err
+        flex_status=$?
+        build/compiler -koopa "$file" -o $out.mmap.koopa -lexer=mmap 2> $out.mmap.err
+        mmap_status=$?
+        if [ $flex_status -eq $mmap_status ] && cmp -s $out.flex.err $out.mmap.err \
+            && { [ $flex_status -ne 0 ] || cmp -s $out.flex.koopa $out.mmap.koopa; }; then
+            echo -e "\033[1;33m$filename 测试完成\033[0m"
+        else
+            echo -e "\033[1;31m$filename: flex 和 mmap 扫描器的结果不同\033[0m"
+            status=1
+        fi
+        echo "----------------------------------------"
+    fi
+done
+exit $status
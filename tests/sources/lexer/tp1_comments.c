@@ -0,0 +1,7 @@
+int main() {
+    int a = 1; /* 同一行的第一个注释 */ a = a + 2; /* 第二个注释 */
+    /* 跨行的注释,
+       中间的 * 和 / 以及 // 都不结束注释 **/ a = a * 3;
+    /**/ int b = a /* 注释可以出现在表达式中间 */ - 1;
+    return b; // 返回 8
+}
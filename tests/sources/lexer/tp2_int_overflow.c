@@ -0,0 +1,9 @@
+int main() {
+    // 超出 long 范围的字面量按 strtol 饱和为 LONG_MAX，再截断为 int (-1)
+    int a = 99999999999999999999;
+    int b = 0xFFFFFFFFFFFFFFFFFF;
+    int c = 07777777777777777777777;
+    // 超出 int 但在 long 范围内的字面量只截断: 4294967298 -> 2
+    int d = 4294967298;
+    return a + b + c + d + 5; // 返回 4
+}
@@ -0,0 +1,5 @@
+int main() {
+    // 注释之外无法识别的字节 (0xE4): 两个扫描器都应当报告同样的语法错误
+    int a = 1; 
+    return a;
+}